@@ -44,17 +44,17 @@ std::string motd;
 
 void onClientConnected(ConnectionId connectionId)
 {
-  LOG_DEBUG("Client connected, id: %d", connectionId);
+  LOG_DEBUG("Client connected, id: %lu", connectionId);
 }
 
 void onClientDisconnected(ConnectionId connectionId)
 {
-  LOG_DEBUG("Client disconnected, id: %d", connectionId);
+  LOG_DEBUG("Client disconnected, id: %lu", connectionId);
 }
 
 void onPacketReceived(ConnectionId connectionId, IncomingPacket* packet)
 {
-  LOG_DEBUG("Parsing packet from connection id: %d", connectionId);
+  LOG_DEBUG("Parsing packet from connection id: %lu", connectionId);
 
   while (!packet->isEmpty())
   {
@@ -69,7 +69,7 @@ void onPacketReceived(ConnectionId connectionId, IncomingPacket* packet)
 
       default:
       {
-        LOG_DEBUG("Unknown packet from connection id: %d, packet id: %d", connectionId, packetId);
+        LOG_DEBUG("Unknown packet from connection id: %lu, packet id: %d", connectionId, packetId);
         server->closeConnection(connectionId);
         break;
       }
@@ -79,7 +79,7 @@ void onPacketReceived(ConnectionId connectionId, IncomingPacket* packet)
 
 void parseLogin(ConnectionId connectionId, IncomingPacket* packet)
 {
-  LOG_DEBUG("Parsing login packet from connection id: %d", connectionId);
+  LOG_DEBUG("Parsing login packet from connection id: %lu", connectionId);
 
   uint16_t clientOs = packet->getU16();       // Client OS
   uint16_t clientVersion = packet->getU16();  // Client version
@@ -130,10 +130,10 @@ void parseLogin(ConnectionId connectionId, IncomingPacket* packet)
     response.addU16(account->premiumDays);
   }
 
-  LOG_DEBUG("Sending login response to connection_id: %d", connectionId);
-  server->sendPacket(connectionId, response);
+  LOG_DEBUG("Sending login response to connection_id: %lu", connectionId);
+  server->sendPacket(connectionId, std::move(response));
 
-  LOG_DEBUG("Closing connection id: %d", connectionId);
+  LOG_DEBUG("Closing connection id: %lu", connectionId);
   server->closeConnection(connectionId);
 }
 
@@ -148,6 +148,10 @@ int main(int argc, char* argv[])
   }
 
   auto serverPort = config.getInteger("server", "port", 7171);
+  auto acceptors = config.getInteger("server", "acceptors", 1);
+  auto maxBytesPerWrite = config.getInteger("server", "max_bytes_per_write", 65536);
+  auto maxQueuedBytes = config.getInteger("server", "max_queued_bytes", 262144);
+  auto slowClientTimeout = config.getInteger("server", "slow_client_timeout", 10);
 
   motd = config.getString("login", "motd", "Welcome to LoginServer!");
   auto accountsFilename = config.getString("login", "accounts_file", "data/accounts.xml");
@@ -156,6 +160,10 @@ int main(int argc, char* argv[])
   LOG_INFO("                            LoginServer configuration                           ");
   LOG_INFO("================================================================================");
   LOG_INFO("Server port:               %d", serverPort);
+  LOG_INFO("Acceptors:                 %d", acceptors);
+  LOG_INFO("Max bytes per write:       %d", maxBytesPerWrite);
+  LOG_INFO("Max queued bytes:          %d", maxQueuedBytes);
+  LOG_INFO("Slow client timeout:       %d", slowClientTimeout);
   LOG_INFO("");
   LOG_INFO("Message of the day:        %s", motd.c_str());
   LOG_INFO("Accounts filename:         %s", accountsFilename.c_str());
@@ -179,7 +187,14 @@ int main(int argc, char* argv[])
     &onClientDisconnected,
     &onPacketReceived,
   };
-  server = std::unique_ptr<Server>(new Server(&io_service, serverPort, callbacks));
+  server = std::unique_ptr<Server>(new Server(&io_service,
+                                              Server::ASIO,
+                                              serverPort,
+                                              acceptors,
+                                              maxBytesPerWrite,
+                                              maxQueuedBytes,
+                                              slowClientTimeout,
+                                              callbacks));
 
   // Start Server and io_service
   if (!server->start())
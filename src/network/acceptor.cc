@@ -30,12 +30,29 @@ namespace BIP = boost::asio::ip;
 
 Acceptor::Acceptor(boost::asio::io_service* io_service,
                    unsigned short port,
+                   bool reusePort,
                    const Callbacks& callbacks)
-  : acceptor_(*io_service, BIP::tcp::endpoint(BIP::tcp::v4(), port)),
+  : acceptor_(*io_service),
     socket_(*io_service),
     callbacks_(callbacks),
     state_(CLOSED)
 {
+  BIP::tcp::endpoint endpoint(BIP::tcp::v4(), port);
+  acceptor_.open(endpoint.protocol());
+  acceptor_.set_option(BIP::tcp::acceptor::reuse_address(true));
+  if (reusePort)
+  {
+#ifdef SO_REUSEPORT
+    acceptor_.set_option(boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>(true));
+#else
+    LOG_ERROR("%s: SO_REUSEPORT is not supported on this platform", __func__);
+#endif
+  }
+  acceptor_.bind(endpoint);
+  acceptor_.listen();
+
+  // Needed to check for pending connections without blocking, see acceptPending()
+  acceptor_.non_blocking(true);
 }
 
 Acceptor::~Acceptor()
@@ -84,6 +101,7 @@ void Acceptor::asyncAccept()
     {
       LOG_INFO("Accepted connection");
       callbacks_.onAccept(std::move(socket_));
+      acceptPending();
     }
     else
     {
@@ -101,3 +119,22 @@ void Acceptor::asyncAccept()
     }
   });
 }
+
+void Acceptor::acceptPending()
+{
+  // During a login storm there are usually more connections waiting in the backlog,
+  // accept them directly instead of going through the io_service once per connection
+  for (auto i = 1; i < MAX_ACCEPTS_PER_WAKEUP && state_ == LISTENING; i++)
+  {
+    boost::system::error_code errorCode;
+    acceptor_.accept(socket_, errorCode);
+    if (errorCode)
+    {
+      // Most likely would_block, i.e. there are no more pending connections
+      return;
+    }
+
+    LOG_INFO("Accepted connection");
+    callbacks_.onAccept(std::move(socket_));
+  }
+}
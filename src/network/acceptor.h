@@ -37,8 +37,11 @@ class Acceptor
     std::function<void(boost::asio::ip::tcp::socket socket)> onAccept;
   };
 
+  // With reusePort the socket is opened with SO_REUSEPORT, so that several Acceptors can
+  // listen on the same port and the kernel spreads new connections between them
   Acceptor(boost::asio::io_service* io_service,
            unsigned short port,
+           bool reusePort,
            const Callbacks& callbacks);
   virtual ~Acceptor();
 
@@ -50,8 +53,12 @@ class Acceptor
   void stop();
   bool isListening() const { return state_ == LISTENING; }
 
+  // Maximum number of connections accepted each time the Acceptor is woken up
+  static const int MAX_ACCEPTS_PER_WAKEUP = 32;
+
  private:
   void asyncAccept();
+  void acceptPending();
 
   boost::asio::ip::tcp::acceptor acceptor_;
   boost::asio::ip::tcp::socket socket_;
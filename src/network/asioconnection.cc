@@ -0,0 +1,95 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "asioconnection.h"
+
+#include "logger.h"
+
+namespace BIP = boost::asio::ip;
+
+AsioConnection::AsioConnection(BIP::tcp::socket socket,
+                               std::size_t maxBytesPerWrite,
+                               std::size_t maxQueuedBytes,
+                               std::chrono::steady_clock::duration slowClientTimeout,
+                               const Callbacks& callbacks)
+  : Connection(maxBytesPerWrite, maxQueuedBytes, slowClientTimeout, callbacks),
+    socket_(std::move(socket))
+{
+}
+
+AsioConnection::~AsioConnection()
+{
+  // Does nothing if the Connection already is closed
+  close(false);
+}
+
+void AsioConnection::reset(BIP::tcp::socket socket, const Callbacks& callbacks)
+{
+  socket_ = std::move(socket);
+  Connection::reset(callbacks);
+}
+
+void AsioConnection::asyncReceive(uint8_t* buffer, std::size_t length)
+{
+  // The handler keeps the Connection alive until the read has completed
+  auto self = shared_from_this();
+  socket_.async_read_some(boost::asio::buffer(buffer, length),
+                          [this, self](const boost::system::error_code& errorCode, std::size_t len)
+  {
+    onDataReceived(errorCode, len);
+  });
+}
+
+void AsioConnection::asyncSend(const std::vector<boost::asio::const_buffer>& buffers)
+{
+  // The handler keeps the Connection alive until the write has completed
+  auto self = shared_from_this();
+  boost::asio::async_write(socket_, buffers,
+                           [this, self](const boost::system::error_code& errorCode, std::size_t len)
+  {
+    onPacketsSent(errorCode);
+  });
+}
+
+void AsioConnection::closeSocket()
+{
+  boost::system::error_code error;
+
+  socket_.shutdown(BIP::tcp::socket::shutdown_both, error);
+  if (error)
+  {
+    LOG_ERROR("%s: Could not shutdown socket: %s", __func__, error.message().c_str());
+  }
+
+  socket_.close(error);
+  if (error)
+  {
+    LOG_ERROR("%s: Could not close socket: %s", __func__, error.message().c_str());
+  }
+}
+
+void AsioConnection::post(const std::function<void(void)>& handler)
+{
+  boost::asio::post(socket_.get_executor(), handler);
+}
@@ -0,0 +1,58 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NETWORK_ASIOCONNECTION_H_
+#define NETWORK_ASIOCONNECTION_H_
+
+#include <chrono>
+#include <functional>
+#include <vector>
+#include <boost/asio.hpp>  //NOLINT
+#include "connection.h"
+
+// A Connection that does its I/O with boost::asio, using the io_service of the socket
+class AsioConnection : public Connection
+{
+ public:
+  AsioConnection(boost::asio::ip::tcp::socket socket,
+                 std::size_t maxBytesPerWrite,
+                 std::size_t maxQueuedBytes,
+                 std::chrono::steady_clock::duration slowClientTimeout,
+                 const Callbacks& callbacks);
+  ~AsioConnection();
+
+  // Reuses a closed Connection for a new socket, see Connection::reset
+  void reset(boost::asio::ip::tcp::socket socket, const Callbacks& callbacks);
+
+ private:
+  // From Connection
+  void asyncReceive(uint8_t* buffer, std::size_t length) override;
+  void asyncSend(const std::vector<boost::asio::const_buffer>& buffers) override;
+  void closeSocket() override;
+  void post(const std::function<void(void)>& handler) override;
+
+  boost::asio::ip::tcp::socket socket_;
+};
+
+#endif  // NETWORK_ASIOCONNECTION_H_
@@ -24,34 +24,128 @@
 
 #include "connection.h"
 
-#include <boost/bind.hpp>
+#include <algorithm>
+#include <cstring>
 
 #include "incomingpacket.h"
 #include "outgoingpacket.h"
 #include "logger.h"
 
-namespace BIP = boost::asio::ip;
-
-Connection::Connection(BIP::tcp::socket socket, const Callbacks& callbacks)
-  : socket_(std::move(socket)),
+Connection::Connection(std::size_t maxBytesPerWrite,
+                       std::size_t maxQueuedBytes,
+                       std::chrono::steady_clock::duration slowClientTimeout,
+                       const Callbacks& callbacks)
+  : maxBytesPerWrite_(maxBytesPerWrite),
+    maxQueuedBytes_(maxQueuedBytes),
+    slowClientTimeout_(slowClientTimeout),
     callbacks_(callbacks),
-    state_(CONNECTED)
+    state_(CONNECTED),
+    receiveBegin_(0),
+    receiveEnd_(0),
+    numberOfFramesInWrite_(0),
+    queuedBytes_(0),
+    peakQueuedBytes_(0),
+    droppedPackets_(0),
+    droppedBytes_(0),
+    overBudget_(false)
 {
-  // Start to receive packets
-  receivePacket();
 }
 
 Connection::~Connection()
 {
-  if (state_ != CLOSED)
+  // The derived class closes the Connection, as closeSocket() can't be called from here
+}
+
+void Connection::reset(const Callbacks& callbacks)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  // Clear instead of reassigning the containers, to keep their capacity
+  callbacks_ = callbacks;
+  state_ = CONNECTED;
+  receiveBegin_ = 0;
+  receiveEnd_ = 0;
+  pendingFrame_.segments.clear();
+  pendingFrame_.data.clear();
+  pendingFrame_.sharedPackets.clear();
+  pendingFrame_.length = 0;
+  outgoingFrames_.clear();
+  numberOfFramesInWrite_ = 0;
+  queuedBytes_ = 0;
+  peakQueuedBytes_ = 0;
+  droppedPackets_ = 0;
+  droppedBytes_ = 0;
+  overBudget_ = false;
+}
+
+void Connection::start()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  // Start to receive packets
+  receivePackets();
+}
+
+void Connection::close(bool gracefully)
+{
+  bool closed;
   {
-    close(false);
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed = closeInternal(gracefully);
+  }
+
+  // Call the handler without holding the lock, as it most likely calls back to us
+  if (closed)
+  {
+    callbacks_.onConnectionClosed();
   }
 }
 
-void Connection::close(bool gracefully)
+bool Connection::sendPacket(OutgoingPacket&& packet)
 {
-  if (gracefully && !outgoingPacketBuffers_.empty())
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  auto wasEmpty = pendingFrame_.segments.empty();
+  return addToPendingFrame(packet, false) && wasEmpty;
+}
+
+bool Connection::sendPacket(const std::shared_ptr<const OutgoingPacket>& packet)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  auto wasEmpty = pendingFrame_.segments.empty();
+  if (!addToPendingFrame(*packet, true))
+  {
+    return false;
+  }
+
+  // The packet is shared with other Connections and is released when all of
+  // them have written it
+  pendingFrame_.sharedPackets.push_back(packet);
+  return wasEmpty;
+}
+
+void Connection::flush()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  flushInternal();
+}
+
+Connection::Stats Connection::getStats()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return { queuedBytes_, peakQueuedBytes_, droppedPackets_, droppedBytes_ };
+}
+
+bool Connection::closeInternal(bool gracefully)
+{
+  if (gracefully)
+  {
+    // Make sure that pending packets are sent before closing
+    flushInternal();
+  }
+
+  if (gracefully && !outgoingFrames_.empty())
   {
     // If we should close the connection gracefully and there are packets to send
     // just set the state and close the connection when all packets have been sent
@@ -60,33 +154,114 @@ void Connection::close(bool gracefully)
   }
   else if (state_ != CLOSED)
   {
-    // Close the socket
-    boost::system::error_code error;
+    closeSocket();
+
+    // Set state, the caller should call OnCloseHandler
+    state_ = CLOSED;
+    return true;
+  }
+
+  return false;
+}
+
+bool Connection::addToPendingFrame(const OutgoingPacket& packet, bool shared)
+{
+  if (state_ != CONNECTED)
+  {
+    LOG_DEBUG("%s: Connection is closing or closed, dropping packet", __func__);
+    return false;
+  }
 
-    socket_.shutdown(BIP::tcp::socket::shutdown_both, error);
-    if (error)
+  if (queuedBytes_ + packet.getLength() > maxQueuedBytes_)
+  {
+    if (packet.getPriority() == OutgoingPacket::LOW)
     {
-      LOG_ERROR("%s: Could not shutdown socket: %s", __func__, error.message().c_str());
+      droppedPackets_++;
+      droppedBytes_ += packet.getLength();
+      return false;
     }
 
-    socket_.close(error);
-    if (error)
+    auto now = std::chrono::steady_clock::now();
+    if (!overBudget_)
     {
-      LOG_ERROR("%s: Could not close socket: %s", __func__, error.message().c_str());
+      overBudget_ = true;
+      overBudgetSince_ = now;
     }
 
-    // Set state and call OnCloseHandler
-    state_ = CLOSED;
-    callbacks_.onConnectionClosed();
+    if (now - overBudgetSince_ >= slowClientTimeout_ ||
+        queuedBytes_ + packet.getLength() > MAX_QUEUED_BYTES_FACTOR * maxQueuedBytes_)
+    {
+      droppedPackets_++;
+      droppedBytes_ += packet.getLength();
+      closeSlowClient();
+      return false;
+    }
+  }
+
+  // If the packet doesn't fit in the pending frame we need to queue the pending frame
+  // and start on a new one
+  if (pendingFrame_.length + packet.getLength() > MAX_PACKET_LENGTH)
+  {
+    flushInternal();
+  }
+
+  if (shared)
+  {
+    pendingFrame_.segments.push_back({ &packet, 0, packet.getLength() });
   }
+  else
+  {
+    // Extend the previous segment if it also refers to the frame's data
+    auto offset = pendingFrame_.data.size();
+    pendingFrame_.data.insert(pendingFrame_.data.end(), packet.getData(), packet.getData() + packet.getLength());
+    if (!pendingFrame_.segments.empty() && pendingFrame_.segments.back().sharedPacket == nullptr)
+    {
+      pendingFrame_.segments.back().length += packet.getLength();
+    }
+    else
+    {
+      pendingFrame_.segments.push_back({ nullptr, offset, packet.getLength() });
+    }
+  }
+  pendingFrame_.length += packet.getLength();
+  queuedBytes_ += packet.getLength();
+  peakQueuedBytes_ = std::max(peakQueuedBytes_, queuedBytes_);
+  return true;
+}
+
+void Connection::closeSlowClient()
+{
+  LOG_ERROR("%s: Client is not reading, %lu bytes queued and %lu bytes dropped, closing connection",
+            __func__, queuedBytes_, droppedBytes_);
+
+  // This is called while sending a packet, most likely from a task that holds locks that
+  // onConnectionClosed needs, so close the Connection from its own io_service instead.
+  // No more packets are queued while it's CLOSING
+  state_ = CLOSING;
+  auto self = shared_from_this();
+  post([self]()
+  {
+    self->close(false);
+  });
 }
 
-void Connection::sendPacket(const OutgoingPacket& packet)
+void Connection::flushInternal()
 {
-  outgoingPacketBuffers_.push_back(packet.getBuffer());
+  if (pendingFrame_.segments.empty())
+  {
+    return;
+  }
 
-  // Start to send packet if this is the only packet in the queue
-  if (outgoingPacketBuffers_.size() == 1)
+  pendingFrame_.header[0] = pendingFrame_.length & 0xFF;
+  pendingFrame_.header[1] = (pendingFrame_.length >> 8) & 0xFF;
+  outgoingFrames_.push_back(std::move(pendingFrame_));
+  pendingFrame_.segments.clear();
+  pendingFrame_.data.clear();
+  pendingFrame_.sharedPackets.clear();
+  pendingFrame_.length = 0;
+
+  // Start to send frame if this is the only frame in the queue
+  if (outgoingFrames_.size() == 1)
   {
     sendPacketInternal();
   }
@@ -94,107 +269,167 @@ void Connection::sendPacket(const OutgoingPacket& packet)
 
 void Connection::sendPacketInternal()
 {
-  if (outgoingPacketBuffers_.empty())
+  if (outgoingFrames_.empty())
   {
     LOG_ERROR("There are no packets to send");
     return;
   }
 
-  auto onPacketDataSent = [this]
-                          (const boost::system::error_code& errorCode, std::size_t len)
+  // Gather as many queued frames (header + packets) as possible into one write, but
+  // always at least one frame even if it exceeds maxBytesPerWrite_
+  outgoingBuffers_.clear();
+  std::size_t numberOfBytes = 0;
+  numberOfFramesInWrite_ = 0;
+  for (const auto& frame : outgoingFrames_)
   {
-    if (errorCode)
+    if (numberOfFramesInWrite_ > 0 && numberOfBytes + 2 + frame.length > maxBytesPerWrite_)
     {
-      LOG_ERROR("Could not send packet");
-      close(false);
-      return;
+      break;
     }
 
-    outgoingPacketBuffers_.pop_front();
-    if (!outgoingPacketBuffers_.empty())
-    {
-      // More packet(s) to send
-      LOG_DEBUG("Sending next packet in queue, number of packets now in queue: %d",
-                  outgoingPacketBuffers_.size());
-      sendPacketInternal();
-    }
-    else if (state_ == CLOSING)
+    outgoingBuffers_.emplace_back(frame.header.data(), frame.header.size());
+    for (const auto& segment : frame.segments)
     {
-      // We can only have state CLOSING if we want a graceful shutdown
-      close(true);
+      if (segment.sharedPacket)
+      {
+        outgoingBuffers_.emplace_back(segment.sharedPacket->getData(), segment.length);
+      }
+      else
+      {
+        outgoingBuffers_.emplace_back(frame.data.data() + segment.offset, segment.length);
+      }
     }
-  };
+    numberOfBytes += 2 + frame.length;
+    numberOfFramesInWrite_++;
+  }
 
-  auto onPacketHeaderSent = [this, onPacketDataSent]
-                            (const boost::system::error_code& errorCode, std::size_t len)
+  LOG_DEBUG("Sending %lu packet(s), total length: %lu", numberOfFramesInWrite_, numberOfBytes);
+  asyncSend(outgoingBuffers_);
+}
+
+void Connection::receivePackets()
+{
+  // Move the beginning of a partially received packet to the beginning of the buffer, so
+  // that the rest of it (and more packets) can be read into the buffer after it
+  if (receiveBegin_ > 0)
   {
+    std::memmove(receiveBuffer_.data(), receiveBuffer_.data() + receiveBegin_, receiveEnd_ - receiveBegin_);
+    receiveEnd_ -= receiveBegin_;
+    receiveBegin_ = 0;
+  }
+
+  asyncReceive(receiveBuffer_.data() + receiveEnd_, receiveBuffer_.size() - receiveEnd_);
+}
+
+void Connection::onDataReceived(const boost::system::error_code& errorCode, std::size_t length)
+{
+  if (errorCode)
+  {
+    LOG_ERROR("Could not receive packet: %s", errorCode.message().c_str());
+    close(false);
+    return;
+  }
+
+  LOG_DEBUG("Received %lu bytes", length);
+  receiveEnd_ += length;
+
+  if (!parsePackets())
+  {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (state_ == CONNECTED)
+  {
+    // Receive more packets
+    receivePackets();
+  }
+}
+
+void Connection::onPacketsSent(const boost::system::error_code& errorCode)
+{
+  bool closed;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
     if (errorCode)
     {
-      LOG_ERROR("Could not send packet header");
-      close(false);
-      return;
+      LOG_ERROR("Could not send packet(s)");
+      closed = closeInternal(false);
     }
+    else
+    {
+      // This releases the frames' data and shared packets
+      for (std::size_t i = 0; i < numberOfFramesInWrite_; i++)
+      {
+        queuedBytes_ -= outgoingFrames_[i].length;
+      }
+      outgoingFrames_.erase(outgoingFrames_.begin(),
+                            outgoingFrames_.begin() + numberOfFramesInWrite_);
+      numberOfFramesInWrite_ = 0;
+
+      if (queuedBytes_ <= maxQueuedBytes_)
+      {
+        overBudget_ = false;
+      }
 
-    LOG_DEBUG("Packet header sent, sending data");
-    boost::asio::async_write(socket_,
-                             boost::asio::buffer(outgoingPacketBuffers_.front(),
-                                                 outgoingPacketBuffers_.front().size()),
-                             onPacketDataSent);
-  };
+      if (!outgoingFrames_.empty())
+      {
+        // More packet(s) to send
+        LOG_DEBUG("Sending next packet(s) in queue, number of packets now in queue: %lu",
+                    outgoingFrames_.size());
+        sendPacketInternal();
+        closed = false;
+      }
+      else if (state_ == CLOSING)
+      {
+        // We can only have state CLOSING if we want a graceful shutdown
+        closed = closeInternal(true);
+      }
+      else
+      {
+        closed = false;
+      }
+    }
+  }
 
-  int packet_length = outgoingPacketBuffers_.front().size();
-  LOG_DEBUG("Sending packet header, data length: %d", packet_length);
-  outgoingHeaderBuffer_[0] = packet_length & 0xFF;
-  outgoingHeaderBuffer_[1] = (packet_length >> 8) & 0xFF;
-  boost::asio::async_write(socket_,
-                           boost::asio::buffer(outgoingHeaderBuffer_, 2),
-                           onPacketHeaderSent);
+  if (closed)
+  {
+    callbacks_.onConnectionClosed();
+  }
 }
 
-void Connection::receivePacket()
+bool Connection::parsePackets()
 {
-  auto onPacketDataReceived = [this]
-                              (const boost::system::error_code& errorCode, std::size_t len)
+  while (receiveEnd_ - receiveBegin_ >= 2)
   {
-    if (errorCode)
+    const auto* header = receiveBuffer_.data() + receiveBegin_;
+    std::size_t length = (header[1] << 8) | header[0];
+    if (length > MAX_PACKET_LENGTH)
     {
-      LOG_ERROR("Could not receive packet");
+      LOG_ERROR("%s: Packet length %lu is too long, closing connection", __func__, length);
       close(false);
-      return;
+      return false;
     }
 
-    LOG_DEBUG("Received packet data");
-
-    // Call handler
-    incomingPacket_.resetPosition();
-    callbacks_.onPacketReceived(&incomingPacket_);
-
-    if (state_ == CONNECTED)
+    if (receiveEnd_ - receiveBegin_ < 2 + length)
     {
-      // Receive more packets
-      receivePacket();
+      // Wait for the rest of the packet
+      break;
     }
-  };
 
-  auto onPacketHeaderReceived = [this, onPacketDataReceived]
-                                (const boost::system::error_code& errorCode, std::size_t len)
-  {
-    if (errorCode)
+    // Call handler, without holding the lock since it may send packets or close
+    // this Connection. Only one read is active so the receive buffer is safe to use
+    IncomingPacket packet(header + 2, length);
+    receiveBegin_ += 2 + length;
+    callbacks_.onPacketReceived(&packet);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (state_ != CONNECTED)
     {
-      LOG_ERROR("Could not receive packet header: %s", errorCode.message().c_str());
-      close(false);
-      return;
+      return false;
     }
+  }
 
-    // Receive data
-    incomingPacket_.setLength((incomingHeaderBuffer_[1] << 8) | incomingHeaderBuffer_[0]);
-    LOG_DEBUG("Received packet header, data length: %d", incomingPacket_.getLength());
-    boost::asio::async_read(socket_,
-                            boost::asio::buffer(incomingPacket_.getBuffer(), incomingPacket_.getLength()),
-                            onPacketDataReceived);
-  };
-
-  boost::asio::async_read(socket_,
-                          boost::asio::buffer(incomingHeaderBuffer_, 2),
-                          onPacketHeaderReceived);
+  return true;
 }
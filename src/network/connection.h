@@ -25,16 +25,22 @@
 #ifndef NETWORK_CONNECTION_H_
 #define NETWORK_CONNECTION_H_
 
+#include <array>
+#include <chrono>
 #include <deque>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <vector>
 #include <boost/asio.hpp>  //NOLINT
 #include "incomingpacket.h"
+#include "outgoingpacket.h"
 
-// Forward declarations
-class OutgoingPacket;
-
-class Connection
+// All public functions are thread-safe. A Connection must be owned by a shared_ptr
+// since pending asynchronous operations keep it alive until they have completed
+// Connection implements the protocol (framing, send queue and packet parsing), the
+// socket I/O is done by a derived class for each network backend, see AsioConnection
+class Connection : public std::enable_shared_from_this<Connection>
 {
  public:
   struct Callbacks
@@ -43,21 +49,98 @@ class Connection
     std::function<void(IncomingPacket*)> onPacketReceived;
   };
 
-  Connection(boost::asio::ip::tcp::socket socket, const Callbacks& callbacks);
+  // Send queue statistics, see sendPacket()
+  struct Stats
+  {
+    std::size_t queuedBytes;
+    std::size_t peakQueuedBytes;
+    std::size_t droppedPackets;
+    std::size_t droppedBytes;
+  };
+
+  Connection(std::size_t maxBytesPerWrite,
+             std::size_t maxQueuedBytes,
+             std::chrono::steady_clock::duration slowClientTimeout,
+             const Callbacks& callbacks);
   virtual ~Connection();
 
   // Delete copy constructors
   Connection(const Connection&) = delete;
   Connection& operator=(const Connection&) = delete;
 
+  // Starts to receive packets
+  void start();
+
   void close(bool gracefully);
-  void sendPacket(const OutgoingPacket& packet);
+
+  // Packets are not sent directly, they are appended to a pending packet which is
+  // sent when flush() is called. This way all packets generated during one task are
+  // sent as one packet (or as few packets as possible)
+  // The data of an OutgoingPacket is copied into the pending frame, so that its buffer
+  // goes back to the pool directly and the queued bytes are the memory that is held
+  // Returns true if this was the first pending packet since the last flush()
+  //
+  // The bytes that are pending or queued for writing are kept within maxQueuedBytes: when
+  // a client doesn't read fast enough, low priority packets are dropped and other packets
+  // are queued over the budget. A client that stays over the budget for slowClientTimeout,
+  // or that reaches MAX_QUEUED_BYTES_FACTOR times the budget, is disconnected
+  bool sendPacket(OutgoingPacket&& packet);
+
+  // Sends a packet that is shared by several Connections, e.g. a broadcast
+  // The packet is not copied, it is kept by the frame until it has been written
+  bool sendPacket(const std::shared_ptr<const OutgoingPacket>& packet);
+
+  void flush();
+
+  Stats getStats();
+
+  // Maximum length of a (coalesced) packet, in both directions
+  // A client that sends a longer packet is disconnected
+  static const std::size_t MAX_PACKET_LENGTH = 8192;
+
+  // Incoming data is read into a buffer of this size, with as large reads as possible, and
+  // all complete packets in the buffer are parsed in place. It must fit at least one packet
+  static const std::size_t RECEIVE_BUFFER_SIZE = 4 * (2 + MAX_PACKET_LENGTH);
+
+  // Hard limit on the send queue, as a factor of maxQueuedBytes
+  static const std::size_t MAX_QUEUED_BYTES_FACTOR = 2;
+
+ protected:
+  // Reuses a closed Connection, so that Connections (and their buffers) can be pooled
+  // The derived class resets its socket, no handlers may be pending
+  void reset(const Callbacks& callbacks);
+
+  // Socket I/O, implemented by the derived class and called with mutex_ locked
+  // A read must call onDataReceived and a write onPacketsSent when it has completed, and
+  // the pending operation must keep the Connection alive until then
+  virtual void asyncReceive(uint8_t* buffer, std::size_t length) = 0;
+  virtual void asyncSend(const std::vector<boost::asio::const_buffer>& buffers) = 0;
+  virtual void closeSocket() = 0;
+
+  // Calls handler later, from a network thread
+  virtual void post(const std::function<void(void)>& handler) = 0;
+
+  // Completion handlers for asyncReceive and asyncSend (a write must send all buffers)
+  void onDataReceived(const boost::system::error_code& errorCode, std::size_t length);
+  void onPacketsSent(const boost::system::error_code& errorCode);
 
  private:
+  // These must be called with mutex_ locked
+  bool closeInternal(bool gracefully);
+  bool addToPendingFrame(const OutgoingPacket& packet, bool shared);
+  void closeSlowClient();
+  void flushInternal();
   void sendPacketInternal();
-  void receivePacket();
+  void receivePackets();
+
+  // Dispatches all complete packets in the receive buffer, returns false if the Connection
+  // was closed, either due to an invalid packet or by the onPacketReceived callback
+  bool parsePackets();
 
-  boost::asio::ip::tcp::socket socket_;
+  std::mutex mutex_;
+  std::size_t maxBytesPerWrite_;
+  std::size_t maxQueuedBytes_;
+  std::chrono::steady_clock::duration slowClientTimeout_;
   Callbacks callbacks_;
 
   enum State
@@ -69,11 +152,48 @@ class Connection
   State state_;
 
   // I/O Buffers
-  std::array<uint8_t, 2> incomingHeaderBuffer_;
-  IncomingPacket incomingPacket_;
+  // The receive buffer contains received but not yet parsed data in
+  // [receiveBegin_, receiveEnd_), which is moved to the beginning of the buffer before each
+  // read. It's only accessed by the read handler (and there's only one read active), so
+  // it's not protected by mutex_
+  std::array<uint8_t, RECEIVE_BUFFER_SIZE> receiveBuffer_;
+  std::size_t receiveBegin_;
+  std::size_t receiveEnd_;
+
+  // A frame is one packet on the wire: a header followed by the data of one or more
+  // OutgoingPackets, which is either copied into the frame's data or shared with other
+  // frames. The segments keep the order of the packets, a segment with a shared packet
+  // refers to the whole packet and other segments to a range of data
+  struct OutgoingFrame
+  {
+    struct Segment
+    {
+      const OutgoingPacket* sharedPacket;
+      std::size_t offset;
+      std::size_t length;
+    };
+
+    std::array<uint8_t, 2> header;
+    std::vector<Segment> segments;
+    std::vector<uint8_t> data;
+    std::vector<std::shared_ptr<const OutgoingPacket>> sharedPackets;
+    std::size_t length = 0;
+  };
+  OutgoingFrame pendingFrame_;
+  std::deque<OutgoingFrame> outgoingFrames_;
+
+  // The frames currently being written
+  std::size_t numberOfFramesInWrite_;
+  std::vector<boost::asio::const_buffer> outgoingBuffers_;
 
-  std::array<uint8_t, 2> outgoingHeaderBuffer_;
-  std::deque<std::vector<uint8_t>> outgoingPacketBuffers_;
+  // Send queue accounting, queuedBytes_ is the length of all frames in pendingFrame_ and
+  // outgoingFrames_, and overBudgetSince_ is when it last went over maxQueuedBytes_
+  std::size_t queuedBytes_;
+  std::size_t peakQueuedBytes_;
+  std::size_t droppedPackets_;
+  std::size_t droppedBytes_;
+  bool overBudget_;
+  std::chrono::steady_clock::time_point overBudgetSince_;
 };
 
 #endif  // NETWORK_CONNECTION_H_
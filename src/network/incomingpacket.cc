@@ -25,29 +25,41 @@
 #include "incomingpacket.h"
 
 #include <algorithm>
+#include <cstring>
 #include <vector>
 
-IncomingPacket::IncomingPacket()
-  : buffer_(),
-    length_(0),
-    position_(0)
+IncomingPacket::IncomingPacket(const uint8_t* buffer, std::size_t length)
+  : buffer_(buffer),
+    length_(length),
+    position_(0),
+    truncated_(false)
 {
 }
 
 uint8_t IncomingPacket::peekU8() const
 {
+  if (bytesLeft() < 1)
+  {
+    return 0;
+  }
+
   return buffer_[position_];
 }
 
 uint8_t IncomingPacket::getU8()
 {
   auto value = peekU8();
-  position_ += 1;
+  consume(1);
   return value;
 }
 
 uint16_t IncomingPacket::peekU16() const
 {
+  if (bytesLeft() < 2)
+  {
+    return 0;
+  }
+
   uint16_t value = buffer_[position_];
   value |= ((uint16_t)buffer_[position_ + 1] << 8) & 0xFF00;
   return value;
@@ -56,12 +68,17 @@ uint16_t IncomingPacket::peekU16() const
 uint16_t IncomingPacket::getU16()
 {
   auto value = peekU16();
-  position_ += 2;
+  consume(2);
   return value;
 }
 
 uint32_t IncomingPacket::peekU32() const
 {
+  if (bytesLeft() < 4)
+  {
+    return 0;
+  }
+
   uint32_t value = buffer_[position_];
   value |= ((uint32_t)buffer_[position_ + 1] << 8) & 0xFF00;
   value |= ((uint32_t)buffer_[position_ + 2] << 16) & 0xFF0000;
@@ -72,25 +89,53 @@ uint32_t IncomingPacket::peekU32() const
 uint32_t IncomingPacket::getU32()
 {
   auto value = peekU32();
-  position_ += 4;
+  consume(4);
   return value;
 }
 
 std::string IncomingPacket::getString()
 {
   uint16_t length = getU16();
-  int temp = position_;
-  position_ += length;
-  return std::string(buffer_.cbegin() + temp,
-                     buffer_.cbegin() + temp + length);
+  auto temp = position_;
+  if (!consume(length))
+  {
+    return std::string();
+  }
+  return std::string(buffer_ + temp, buffer_ + temp + length);
+}
+
+std::size_t IncomingPacket::getString(char* buffer, std::size_t maxLength)
+{
+  uint16_t length = getU16();
+  auto temp = position_;
+  if (!consume(length))
+  {
+    return 0;
+  }
+  auto copyLength = std::min(static_cast<std::size_t>(length), maxLength);
+  std::memcpy(buffer, buffer_ + temp, copyLength);
+  return copyLength;
 }
 
 std::vector<uint8_t> IncomingPacket::getBytes(int num_bytes)
 {
-  std::vector<uint8_t> bytes(num_bytes);
-  std::copy(buffer_.cbegin() + position_,
-            buffer_.cbegin() + position_ + num_bytes,
-            bytes.begin());
-  position_ += num_bytes;
-  return bytes;
+  auto temp = position_;
+  if (num_bytes < 0 || !consume(num_bytes))
+  {
+    return std::vector<uint8_t>();
+  }
+  return std::vector<uint8_t>(buffer_ + temp, buffer_ + temp + num_bytes);
+}
+
+bool IncomingPacket::consume(std::size_t numBytes)
+{
+  if (bytesLeft() < numBytes)
+  {
+    position_ = length_;
+    truncated_ = true;
+    return false;
+  }
+
+  position_ += numBytes;
+  return true;
 }
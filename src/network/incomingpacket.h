@@ -27,27 +27,28 @@
 
 #include <cstddef>
 #include <cstdint>
-#include <array>
 #include <string>
 #include <vector>
 
+// A view of one received packet, which is parsed in place in the Connection's receive
+// buffer and is only valid during the onPacketReceived callback
+// Reading past the end of the packet doesn't read outside of it, the functions return 0
+// (or an empty string / vector) instead, the packet is empty and isTruncated() returns
+// true afterwards
 class IncomingPacket
 {
  public:
-  IncomingPacket();
+  IncomingPacket(const uint8_t* buffer, std::size_t length);
   virtual ~IncomingPacket() = default;
 
   // Delete copy constructors
   IncomingPacket(const IncomingPacket&) = delete;
   IncomingPacket& operator=(const IncomingPacket&) = delete;
 
-  // Should only be used by Connection
   std::size_t getLength() const { return length_; }
-  void setLength(std::size_t length) { length_ = length; }
-  std::array<uint8_t, 8192>::pointer getBuffer() { return buffer_.data(); }
-  void resetPosition() { position_ = 0; }
 
   bool isEmpty() const { return position_ >= length_; }
+  bool isTruncated() const { return truncated_; }
   std::size_t bytesLeft() const { return length_ - position_; }
   uint8_t peekU8() const;
   uint8_t getU8();
@@ -56,12 +57,19 @@ class IncomingPacket
   uint32_t peekU32() const;
   uint32_t getU32();
   std::string getString();
+  // Copies at most maxLength characters of the string to buffer, and skips the rest
+  // Returns the number of characters copied
+  std::size_t getString(char* buffer, std::size_t maxLength);
   std::vector<uint8_t> getBytes(int numBytes);
 
  private:
-  std::array<uint8_t, 8192> buffer_;
+  // Returns false, and skips to the end of the packet, if there are less than numBytes left
+  bool consume(std::size_t numBytes);
+
+  const uint8_t* buffer_;
   std::size_t length_;
   std::size_t position_;
+  bool truncated_;
 };
 
 #endif  // NETWORK_INCOMINGPACKET_H_
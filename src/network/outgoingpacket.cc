@@ -30,11 +30,15 @@
 
 // Initialize static packet pool
 std::stack<std::unique_ptr<std::array<uint8_t, 8192>>> OutgoingPacket::buffer_pool_;
+std::mutex OutgoingPacket::buffer_pool_mutex_;
+const std::size_t OutgoingPacket::MAX_POOLED_BUFFERS;
 
 OutgoingPacket::OutgoingPacket()
   : position_(0),
-    length_(0)
+    length_(0),
+    priority_(NORMAL)
 {
+  std::lock_guard<std::mutex> lock(buffer_pool_mutex_);
   if (buffer_pool_.empty())
   {
     buffer_.reset(new std::array<uint8_t, 8192>());
@@ -49,17 +53,56 @@ OutgoingPacket::OutgoingPacket()
   }
 }
 
+OutgoingPacket::OutgoingPacket(OutgoingPacket&& other)
+  : buffer_(std::move(other.buffer_)),
+    position_(other.position_),
+    length_(other.length_),
+    priority_(other.priority_)
+{
+  other.position_ = 0;
+  other.length_ = 0;
+}
+
+OutgoingPacket& OutgoingPacket::operator=(OutgoingPacket&& other)
+{
+  if (this != &other)
+  {
+    releaseBuffer();
+    buffer_ = std::move(other.buffer_);
+    position_ = other.position_;
+    length_ = other.length_;
+    priority_ = other.priority_;
+    other.position_ = 0;
+    other.length_ = 0;
+  }
+  return *this;
+}
+
 OutgoingPacket::~OutgoingPacket()
 {
-  buffer_pool_.push(std::move(buffer_));
-  LOG_DEBUG("Returned buffer to pool, buffers now in pool: %lu",
-              buffer_pool_.size());
+  releaseBuffer();
 }
 
-std::vector<uint8_t> OutgoingPacket::getBuffer() const
+void OutgoingPacket::releaseBuffer()
 {
-  return std::vector<uint8_t>(buffer_->cbegin(),
-                              buffer_->cbegin() + position_);
+  // The buffer is gone if this packet has been moved from
+  if (!buffer_)
+  {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(buffer_pool_mutex_);
+  if (buffer_pool_.size() < MAX_POOLED_BUFFERS)
+  {
+    buffer_pool_.push(std::move(buffer_));
+    LOG_DEBUG("Returned buffer to pool, buffers now in pool: %lu",
+                buffer_pool_.size());
+  }
+  else
+  {
+    buffer_.reset();
+    LOG_DEBUG("Pool is full, freed buffer");
+  }
 }
 
 void OutgoingPacket::skipBytes(std::size_t num_bytes)
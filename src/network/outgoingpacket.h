@@ -26,10 +26,11 @@
 #define NETWORK_OUTGOINGPACKET_H_
 
 #include <cstdint>
+#include <array>
 #include <string>
 #include <stack>
 #include <memory>
-#include <vector>
+#include <mutex>
 
 class OutgoingPacket
 {
@@ -41,7 +42,23 @@ class OutgoingPacket
   OutgoingPacket(const OutgoingPacket&) = delete;
   OutgoingPacket& operator=(const OutgoingPacket&) = delete;
 
-  std::vector<uint8_t> getBuffer() const;
+  // Moving a packet transfers its buffer
+  OutgoingPacket(OutgoingPacket&& other);
+  OutgoingPacket& operator=(OutgoingPacket&& other);
+
+  // Low priority packets are updates that the client can do without, e.g. a creature
+  // turning, and are dropped instead of queued when a Connection is over its send budget
+  enum Priority
+  {
+    NORMAL,
+    LOW,
+  };
+
+  Priority getPriority() const { return priority_; }
+  void setPriority(Priority priority) { priority_ = priority; }
+
+  const uint8_t* getData() const { return buffer_->data(); }
+  std::size_t getLength() const { return position_; }
   void skipBytes(std::size_t num_bytes);
   void addU8(uint8_t val);
   void addU16(uint16_t val);
@@ -52,8 +69,16 @@ class OutgoingPacket
   std::unique_ptr<std::array<uint8_t, 8192>> buffer_;
   std::size_t position_;
   std::size_t length_;
+  Priority priority_;
+
+  // Returns the buffer to the pool, or frees it if the pool is full
+  void releaseBuffer();
 
+  // The pool is shared by all threads. It is capped, so that a burst of packets (e.g.
+  // shared packets queued to slow clients) doesn't keep its buffers allocated for good
+  static const std::size_t MAX_POOLED_BUFFERS = 256;
   static std::stack<std::unique_ptr<std::array<uint8_t, 8192>>> buffer_pool_;
+  static std::mutex buffer_pool_mutex_;
 };
 
 #endif  // NETWORK_OUTGOINGPACKET_H_
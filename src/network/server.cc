@@ -24,7 +24,12 @@
 
 #include "server.h"
 
-#include "connection.h"
+#include <algorithm>
+
+#include "asioconnection.h"
+#ifdef WITH_IO_URING
+#include "uringconnection.h"
+#endif
 #include "incomingpacket.h"
 #include "outgoingpacket.h"
 #include "logger.h"
@@ -32,24 +37,52 @@
 namespace BIP = boost::asio::ip;
 
 Server::Server(boost::asio::io_service* io_service,
+               Backend backend,
                unsigned short port,
+               int numberOfAcceptors,
+               std::size_t maxBytesPerWrite,
+               std::size_t maxQueuedBytes,
+               int slowClientTimeout,
                const Callbacks& callbacks)
-  : acceptor_(io_service,
-              port,
-              {
-                std::bind(&Server::onAccept, this, std::placeholders::_1)
-              }),
+  : backend_(backend),
+    listening_(false),
+    maxBytesPerWrite_(maxBytesPerWrite),
+    maxQueuedBytes_(maxQueuedBytes),
+    slowClientTimeout_(slowClientTimeout),
     callbacks_(callbacks),
-    nextConnectionId_(0)
-
+    flushIoService_(io_service),
+    numberOfConnections_(0),
+    flushPosted_(false)
 {
   LOG_INFO("Starting Server.");
+
+  if (backend_ == IO_URING)
+  {
+#ifdef WITH_IO_URING
+    UringService::Callbacks uringCallbacks
+    {
+      [this](int fd) { onAccept(fd); }
+    };
+    uringService_.reset(new UringService(port, uringCallbacks));
+#endif
+    return;
+  }
+
+  Acceptor::Callbacks acceptorCallbacks
+  {
+    [this](BIP::tcp::socket socket) { onAccept(std::move(socket)); }
+  };
+  auto reusePort = numberOfAcceptors > 1;
+  for (auto i = 0; i < std::max(numberOfAcceptors, 1); i++)
+  {
+    acceptors_.emplace_back(new Acceptor(io_service, port, reusePort, acceptorCallbacks));
+  }
 }
 
 Server::~Server()
 {
   LOG_INFO("Closing Server.");
-  if (acceptor_.isListening())
+  if (listening_)
   {
     stop();
   }
@@ -57,63 +90,325 @@ Server::~Server()
 
 bool Server::start()
 {
-  return acceptor_.start();
+  if (backend_ == IO_URING)
+  {
+#ifdef WITH_IO_URING
+    listening_ = uringService_->start();
+#else
+    LOG_ERROR("%s: The io_uring backend is not available, build WITH_IO_URING", __func__);
+#endif
+    return listening_;
+  }
+
+  for (auto& acceptor : acceptors_)
+  {
+    if (!acceptor->start())
+    {
+      return false;
+    }
+  }
+  listening_ = true;
+  return true;
 }
 
 void Server::stop()
 {
-  acceptor_.stop();
+  for (auto& acceptor : acceptors_)
+  {
+    acceptor->stop();
+  }
+#ifdef WITH_IO_URING
+  if (uringService_)
+  {
+    uringService_->stop();
+  }
+#endif
+
+  // Closing a Connection will free its slot due to the onConnectionClosed callback
+  while (true)
+  {
+    std::shared_ptr<Connection> connection;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (numberOfConnections_ == 0)
+      {
+        break;
+      }
+      for (const auto& slot : connectionSlots_)
+      {
+        if (slot.open)
+        {
+          connection = slot.connection;
+          break;
+        }
+      }
+    }
+    connection->close(false);
+  }
+#ifdef WITH_IO_URING
+  if (uringService_)
+  {
+    // Wait until all sockets' operations have completed
+    uringService_->join();
+  }
+#endif
+
+  listening_ = false;
+}
+
+void Server::sendPacket(ConnectionId connectionId, OutgoingPacket&& packet)
+{
+  LOG_DEBUG("sendPacket() connectionId: %lu", connectionId);
+  auto connection = getConnection(connectionId);
+  if (connection && connection->sendPacket(std::move(packet)))
+  {
+    addPendingConnection(connectionId);
+  }
+}
 
-  // Closing a Connection will erase it from connections_ due to the onConnectionClosed callback
-  while (!connections_.empty())
+void Server::sendPacket(ConnectionId connectionId, const std::shared_ptr<const OutgoingPacket>& packet)
+{
+  LOG_DEBUG("sendPacket() (shared) connectionId: %lu", connectionId);
+  auto connection = getConnection(connectionId);
+  if (connection && connection->sendPacket(packet))
   {
-    connections_.begin()->second->close(false);
+    addPendingConnection(connectionId);
   }
 }
 
-void Server::sendPacket(ConnectionId connectionId, const OutgoingPacket& packet)
+void Server::flush()
 {
-  LOG_DEBUG("sendPacket() connectionId: %d", connectionId);
-  connections_.at(connectionId)->sendPacket(packet);
+  std::vector<std::shared_ptr<Connection>> connections;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    flushPosted_ = false;
+
+    // Note that a Connection may have been closed since it was added
+    for (auto connectionId : pendingConnectionIds_)
+    {
+      auto connection = getConnectionInternal(connectionId);
+      if (connection)
+      {
+        connections.push_back(std::move(connection));
+      }
+    }
+    pendingConnectionIds_.clear();
+  }
+
+  for (auto& connection : connections)
+  {
+    connection->flush();
+  }
+}
+
+void Server::setFlushIoService(boost::asio::io_service* io_service)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  flushIoService_ = io_service;
 }
 
 void Server::closeConnection(ConnectionId connectionId)
 {
-  LOG_DEBUG("closeConnection() connectionId: %d", connectionId);
-  connections_.at(connectionId)->close(true);
+  LOG_DEBUG("closeConnection() connectionId: %lu", connectionId);
+  auto connection = getConnection(connectionId);
+  if (connection)
+  {
+    connection->close(true);
+  }
 }
 
-// Handler for Acceptor
-void Server::onAccept(BIP::tcp::socket socket)
+bool Server::isConnectionOpen(ConnectionId connectionId)
 {
-  int connectionId = nextConnectionId_++;
+  return static_cast<bool>(getConnection(connectionId));
+}
 
+bool Server::getConnectionStats(ConnectionId connectionId, Connection::Stats* stats)
+{
+  auto connection = getConnection(connectionId);
+  if (!connection)
+  {
+    return false;
+  }
+  *stats = connection->getStats();
+  return true;
+}
+
+std::shared_ptr<Connection> Server::getConnectionInternal(ConnectionId connectionId) const
+{
+  auto index = getConnectionIndex(connectionId);
+  if (index >= connectionSlots_.size() ||
+      !connectionSlots_[index].open ||
+      connectionSlots_[index].generation != (connectionId >> 32))
+  {
+    return std::shared_ptr<Connection>();
+  }
+  return connectionSlots_[index].connection;
+}
+
+std::shared_ptr<Connection> Server::getConnection(ConnectionId connectionId)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto connection = getConnectionInternal(connectionId);
+  if (!connection)
+  {
+    // The Connection may have been closed by a network thread while the packet was created
+    LOG_DEBUG("%s: connectionId: %lu not found", __func__, connectionId);
+  }
+  return connection;
+}
+
+void Server::addPendingConnection(ConnectionId connectionId)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  pendingConnectionIds_.push_back(connectionId);
+
+  // Flush all pending packets once the current handler (e.g. a game task) is done,
+  // so that everything generated by it is sent together
+  if (!flushPosted_)
+  {
+    flushPosted_ = true;
+    flushIoService_->post(std::bind(&Server::flush, this));
+  }
+}
+
+template<typename CreateConnection>
+void Server::addConnection(const CreateConnection& createConnection)
+{
   // Create and insert Connection
-  Connection::Callbacks callbacks
+  std::shared_ptr<Connection> connection;
+  ConnectionId connectionId;
+  std::size_t numberOfConnections;
   {
-    std::bind(&Server::onConnectionClosed, this, connectionId),
-    std::bind(&Server::onPacketReceived, this, connectionId, std::placeholders::_1)
-  };
-  auto connection = std::unique_ptr<Connection>(new Connection(std::move(socket), callbacks));
-  connections_.insert(std::make_pair(connectionId, std::move(connection)));
+    std::lock_guard<std::mutex> lock(mutex_);
 
-  LOG_DEBUG("onServerAccept() new connectionId: %d no connections: %lu",
-              connectionId, connections_.size());
+    std::size_t index;
+    if (freeConnectionSlots_.empty())
+    {
+      index = connectionSlots_.size();
+      connectionSlots_.push_back({ std::shared_ptr<Connection>(), 0, false });
+    }
+    else
+    {
+      index = freeConnectionSlots_.back();
+      freeConnectionSlots_.pop_back();
+    }
+    auto& slot = connectionSlots_[index];
+    connectionId = (static_cast<ConnectionId>(slot.generation) << 32) | index;
+
+    Connection::Callbacks callbacks
+    {
+      [this, connectionId]()
+      {
+        onConnectionClosed(connectionId);
+      },
+      [this, connectionId](IncomingPacket* packet)
+      {
+        onPacketReceived(connectionId, packet);
+      }
+    };
+
+    // Reuse the slot's previous Connection unless one of its handlers is still pending
+    if (slot.connection && slot.connection.use_count() != 1)
+    {
+      slot.connection.reset();
+    }
+    createConnection(&slot.connection, callbacks);
+    slot.open = true;
+    connection = slot.connection;
+    numberOfConnections = ++numberOfConnections_;
+  }
+
+  LOG_DEBUG("onServerAccept() new connectionId: %lu no connections: %lu",
+              connectionId, numberOfConnections);
 
   callbacks_.onClientConnected(connectionId);
+  connection->start();
+}
+
+// Handler for Acceptor
+void Server::onAccept(BIP::tcp::socket socket)
+{
+  addConnection([this, &socket](std::shared_ptr<Connection>* connection, const Connection::Callbacks& callbacks)
+  {
+    if (*connection)
+    {
+      static_cast<AsioConnection*>(connection->get())->reset(std::move(socket), callbacks);
+    }
+    else
+    {
+      *connection = std::make_shared<AsioConnection>(std::move(socket),
+                                                     maxBytesPerWrite_,
+                                                     maxQueuedBytes_,
+                                                     slowClientTimeout_,
+                                                     callbacks);
+    }
+  });
+}
+
+#ifdef WITH_IO_URING
+// Handler for UringService
+void Server::onAccept(int fd)
+{
+  addConnection([this, fd](std::shared_ptr<Connection>* connection, const Connection::Callbacks& callbacks)
+  {
+    if (*connection)
+    {
+      static_cast<UringConnection*>(connection->get())->reset(fd, callbacks);
+    }
+    else
+    {
+      *connection = std::make_shared<UringConnection>(uringService_.get(),
+                                                      fd,
+                                                      maxBytesPerWrite_,
+                                                      maxQueuedBytes_,
+                                                      slowClientTimeout_,
+                                                      callbacks);
+    }
+  });
 }
+#endif
 
 // Handler for Connection
 void Server::onConnectionClosed(ConnectionId connectionId)
 {
-  connections_.erase(connectionId);
-  LOG_DEBUG("onConnectionClosed() connectionId: %d no connections: %lu",
-              connectionId, connections_.size());
+  std::shared_ptr<Connection> connection;
+  std::size_t numberOfConnections;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    connection = getConnectionInternal(connectionId);
+    if (!connection)
+    {
+      LOG_ERROR("%s: connectionId: %lu not found", __func__, connectionId);
+      return;
+    }
+
+    // The id is invalid from now on
+    auto& slot = connectionSlots_[getConnectionIndex(connectionId)];
+    slot.generation++;
+    slot.open = false;
+    numberOfConnections = --numberOfConnections_;
+  }
+  LOG_DEBUG("onConnectionClosed() connectionId: %lu no connections: %lu",
+              connectionId, numberOfConnections);
+
+  auto stats = connection->getStats();
+  connection.reset();
+  if (stats.droppedPackets > 0)
+  {
+    LOG_INFO("%s: connectionId: %lu dropped %lu packets (%lu bytes), peak send queue: %lu bytes",
+             __func__, connectionId, stats.droppedPackets, stats.droppedBytes, stats.peakQueuedBytes);
+  }
+
   callbacks_.onClientDisconnected(connectionId);
+
+  // Don't reuse the slot until the disconnect has been handled, so that data kept per
+  // connection index (see getConnectionIndex) can't be mixed up with a new Connection's
+  std::lock_guard<std::mutex> lock(mutex_);
+  freeConnectionSlots_.push_back(getConnectionIndex(connectionId));
 }
 
 void Server::onPacketReceived(ConnectionId connectionId, IncomingPacket* packet)
 {
-  LOG_DEBUG("onPacketReceived() connectionId: %d", connectionId);
+  LOG_DEBUG("onPacketReceived() connectionId: %lu", connectionId);
   callbacks_.onPacketReceived(connectionId, packet);
 }
@@ -25,17 +25,26 @@
 #ifndef NETWORK_SERVER_H_
 #define NETWORK_SERVER_H_
 
+#include <chrono>
+#include <cstdint>
 #include <memory>
-#include <unordered_map>
+#include <mutex>
+#include <vector>
 #include <boost/asio.hpp>  //NOLINT
 #include "acceptor.h"
 #include "connection.h"
+#ifdef WITH_IO_URING
+#include "uringservice.h"
+#endif
 
 // Forward declarations
 class IncomingPacket;
 class OutgoingPacket;
 
-using ConnectionId = int;
+// A ConnectionId is the index of the Connection's slot in the Server (lower 32 bits) and
+// the slot's generation (upper 32 bits). The generation is incremented when the
+// Connection is closed, so the id of a closed Connection never refers to a newer one
+using ConnectionId = uint64_t;
 
 class Server
 {
@@ -47,8 +56,21 @@ class Server
     std::function<void(ConnectionId, IncomingPacket*)> onPacketReceived;
   };
 
+  // The ASIO backend does the network I/O on io_service, while the IO_URING backend has
+  // its own thread, see UringService. It is only available if built WITH_IO_URING
+  enum Backend
+  {
+    ASIO,
+    IO_URING,
+  };
+
   Server(boost::asio::io_service* io_service,
+         Backend backend,
          unsigned short port,
+         int numberOfAcceptors,
+         std::size_t maxBytesPerWrite,
+         std::size_t maxQueuedBytes,
+         int slowClientTimeout,
          const Callbacks& callbacks);
   virtual ~Server();
 
@@ -59,22 +81,86 @@ class Server
   bool start();
   void stop();
 
-  void sendPacket(ConnectionId connectionId, const OutgoingPacket& packet);
+  // Packets sent to a Connection are buffered until flush() is called, which
+  // happens automatically once the current handler has returned
+  // The packet is moved into the Connection, no data is copied
+  // These functions, and closeConnection, can be called from any thread
+  void sendPacket(ConnectionId connectionId, OutgoingPacket&& packet);
+  void sendPacket(ConnectionId connectionId, const std::shared_ptr<const OutgoingPacket>& packet);
   void closeConnection(ConnectionId connectionId);
+  void flush();
+
+  // Returns false if there is no such Connection, i.e. it has been closed
+  bool isConnectionOpen(ConnectionId connectionId);
+
+  // Returns false if there is no such Connection
+  bool getConnectionStats(ConnectionId connectionId, Connection::Stats* stats);
+
+  // Pending packets are flushed by a handler posted to this io_service, by default the
+  // Server's own. Set it to the io_service that sends the packets (e.g. the game thread)
+  // so that the flush happens when that io_service's current handler has returned
+  void setFlushIoService(boost::asio::io_service* io_service);
+
+  // Slots are reused, so the index is dense and can be used to index e.g. a vector
+  static std::size_t getConnectionIndex(ConnectionId connectionId) { return connectionId & 0xFFFFFFFF; }
 
   // Handler for Acceptor
   void onAccept(boost::asio::ip::tcp::socket socket);
 
+#ifdef WITH_IO_URING
+  // Handler for UringService
+  void onAccept(int fd);
+#endif
+
   // Handler for Connection
   void onConnectionClosed(ConnectionId connectionId);
   void onPacketReceived(ConnectionId connectionId, IncomingPacket* packet);
 
  private:
-  Acceptor acceptor_;
+  // These must be called with mutex_ locked
+  std::shared_ptr<Connection> getConnectionInternal(ConnectionId connectionId) const;
+
+  std::shared_ptr<Connection> getConnection(ConnectionId connectionId);
+  void addPendingConnection(ConnectionId connectionId);
+
+  // Puts a new Connection in a free slot and starts it. createConnection is called with
+  // the slot's previous Connection, to reset it, or an empty pointer to set
+  template<typename CreateConnection>
+  void addConnection(const CreateConnection& createConnection);
+
+  Backend backend_;
+  bool listening_;
+
+  // With more than one Acceptor they all listen on the port with SO_REUSEPORT
+  std::vector<std::unique_ptr<Acceptor>> acceptors_;
+#ifdef WITH_IO_URING
+  std::unique_ptr<UringService> uringService_;
+#endif
+  std::size_t maxBytesPerWrite_;
+  std::size_t maxQueuedBytes_;
+  std::chrono::seconds slowClientTimeout_;
   Callbacks callbacks_;
 
-  ConnectionId nextConnectionId_;
-  std::unordered_map<ConnectionId, std::unique_ptr<Connection>> connections_;
+  // Protects the members below, the Server is used both from network and game threads
+  std::mutex mutex_;
+
+  boost::asio::io_service* flushIoService_;
+
+  // Connections are kept in their slot when closed and reused by a later Connection
+  // in the same slot, once all of its handlers have completed
+  struct ConnectionSlot
+  {
+    std::shared_ptr<Connection> connection;
+    uint32_t generation;
+    bool open;
+  };
+  std::vector<ConnectionSlot> connectionSlots_;
+  std::vector<std::size_t> freeConnectionSlots_;
+  std::size_t numberOfConnections_;
+
+  // Connections with packets that have not yet been flushed
+  std::vector<ConnectionId> pendingConnectionIds_;
+  bool flushPosted_;
 };
 
 #endif  // NETWORK_SERVER_H_
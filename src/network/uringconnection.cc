@@ -0,0 +1,254 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "uringconnection.h"
+
+#include <linux/io_uring.h>
+#include <sys/socket.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "uringservice.h"
+#include "logger.h"
+
+UringConnection::UringConnection(UringService* service,
+                                 int fd,
+                                 std::size_t maxBytesPerWrite,
+                                 std::size_t maxQueuedBytes,
+                                 std::chrono::steady_clock::duration slowClientTimeout,
+                                 const Callbacks& callbacks)
+  : Connection(maxBytesPerWrite, maxQueuedBytes, slowClientTimeout, callbacks),
+    service_(service),
+    fd_(fd),
+    socketClosed_(false),
+    requestedBuffer_(nullptr),
+    requestedLength_(0),
+    sendBufferIndex_(0)
+{
+  std::memset(&sendMessage_, 0, sizeof(sendMessage_));
+}
+
+UringConnection::~UringConnection()
+{
+  // Does nothing if the Connection already is closed
+  close(false);
+}
+
+void UringConnection::reset(int fd, const Callbacks& callbacks)
+{
+  fd_ = fd;
+  socketClosed_ = false;
+  receiveError_.clear();
+  requestedBuffer_ = nullptr;
+  Connection::reset(callbacks);
+}
+
+void UringConnection::onReceiveCompleted(int result, uint32_t flags)
+{
+  // Keep the Connection alive until the data has been delivered
+  auto self = receiveSelf_;
+
+  if (result > 0)
+  {
+    receivedData_.push_back({ static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT),
+                              0,
+                              static_cast<std::size_t>(result) });
+  }
+
+  if (!(flags & IORING_CQE_F_MORE))
+  {
+    if (socketClosed_)
+    {
+      receiveSelf_.reset();
+    }
+    else if (result > 0 || result == -ENOBUFS)
+    {
+      // The receive was stopped (e.g. as the kernel ran out of buffers) but the socket
+      // is still fine, so just restart it
+      service_->submitReceive(fd_, this);
+    }
+    else
+    {
+      receiveError_ = (result == 0) ? boost::asio::error::eof
+                                    : boost::system::error_code(-result, boost::system::system_category());
+      receiveSelf_.reset();
+    }
+  }
+
+  deliverReceivedData();
+
+  if (!receiveSelf_)
+  {
+    // Nothing more will be read
+    returnReceivedData();
+  }
+}
+
+void UringConnection::onSendCompleted(int result)
+{
+  if (result < 0)
+  {
+    auto self = std::move(sendSelf_);
+    onPacketsSent(boost::system::error_code(-result, boost::system::system_category()));
+    return;
+  }
+
+  // Skip the buffers that have been sent and send the rest, if any
+  auto length = static_cast<std::size_t>(result);
+  while (sendBufferIndex_ < sendBuffers_.size() && length >= sendBuffers_[sendBufferIndex_].iov_len)
+  {
+    length -= sendBuffers_[sendBufferIndex_].iov_len;
+    sendBufferIndex_++;
+  }
+
+  if (sendBufferIndex_ < sendBuffers_.size())
+  {
+    auto& buffer = sendBuffers_[sendBufferIndex_];
+    buffer.iov_base = static_cast<uint8_t*>(buffer.iov_base) + length;
+    buffer.iov_len -= length;
+    submitSend();
+    return;
+  }
+
+  auto self = std::move(sendSelf_);
+  onPacketsSent(boost::system::error_code());
+}
+
+void UringConnection::asyncReceive(uint8_t* buffer, std::size_t length)
+{
+  requestedBuffer_ = buffer;
+  requestedLength_ = length;
+
+  // Start the multishot receive on the first read, any received data for later reads is
+  // delivered by onReceiveCompleted
+  if (!receiveSelf_ && !receiveError_)
+  {
+    receiveSelf_ = shared_from_this();
+    service_->submitReceive(fd_, this);
+  }
+}
+
+void UringConnection::asyncSend(const std::vector<boost::asio::const_buffer>& buffers)
+{
+  if (socketClosed_)
+  {
+    // The fd may already have been closed and reused
+    return;
+  }
+
+  sendBuffers_.clear();
+  for (const auto& buffer : buffers)
+  {
+    sendBuffers_.push_back({ const_cast<void*>(buffer.data()), buffer.size() });
+  }
+  sendBufferIndex_ = 0;
+
+  // The write is submitted by the ring thread, together with all other writes that are
+  // posted before it wakes up
+  sendSelf_ = shared_from_this();
+  service_->post([this]()
+  {
+    submitSend();
+  });
+}
+
+void UringConnection::closeSocket()
+{
+  socketClosed_ = true;
+
+  // This makes the pending operations complete, the fd is closed later by the ring thread
+  if (::shutdown(fd_, SHUT_RDWR) < 0)
+  {
+    LOG_ERROR("%s: Could not shutdown socket: %s", __func__, std::strerror(errno));
+  }
+  service_->closeSocket(fd_);
+}
+
+void UringConnection::post(const std::function<void(void)>& handler)
+{
+  service_->post(handler);
+}
+
+void UringConnection::submitSend()
+{
+  if (socketClosed_)
+  {
+    auto self = std::move(sendSelf_);
+    onPacketsSent(boost::asio::error::operation_aborted);
+    return;
+  }
+
+  sendMessage_.msg_iov = sendBuffers_.data() + sendBufferIndex_;
+  sendMessage_.msg_iovlen = sendBuffers_.size() - sendBufferIndex_;
+  service_->submitSend(fd_, &sendMessage_, this);
+}
+
+void UringConnection::deliverReceivedData()
+{
+  if (socketClosed_)
+  {
+    // Like a read that is aborted when a socket is closed
+    if (requestedBuffer_)
+    {
+      requestedBuffer_ = nullptr;
+      onDataReceived(boost::asio::error::operation_aborted, 0);
+    }
+    return;
+  }
+
+  // onDataReceived requests the next read (unless the Connection was closed)
+  while (requestedBuffer_ && !receivedData_.empty())
+  {
+    auto& data = receivedData_.front();
+    auto length = std::min(requestedLength_, data.length);
+    std::memcpy(requestedBuffer_, service_->getBuffer(data.bufferId) + data.offset, length);
+    data.offset += length;
+    data.length -= length;
+    if (data.length == 0)
+    {
+      service_->returnBuffer(data.bufferId);
+      receivedData_.erase(receivedData_.begin());
+    }
+
+    requestedBuffer_ = nullptr;
+    onDataReceived(boost::system::error_code(), length);
+  }
+
+  if (requestedBuffer_ && receiveError_)
+  {
+    requestedBuffer_ = nullptr;
+    onDataReceived(receiveError_, 0);
+  }
+}
+
+void UringConnection::returnReceivedData()
+{
+  for (const auto& data : receivedData_)
+  {
+    service_->returnBuffer(data.bufferId);
+  }
+  receivedData_.clear();
+}
@@ -0,0 +1,104 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NETWORK_URINGCONNECTION_H_
+#define NETWORK_URINGCONNECTION_H_
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <boost/asio.hpp>  //NOLINT
+#include "connection.h"
+
+class UringService;
+
+// A Connection that does its I/O with a UringService
+// Connection expects one read at a time into its own buffer, while the socket has a
+// multishot receive that fills buffers from the UringService's buffer ring, so received
+// buffers are kept here until they have been copied to the requested read
+class UringConnection : public Connection
+{
+ public:
+  UringConnection(UringService* service,
+                  int fd,
+                  std::size_t maxBytesPerWrite,
+                  std::size_t maxQueuedBytes,
+                  std::chrono::steady_clock::duration slowClientTimeout,
+                  const Callbacks& callbacks);
+  ~UringConnection();
+
+  // Reuses a closed Connection for a new socket, see Connection::reset
+  // Must be called on the ring thread
+  void reset(int fd, const Callbacks& callbacks);
+
+  // Completion handlers, called by UringService on the ring thread
+  void onReceiveCompleted(int result, uint32_t flags);
+  void onSendCompleted(int result);
+
+ private:
+  // From Connection
+  // Reads are only requested on the ring thread: when the Connection is started (by
+  // Server::onAccept) and from onDataReceived
+  void asyncReceive(uint8_t* buffer, std::size_t length) override;
+  void asyncSend(const std::vector<boost::asio::const_buffer>& buffers) override;
+  void closeSocket() override;
+  void post(const std::function<void(void)>& handler) override;
+
+  void submitSend();
+  void deliverReceivedData();
+  void returnReceivedData();
+
+  UringService* service_;
+  int fd_;
+
+  // Set by closeSocket, after which nothing more is submitted for fd_
+  std::atomic<bool> socketClosed_;
+
+  // Receive state, only used on the ring thread
+  // receiveSelf_ keeps the Connection alive while the multishot receive is active
+  struct ReceivedData
+  {
+    uint16_t bufferId;
+    std::size_t offset;
+    std::size_t length;
+  };
+  std::shared_ptr<Connection> receiveSelf_;
+  std::vector<ReceivedData> receivedData_;
+  boost::system::error_code receiveError_;
+  uint8_t* requestedBuffer_;
+  std::size_t requestedLength_;
+
+  // Send state, the write in progress
+  std::shared_ptr<Connection> sendSelf_;
+  std::vector<iovec> sendBuffers_;
+  std::size_t sendBufferIndex_;
+  msghdr sendMessage_;
+};
+
+#endif  // NETWORK_URINGCONNECTION_H_
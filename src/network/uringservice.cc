@@ -0,0 +1,668 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "uringservice.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <future>
+
+#include "uringconnection.h"
+#include "logger.h"
+
+UringService::UringService(unsigned short port, const Callbacks& callbacks)
+  : port_(port),
+    callbacks_(callbacks),
+    listenFd_(-1),
+    wakeupFd_(-1),
+    wakeupValue_(0),
+    ringFd_(-1),
+    sqRing_(MAP_FAILED),
+    sqRingSize_(0),
+    cqRing_(MAP_FAILED),
+    cqRingSize_(0),
+    sqes_(static_cast<io_uring_sqe*>(MAP_FAILED)),
+    sqesSize_(0),
+    sqHead_(nullptr),
+    sqTail_(nullptr),
+    sqMask_(0),
+    sqEntries_(0),
+    cqHead_(nullptr),
+    cqTail_(nullptr),
+    cqMask_(0),
+    cqes_(nullptr),
+    sqeSubmitted_(0),
+    sqeTail_(0),
+    bufferRing_(static_cast<io_uring_buf*>(MAP_FAILED)),
+    bufferRingSize_(0),
+    bufferRingTail_(0),
+    stopping_(false),
+    pendingOperations_(0)
+{
+  static_assert(alignof(UringConnection) > OPERATION_MASK && alignof(UringService) > OPERATION_MASK,
+                "The operation doesn't fit in user_data");
+}
+
+UringService::~UringService()
+{
+  if (thread_.joinable())
+  {
+    stop();
+    join();
+  }
+
+  // Closing the ring cancels the remaining operations (i.e. the wakeup read)
+  if (sqes_ != MAP_FAILED)
+  {
+    munmap(sqes_, sqesSize_);
+  }
+  if (cqRing_ != MAP_FAILED && cqRing_ != sqRing_)
+  {
+    munmap(cqRing_, cqRingSize_);
+  }
+  if (sqRing_ != MAP_FAILED)
+  {
+    munmap(sqRing_, sqRingSize_);
+  }
+  if (ringFd_ >= 0)
+  {
+    close(ringFd_);
+  }
+  if (bufferRing_ != MAP_FAILED)
+  {
+    munmap(bufferRing_, bufferRingSize_);
+  }
+  if (listenFd_ >= 0)
+  {
+    close(listenFd_);
+  }
+  if (wakeupFd_ >= 0)
+  {
+    close(wakeupFd_);
+  }
+}
+
+bool UringService::start()
+{
+  if (!setupRing() || !setupBufferRing() || !probeReceive() || !setupSockets())
+  {
+    return false;
+  }
+
+  LOG_INFO("%s: Listening on port %d with io_uring", __func__, port_);
+  thread_ = std::thread(&UringService::run, this);
+  return true;
+}
+
+void UringService::stop()
+{
+  // Wait until the ring thread has stopped accepting, so that no more connections are
+  // passed to onAccept after this returns
+  std::promise<void> stopped;
+  post([this, &stopped]()
+  {
+    stopping_ = true;
+
+    // The accept completes with -ECANCELED
+    auto sqe = getSqe(CANCEL, this);
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = reinterpret_cast<uint64_t>(this) | ACCEPT;
+
+    stopped.set_value();
+  });
+  stopped.get_future().wait();
+}
+
+void UringService::join()
+{
+  thread_.join();
+}
+
+void UringService::post(const std::function<void(void)>& handler)
+{
+  bool wasEmpty;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    wasEmpty = handlers_.empty();
+    handlers_.push_back(handler);
+  }
+
+  // The ring thread checks for handlers before it waits, so it only needs to be woken up
+  // when this is the first handler and it's posted from another thread
+  if (wasEmpty && std::this_thread::get_id() != threadId_)
+  {
+    uint64_t value = 1;
+    if (write(wakeupFd_, &value, sizeof(value)) < 0)
+    {
+      LOG_ERROR("%s: Could not wake up ring thread: %s", __func__, std::strerror(errno));
+    }
+  }
+}
+
+void UringService::closeSocket(int fd)
+{
+  post([this, fd]()
+  {
+    socketsToClose_.push_back(fd);
+  });
+}
+
+void UringService::submitReceive(int fd, UringConnection* connection)
+{
+  auto sqe = getSqe(RECEIVE, connection);
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = fd;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = BUFFER_GROUP;
+  pendingOperations_++;
+}
+
+void UringService::submitSend(int fd, const msghdr* message, UringConnection* connection)
+{
+  auto sqe = getSqe(SEND, connection);
+  sqe->opcode = IORING_OP_SENDMSG;
+  sqe->fd = fd;
+  sqe->addr = reinterpret_cast<uint64_t>(message);
+  sqe->len = 1;
+  sqe->msg_flags = MSG_NOSIGNAL;
+  pendingOperations_++;
+}
+
+void UringService::returnBuffer(uint16_t bufferId)
+{
+  // Don't overwrite the tail, which is in the first entry
+  auto& buffer = bufferRing_[bufferRingTail_ & (NUMBER_OF_BUFFERS - 1)];
+  buffer.addr = reinterpret_cast<uint64_t>(getBuffer(bufferId));
+  buffer.len = BUFFER_SIZE;
+  buffer.bid = bufferId;
+  bufferRingTail_++;
+  __atomic_store_n(&bufferRing_[0].resv, bufferRingTail_, __ATOMIC_RELEASE);
+}
+
+bool UringService::setupRing()
+{
+  io_uring_params params;
+  std::memset(&params, 0, sizeof(params));
+  ringFd_ = syscall(__NR_io_uring_setup, RING_ENTRIES, &params);
+  if (ringFd_ < 0)
+  {
+    LOG_ERROR("%s: Could not set up io_uring: %s", __func__, std::strerror(errno));
+    return false;
+  }
+
+  if (!(params.features & IORING_FEAT_NODROP))
+  {
+    LOG_ERROR("%s: io_uring is too old, IORING_FEAT_NODROP is needed", __func__);
+    return false;
+  }
+
+  sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP)
+  {
+    sqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+  }
+
+  sqRing_ = mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                 ringFd_, IORING_OFF_SQ_RING);
+  if (sqRing_ == MAP_FAILED)
+  {
+    LOG_ERROR("%s: Could not map the submission queue: %s", __func__, std::strerror(errno));
+    return false;
+  }
+
+  if (params.features & IORING_FEAT_SINGLE_MMAP)
+  {
+    cqRing_ = sqRing_;
+  }
+  else
+  {
+    cqRing_ = mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   ringFd_, IORING_OFF_CQ_RING);
+    if (cqRing_ == MAP_FAILED)
+    {
+      LOG_ERROR("%s: Could not map the completion queue: %s", __func__, std::strerror(errno));
+      return false;
+    }
+  }
+
+  sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+  sqes_ = static_cast<io_uring_sqe*>(mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                          ringFd_, IORING_OFF_SQES));
+  if (sqes_ == MAP_FAILED)
+  {
+    LOG_ERROR("%s: Could not map the submission queue entries: %s", __func__, std::strerror(errno));
+    return false;
+  }
+
+  auto sqRing = static_cast<uint8_t*>(sqRing_);
+  auto cqRing = static_cast<uint8_t*>(cqRing_);
+  sqHead_ = reinterpret_cast<unsigned*>(sqRing + params.sq_off.head);
+  sqTail_ = reinterpret_cast<unsigned*>(sqRing + params.sq_off.tail);
+  sqMask_ = *reinterpret_cast<unsigned*>(sqRing + params.sq_off.ring_mask);
+  sqEntries_ = params.sq_entries;
+  cqHead_ = reinterpret_cast<unsigned*>(cqRing + params.cq_off.head);
+  cqTail_ = reinterpret_cast<unsigned*>(cqRing + params.cq_off.tail);
+  cqMask_ = *reinterpret_cast<unsigned*>(cqRing + params.cq_off.ring_mask);
+  cqes_ = reinterpret_cast<io_uring_cqe*>(cqRing + params.cq_off.cqes);
+
+  // SQEs are always submitted in order, so the index array is the identity
+  auto sqArray = reinterpret_cast<unsigned*>(sqRing + params.sq_off.array);
+  for (unsigned i = 0; i < sqEntries_; i++)
+  {
+    sqArray[i] = i;
+  }
+  sqeSubmitted_ = sqeTail_ = *sqTail_;
+
+  return true;
+}
+
+bool UringService::setupBufferRing()
+{
+  bufferRingSize_ = NUMBER_OF_BUFFERS * sizeof(io_uring_buf);
+  bufferRing_ = static_cast<io_uring_buf*>(mmap(nullptr, bufferRingSize_, PROT_READ | PROT_WRITE,
+                                                MAP_ANONYMOUS | MAP_PRIVATE, -1, 0));
+  if (bufferRing_ == MAP_FAILED)
+  {
+    LOG_ERROR("%s: Could not allocate the buffer ring: %s", __func__, std::strerror(errno));
+    return false;
+  }
+
+  io_uring_buf_reg reg;
+  std::memset(&reg, 0, sizeof(reg));
+  reg.ring_addr = reinterpret_cast<uint64_t>(bufferRing_);
+  reg.ring_entries = NUMBER_OF_BUFFERS;
+  reg.bgid = BUFFER_GROUP;
+  if (syscall(__NR_io_uring_register, ringFd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+  {
+    LOG_ERROR("%s: Could not register the buffer ring: %s", __func__, std::strerror(errno));
+    return false;
+  }
+
+  buffers_.resize(NUMBER_OF_BUFFERS * BUFFER_SIZE);
+  for (unsigned i = 0; i < NUMBER_OF_BUFFERS; i++)
+  {
+    returnBuffer(i);
+  }
+
+  return true;
+}
+
+bool UringService::probeReceive()
+{
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0)
+  {
+    LOG_ERROR("%s: Could not create socketpair: %s", __func__, std::strerror(errno));
+    return false;
+  }
+
+  // Queue some data first, so that the receive completes right away
+  uint8_t data = 0;
+  if (write(fds[1], &data, sizeof(data)) < 0)
+  {
+    LOG_ERROR("%s: Could not write to socketpair: %s", __func__, std::strerror(errno));
+    close(fds[0]);
+    close(fds[1]);
+    return false;
+  }
+
+  auto sqe = getSqe(PROBE, this);
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = fds[0];
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = BUFFER_GROUP;
+
+  // Wait until the receive has completed, cancel it if it is still armed
+  auto firstResult = 0;
+  auto completed = false;
+  auto cancelled = false;
+  auto done = false;
+  while (!done)
+  {
+    if (!submit(true))
+    {
+      close(fds[0]);
+      close(fds[1]);
+      return false;
+    }
+
+    auto head = *cqHead_;
+    auto tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++)
+    {
+      const auto& cqe = cqes_[head & cqMask_];
+      if ((cqe.user_data & OPERATION_MASK) != PROBE)
+      {
+        // The cancel
+        continue;
+      }
+
+      if (!completed)
+      {
+        firstResult = cqe.res;
+        completed = true;
+      }
+      if (cqe.res > 0)
+      {
+        returnBuffer(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+      }
+
+      if (!(cqe.flags & IORING_CQE_F_MORE))
+      {
+        done = true;
+      }
+      else if (!cancelled)
+      {
+        auto cancelSqe = getSqe(CANCEL, this);
+        cancelSqe->opcode = IORING_OP_ASYNC_CANCEL;
+        cancelSqe->fd = -1;
+        cancelSqe->addr = reinterpret_cast<uint64_t>(this) | PROBE;
+        cancelled = true;
+      }
+    }
+    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+  }
+
+  close(fds[0]);
+  close(fds[1]);
+
+  if (firstResult == -EINVAL)
+  {
+    LOG_ERROR("%s: io_uring is too old, multishot receive is needed (Linux 6.0 or later)", __func__);
+    return false;
+  }
+  else if (firstResult < 0)
+  {
+    LOG_ERROR("%s: Could not receive: %s", __func__, std::strerror(-firstResult));
+    return false;
+  }
+
+  return true;
+}
+
+bool UringService::setupSockets()
+{
+  wakeupFd_ = eventfd(0, EFD_CLOEXEC);
+  if (wakeupFd_ < 0)
+  {
+    LOG_ERROR("%s: Could not create eventfd: %s", __func__, std::strerror(errno));
+    return false;
+  }
+
+  listenFd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listenFd_ < 0)
+  {
+    LOG_ERROR("%s: Could not create socket: %s", __func__, std::strerror(errno));
+    return false;
+  }
+
+  int enable = 1;
+  setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+  sockaddr_in address;
+  std::memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(port_);
+  if (bind(listenFd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+      listen(listenFd_, SOMAXCONN) < 0)
+  {
+    LOG_ERROR("%s: Could not listen on port %d: %s", __func__, port_, std::strerror(errno));
+    return false;
+  }
+
+  return true;
+}
+
+io_uring_sqe* UringService::getSqe(Operation operation, const void* object)
+{
+  // The kernel consumes the submitted SQEs during the system call, but it may not be able
+  // to consume any until the completion queue has room, so process completions until it has
+  while (sqeTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_)
+  {
+    if (!submit(false))
+    {
+      abort();
+    }
+    if (sqeTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_)
+    {
+      processCompletions();
+    }
+  }
+
+  auto sqe = &sqes_[sqeTail_ & sqMask_];
+  sqeTail_++;
+
+  std::memset(sqe, 0, sizeof(*sqe));
+  sqe->user_data = reinterpret_cast<uint64_t>(object) | operation;
+  return sqe;
+}
+
+bool UringService::submit(bool wait)
+{
+  __atomic_store_n(sqTail_, sqeTail_, __ATOMIC_RELEASE);
+
+  while (true)
+  {
+    // GETEVENTS also flushes completions that didn't fit in the completion queue
+    auto toSubmit = sqeTail_ - sqeSubmitted_;
+    auto result = syscall(__NR_io_uring_enter, ringFd_, toSubmit, wait ? 1 : 0, IORING_ENTER_GETEVENTS, nullptr, 0);
+    if (result >= 0)
+    {
+      // The kernel may consume fewer SQEs than given (and then it doesn't wait), the rest
+      // are still in the submission queue and are submitted next time
+      sqeSubmitted_ += result;
+      return true;
+    }
+
+    if (errno == EBUSY || errno == EAGAIN)
+    {
+      // The completion queue has overflowed, or the kernel is out of memory, nothing was
+      // submitted. Completions must be processed before anything more can be submitted
+      return true;
+    }
+    else if (errno != EINTR)
+    {
+      LOG_ERROR("%s: Could not submit: %s", __func__, std::strerror(errno));
+      return false;
+    }
+  }
+}
+
+void UringService::run()
+{
+  threadId_ = std::this_thread::get_id();
+
+  submitWakeup();
+  submitAccept();
+
+  while (!stopping_ || pendingOperations_ > 0)
+  {
+    runHandlers();
+
+    // Don't wait if a handler posted another handler
+    bool wait;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      wait = handlers_.empty();
+    }
+    if (!submit(wait))
+    {
+      abort();
+    }
+
+    // Only close the sockets when all operations on them have been submitted
+    if (sqeSubmitted_ == sqeTail_)
+    {
+      for (auto fd : socketsToClose_)
+      {
+        close(fd);
+      }
+      socketsToClose_.clear();
+    }
+
+    processCompletions();
+  }
+
+  LOG_INFO("%s: Ring thread stopped", __func__);
+}
+
+void UringService::runHandlers()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    runningHandlers_.swap(handlers_);
+  }
+
+  for (const auto& handler : runningHandlers_)
+  {
+    handler();
+  }
+  runningHandlers_.clear();
+}
+
+void UringService::processCompletions()
+{
+  // The head is read again for each CQE, as a handler may call this function again (from
+  // getSqe) and process the following CQEs
+  while (true)
+  {
+    auto head = *cqHead_;
+    if (head == __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE))
+    {
+      break;
+    }
+
+    // Copy the CQE and give the slot back before handling it, as the handler may submit
+    const auto& cqe = cqes_[head & cqMask_];
+    auto userData = cqe.user_data;
+    auto result = cqe.res;
+    auto flags = cqe.flags;
+    head++;
+    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+
+    auto operation = userData & OPERATION_MASK;
+    auto object = reinterpret_cast<void*>(userData & ~OPERATION_MASK);
+    if ((operation == ACCEPT || operation == RECEIVE || operation == SEND) &&
+        !(flags & IORING_CQE_F_MORE))
+    {
+      pendingOperations_--;
+    }
+
+    switch (operation)
+    {
+      case ACCEPT:
+      {
+        onAccept(result, flags);
+        break;
+      }
+
+      case WAKEUP:
+      {
+        submitWakeup();
+        break;
+      }
+
+      case CANCEL:
+      {
+        break;
+      }
+
+      case RECEIVE:
+      {
+        static_cast<UringConnection*>(object)->onReceiveCompleted(result, flags);
+        break;
+      }
+
+      case SEND:
+      {
+        static_cast<UringConnection*>(object)->onSendCompleted(result);
+        break;
+      }
+
+      default:
+      {
+        LOG_ERROR("%s: Unknown operation: %lu", __func__, operation);
+        break;
+      }
+    }
+  }
+}
+
+void UringService::submitAccept()
+{
+  auto sqe = getSqe(ACCEPT, this);
+  sqe->opcode = IORING_OP_ACCEPT;
+  sqe->fd = listenFd_;
+  sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+  sqe->accept_flags = SOCK_CLOEXEC;
+  pendingOperations_++;
+}
+
+void UringService::submitWakeup()
+{
+  auto sqe = getSqe(WAKEUP, this);
+  sqe->opcode = IORING_OP_READ;
+  sqe->fd = wakeupFd_;
+  sqe->addr = reinterpret_cast<uint64_t>(&wakeupValue_);
+  sqe->len = sizeof(wakeupValue_);
+}
+
+void UringService::onAccept(int result, uint32_t flags)
+{
+  if (result >= 0)
+  {
+    if (stopping_)
+    {
+      // Accepted before the cancel
+      close(result);
+    }
+    else
+    {
+      LOG_INFO("Accepted connection");
+      callbacks_.onAccept(result);
+    }
+  }
+  else if (result != -ECANCELED)
+  {
+    LOG_ERROR("%s: Could not accept connection: %s", __func__, std::strerror(-result));
+  }
+
+  if (!(flags & IORING_CQE_F_MORE) && !stopping_)
+  {
+    submitAccept();
+  }
+}
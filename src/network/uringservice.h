@@ -0,0 +1,177 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NETWORK_URINGSERVICE_H_
+#define NETWORK_URINGSERVICE_H_
+
+#include <linux/io_uring.h>
+#include <sys/socket.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class UringConnection;
+
+// An event loop on a Linux io_uring, used by the IO_URING Server backend instead of
+// boost::asio. It runs on its own thread (the ring thread) and:
+//  - accepts connections with one multishot accept
+//  - receives with multishot receives into a ring of buffers provided to the kernel
+//  - collects the writes from all threads and submits them together, with one
+//    system call per loop iteration
+// The kernel interface is used directly, there is no dependency on liburing
+class UringService
+{
+ public:
+  struct Callbacks
+  {
+    // Called on the ring thread with each accepted socket
+    std::function<void(int)> onAccept;
+  };
+
+  UringService(unsigned short port, const Callbacks& callbacks);
+  virtual ~UringService();
+
+  // Delete copy constructors
+  UringService(const UringService&) = delete;
+  UringService& operator=(const UringService&) = delete;
+
+  // Sets up the ring, starts to listen and starts the ring thread
+  bool start();
+
+  // Stops accepting connections. The ring thread exits when all operations on the
+  // accepted sockets have completed, i.e. when they have been closed, see join()
+  // These must not be called on the ring thread
+  void stop();
+  void join();
+
+  // Can be called from any thread, handler is called on the ring thread
+  void post(const std::function<void(void)>& handler);
+
+  // Can be called from any thread, the socket is closed after all operations that have
+  // been prepared for it have been submitted, so that they can't use a reused fd
+  void closeSocket(int fd);
+
+  // These must be called on the ring thread
+  // A receive calls UringConnection::onReceiveCompleted, with a buffer from getBuffer(),
+  // until it completes without IORING_CQE_F_MORE. A send calls onSendCompleted
+  void submitReceive(int fd, UringConnection* connection);
+  void submitSend(int fd, const msghdr* message, UringConnection* connection);
+  const uint8_t* getBuffer(uint16_t bufferId) const { return buffers_.data() + bufferId * BUFFER_SIZE; }
+  void returnBuffer(uint16_t bufferId);
+
+  static const unsigned RING_ENTRIES = 4096;
+
+  // Receive buffers shared by all sockets, NUMBER_OF_BUFFERS must be a power of two
+  static const unsigned NUMBER_OF_BUFFERS = 2048;
+  static const std::size_t BUFFER_SIZE = 4096;
+
+ private:
+  // The type of operation is kept in the lower bits of the user_data of each request,
+  // and the rest is a pointer to the UringService or the UringConnection
+  enum Operation : uint64_t
+  {
+    ACCEPT,
+    WAKEUP,
+    CANCEL,
+    RECEIVE,
+    SEND,
+    PROBE,
+  };
+  static const uint64_t OPERATION_MASK = 0x7;
+
+  static const uint16_t BUFFER_GROUP = 0;
+
+  bool setupRing();
+  bool setupBufferRing();
+  bool setupSockets();
+
+  // Multishot receives need Linux 6.0, older kernels complete them with -EINVAL
+  // Returns false if a multishot receive on a socketpair fails
+  bool probeReceive();
+
+  io_uring_sqe* getSqe(Operation operation, const void* object);
+  // Submits the prepared SQEs, returns false if the ring can't be used anymore
+  // Not all SQEs may be submitted, e.g. if the completion queue has overflowed
+  bool submit(bool wait);
+
+  void run();
+  void runHandlers();
+  void processCompletions();
+
+  void submitAccept();
+  void submitWakeup();
+  void onAccept(int result, uint32_t flags);
+
+  unsigned short port_;
+  Callbacks callbacks_;
+  std::thread thread_;
+  std::atomic<std::thread::id> threadId_;
+
+  int listenFd_;
+  int wakeupFd_;
+  uint64_t wakeupValue_;
+
+  // The rings, which are shared with the kernel
+  int ringFd_;
+  void* sqRing_;
+  std::size_t sqRingSize_;
+  void* cqRing_;
+  std::size_t cqRingSize_;
+  io_uring_sqe* sqes_;
+  std::size_t sqesSize_;
+
+  unsigned* sqHead_;
+  unsigned* sqTail_;
+  unsigned sqMask_;
+  unsigned sqEntries_;
+  unsigned* cqHead_;
+  unsigned* cqTail_;
+  unsigned cqMask_;
+  io_uring_cqe* cqes_;
+
+  // The SQEs in [sqeSubmitted_, sqeTail_) have been prepared but not submitted
+  unsigned sqeSubmitted_;
+  unsigned sqeTail_;
+
+  // The provided buffers, the tail of the ring is in bufferRing_[0].resv
+  io_uring_buf* bufferRing_;
+  std::size_t bufferRingSize_;
+  uint16_t bufferRingTail_;
+  std::vector<uint8_t> buffers_;
+
+  // These are only used on the ring thread
+  bool stopping_;
+  std::size_t pendingOperations_;
+  std::vector<int> socketsToClose_;
+  std::vector<std::function<void(void)>> runningHandlers_;
+
+  std::mutex mutex_;
+  std::vector<std::function<void(void)>> handlers_;
+};
+
+#endif  // NETWORK_URINGSERVICE_H_
@@ -44,6 +44,7 @@ const std::unordered_map<std::string, Logger::Level> Logger::levels_ =
   { "tile.cc",            Level::LEVEL_DEBUG },
   { "world.cc",           Level::LEVEL_DEBUG },
   { "creature.cc",        Level::LEVEL_DEBUG },
+  { "creatureindex.cc",   Level::LEVEL_DEBUG },
   { "position.cc",        Level::LEVEL_DEBUG },
 
   // src/loginserver
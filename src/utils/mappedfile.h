@@ -0,0 +1,61 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef UTILS_MAPPEDFILE_H_
+#define UTILS_MAPPEDFILE_H_
+
+#include <cstddef>
+#include <string>
+
+// A read-only, memory-mapped file
+// The pages are only read from disk when accessed, and since they are backed by the file
+// they can be dropped by the kernel at any time instead of being swapped out
+class MappedFile
+{
+ public:
+  MappedFile();
+  ~MappedFile();
+
+  // Delete copy constructors
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  // Returns false if the file could not be opened or is empty
+  bool open(const std::string& filename);
+  void close();
+  bool isOpen() const { return data_ != nullptr; }
+
+  // Tells the kernel that the file will be read from start to end, so that it reads ahead
+  // more aggressively and drops pages that have been read
+  void adviseSequential() const;
+
+  const char* getData() const { return data_; }
+  std::size_t getSize() const { return size_; }
+
+ private:
+  const char* data_;
+  std::size_t size_;
+};
+
+#endif  // UTILS_MAPPEDFILE_H_
@@ -0,0 +1,149 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef UTILS_MPSCQUEUE_H_
+#define UTILS_MPSCQUEUE_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// A bounded lock-free multi-producer single-consumer queue (based on Dmitry Vyukov's
+// bounded MPMC queue). Every slot has a sequence number that tells if the slot is free
+// for the producer at that position or if it contains a value for the consumer.
+// Capacity must be a power of two. Values are copied into preallocated slots, so
+// push() and consume() never allocate.
+template<typename T, std::size_t Capacity>
+class MpscQueue
+{
+ public:
+  MpscQueue()
+  {
+    enqueuePosition_.value.store(0, std::memory_order_relaxed);
+    dequeuePosition_.value = 0;
+
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                  "Capacity must be a power of two");
+
+    for (std::size_t i = 0; i < Capacity; i++)
+    {
+      slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  // Delete copy constructors
+  MpscQueue(const MpscQueue&) = delete;
+  MpscQueue& operator=(const MpscQueue&) = delete;
+
+  // Can be called from any thread
+  // Returns false if the queue is full
+  bool push(const T& value)
+  {
+    auto position = enqueuePosition_.value.load(std::memory_order_relaxed);
+    while (true)
+    {
+      auto& slot = slots_[position & (Capacity - 1)];
+      auto sequence = slot.sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position);
+      if (diff == 0)
+      {
+        // The slot is free, try to claim it
+        if (enqueuePosition_.value.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+        {
+          slot.value = value;
+          slot.sequence.store(position + 1, std::memory_order_release);
+          return true;
+        }
+        // position has been updated by compare_exchange_weak
+      }
+      else if (diff < 0)
+      {
+        // The slot still contains a value that the consumer hasn't taken
+        return false;
+      }
+      else
+      {
+        // Another producer claimed the slot
+        position = enqueuePosition_.value.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Must only be called from the consumer thread
+  // Returns false if the queue is empty
+  bool pop(T* value)
+  {
+    return consume([value](const T& slotValue) { *value = slotValue; }, 1) == 1;
+  }
+
+  // Must only be called from the consumer thread
+  // Calls f with (a reference to) each value, in order, until the queue is empty or
+  // maxValues values have been consumed. Returns the number of consumed values
+  template<typename F>
+  std::size_t consume(const F& f, std::size_t maxValues)
+  {
+    std::size_t count = 0;
+    while (count < maxValues)
+    {
+      auto& slot = slots_[dequeuePosition_.value & (Capacity - 1)];
+      auto sequence = slot.sequence.load(std::memory_order_acquire);
+      if (sequence != dequeuePosition_.value + 1)
+      {
+        // Empty, or the producer at this position hasn't finished writing yet
+        break;
+      }
+
+      f(slot.value);
+      slot.sequence.store(dequeuePosition_.value + Capacity, std::memory_order_release);
+      dequeuePosition_.value++;
+      count++;
+    }
+    return count;
+  }
+
+  static constexpr std::size_t capacity() { return Capacity; }
+
+ private:
+  struct Slot
+  {
+    std::atomic<std::size_t> sequence;
+    T value;
+  };
+
+  // Keep the producers' and the consumer's positions on separate cache lines
+  // (padding instead of alignas, as operator new doesn't respect alignas in C++11)
+  template<typename U>
+  struct Padded
+  {
+    U value;
+    char padding[64 - sizeof(U)];
+  };
+
+  Padded<std::atomic<std::size_t>> enqueuePosition_;
+  Padded<std::size_t> dequeuePosition_;
+  std::array<Slot, Capacity> slots_;
+};
+
+#endif  // UTILS_MPSCQUEUE_H_
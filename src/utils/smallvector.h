@@ -0,0 +1,250 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef UTILS_SMALLVECTOR_H_
+#define UTILS_SMALLVECTOR_H_
+
+#include <cstddef>
+#include <algorithm>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// A vector that stores up to N elements inline, without any heap allocation
+// If more than N elements are added, the elements are moved to the heap
+template <class T, std::size_t N>
+class SmallVector
+{
+ public:
+  using value_type = T;
+  using size_type = std::size_t;
+  using iterator = T*;
+  using const_iterator = const T*;
+
+  SmallVector()
+    : data_(inlineData()),
+      size_(0),
+      capacity_(N)
+  {
+  }
+
+  SmallVector(std::initializer_list<T> init)
+    : SmallVector()
+  {
+    reserve(init.size());
+    for (const auto& value : init)
+    {
+      push_back(value);
+    }
+  }
+
+  SmallVector(const SmallVector& other)
+    : SmallVector()
+  {
+    reserve(other.size_);
+    std::uninitialized_copy(other.begin(), other.end(), data_);
+    size_ = other.size_;
+  }
+
+  SmallVector(SmallVector&& other)
+    : SmallVector()
+  {
+    moveFrom(&other);
+  }
+
+  ~SmallVector()
+  {
+    clear();
+    if (!isInline())
+    {
+      ::operator delete(data_);
+    }
+  }
+
+  SmallVector& operator=(const SmallVector& other)
+  {
+    if (this != &other)
+    {
+      clear();
+      reserve(other.size_);
+      std::uninitialized_copy(other.begin(), other.end(), data_);
+      size_ = other.size_;
+    }
+    return *this;
+  }
+
+  SmallVector& operator=(SmallVector&& other)
+  {
+    if (this != &other)
+    {
+      clear();
+      moveFrom(&other);
+    }
+    return *this;
+  }
+
+  iterator begin() { return data_; }
+  const_iterator begin() const { return data_; }
+  const_iterator cbegin() const { return data_; }
+  iterator end() { return data_ + size_; }
+  const_iterator end() const { return data_ + size_; }
+  const_iterator cend() const { return data_ + size_; }
+
+  T& operator[](size_type index) { return data_[index]; }
+  const T& operator[](size_type index) const { return data_[index]; }
+  T& front() { return data_[0]; }
+  const T& front() const { return data_[0]; }
+  T& back() { return data_[size_ - 1]; }
+  const T& back() const { return data_[size_ - 1]; }
+  T* data() { return data_; }
+  const T* data() const { return data_; }
+
+  bool empty() const { return size_ == 0; }
+  size_type size() const { return size_; }
+  size_type capacity() const { return capacity_; }
+
+  void reserve(size_type capacity)
+  {
+    if (capacity <= capacity_)
+    {
+      return;
+    }
+
+    auto* newData = static_cast<T*>(::operator new(capacity * sizeof(T)));
+    for (size_type i = 0; i < size_; i++)
+    {
+      new (newData + i) T(std::move(data_[i]));
+      data_[i].~T();
+    }
+    if (!isInline())
+    {
+      ::operator delete(data_);
+    }
+    data_ = newData;
+    capacity_ = capacity;
+  }
+
+  void clear()
+  {
+    for (size_type i = 0; i < size_; i++)
+    {
+      data_[i].~T();
+    }
+    size_ = 0;
+  }
+
+  void push_back(const T& value)
+  {
+    emplace_back(value);
+  }
+
+  void push_back(T&& value)
+  {
+    emplace_back(std::move(value));
+  }
+
+  template<class... Args>
+  void emplace_back(Args&&... args)
+  {
+    if (size_ == capacity_)
+    {
+      // args may refer to an element in this vector, so construct it before growing
+      T value(std::forward<Args>(args)...);
+      reserve(capacity_ * 2);
+      new (data_ + size_) T(std::move(value));
+    }
+    else
+    {
+      new (data_ + size_) T(std::forward<Args>(args)...);
+    }
+    size_++;
+  }
+
+  void pop_back()
+  {
+    size_--;
+    data_[size_].~T();
+  }
+
+  iterator insert(const_iterator position, const T& value)
+  {
+    auto index = position - data_;
+    T copy(value);
+    emplace_back(std::move(copy));
+    std::rotate(data_ + index, data_ + size_ - 1, data_ + size_);
+    return data_ + index;
+  }
+
+  iterator erase(const_iterator position)
+  {
+    auto index = position - data_;
+    std::move(data_ + index + 1, data_ + size_, data_ + index);
+    pop_back();
+    return data_ + index;
+  }
+
+ private:
+  using Storage = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+
+  T* inlineData() { return reinterpret_cast<T*>(inline_); }
+  bool isInline() const { return data_ == reinterpret_cast<const T*>(inline_); }
+
+  void moveFrom(SmallVector* other)
+  {
+    if (other->isInline())
+    {
+      // Need to move each element
+      for (size_type i = 0; i < other->size_; i++)
+      {
+        new (data_ + i) T(std::move(other->data_[i]));
+      }
+      size_ = other->size_;
+      other->clear();
+    }
+    else
+    {
+      // Steal the heap allocation
+      if (!isInline())
+      {
+        ::operator delete(data_);
+      }
+      data_ = other->data_;
+      size_ = other->size_;
+      capacity_ = other->capacity_;
+      other->data_ = other->inlineData();
+      other->size_ = 0;
+      other->capacity_ = N;
+    }
+  }
+
+  Storage inline_[N];
+  T* data_;
+  size_type size_;
+  size_type capacity_;
+};
+
+#endif  // UTILS_SMALLVECTOR_H_
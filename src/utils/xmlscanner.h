@@ -0,0 +1,296 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef UTILS_XMLSCANNER_H_
+#define UTILS_XMLSCANNER_H_
+
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// A minimal streaming XML scanner, which returns one element tag at a time directly from
+// a character buffer (e.g. a MappedFile), without building a document or copying anything
+// Text, comments, CDATA sections, processing instructions and DOCTYPEs are skipped, and
+// entities in attribute values are not decoded
+class XmlScanner
+{
+ public:
+  struct Element
+  {
+    enum class Type
+    {
+      START,  // <name ...>
+      END,    // </name>
+      EMPTY,  // <name ... />
+    };
+
+    Type type;
+    const char* name;
+    std::size_t nameLength;
+    const char* attributes;
+    const char* attributesEnd;
+
+    bool isNamed(const char* otherName) const
+    {
+      return std::strlen(otherName) == nameLength && std::strncmp(name, otherName, nameLength) == 0;
+    }
+
+    // Returns false if the attribute doesn't exist or if its value is not an integer that
+    // fits in an int
+    bool getAttribute(const char* attributeName, int* value) const
+    {
+      const char* valueBegin;
+      const char* valueEnd;
+      if (!findAttribute(attributeName, &valueBegin, &valueEnd) || valueBegin == valueEnd)
+      {
+        return false;
+      }
+
+      auto negative = *valueBegin == '-';
+      if (negative && ++valueBegin == valueEnd)
+      {
+        return false;
+      }
+
+      // Accumulate in a wider type, so that too long values can be detected without overflow
+      const uint64_t limit = negative ? static_cast<uint64_t>(INT_MAX) + 1 : INT_MAX;
+      uint64_t result = 0;
+      for (auto it = valueBegin; it < valueEnd; ++it)
+      {
+        if (*it < '0' || *it > '9')
+        {
+          return false;
+        }
+        result = (result * 10) + (*it - '0');
+        if (result > limit)
+        {
+          return false;
+        }
+      }
+      *value = negative ? static_cast<int>(-static_cast<int64_t>(result)) : static_cast<int>(result);
+      return true;
+    }
+
+   private:
+    bool findAttribute(const char* attributeName, const char** valueBegin, const char** valueEnd) const
+    {
+      auto attributeNameLength = std::strlen(attributeName);
+      auto it = attributes;
+      while (it < attributesEnd)
+      {
+        // Name
+        while (it < attributesEnd && isSpace(*it))
+        {
+          ++it;
+        }
+        auto nameBegin = it;
+        while (it < attributesEnd && *it != '=' && !isSpace(*it))
+        {
+          ++it;
+        }
+        auto nameEnd = it;
+
+        // = and opening quote
+        while (it < attributesEnd && (isSpace(*it) || *it == '='))
+        {
+          ++it;
+        }
+        if (it == attributesEnd || (*it != '"' && *it != '\''))
+        {
+          return false;
+        }
+        auto quote = *it++;
+
+        // Value and closing quote
+        auto begin = it;
+        while (it < attributesEnd && *it != quote)
+        {
+          ++it;
+        }
+        if (it == attributesEnd)
+        {
+          return false;
+        }
+
+        if (static_cast<std::size_t>(nameEnd - nameBegin) == attributeNameLength &&
+            std::strncmp(nameBegin, attributeName, attributeNameLength) == 0)
+        {
+          *valueBegin = begin;
+          *valueEnd = it;
+          return true;
+        }
+        ++it;
+      }
+      return false;
+    }
+  };
+
+  XmlScanner(const char* begin, const char* end)
+    : position_(begin),
+      end_(end),
+      error_(false)
+  {
+  }
+
+  // Reads the next element tag, returns false at the end of the buffer or if the XML is
+  // malformed (see hasError)
+  bool next(Element* element)
+  {
+    while (true)
+    {
+      position_ = static_cast<const char*>(std::memchr(position_, '<', end_ - position_));
+      if (position_ == nullptr)
+      {
+        position_ = end_;
+        return false;
+      }
+      position_++;
+
+      if (startsWith("?"))
+      {
+        if (!skipPast("?>"))
+        {
+          return false;
+        }
+      }
+      else if (startsWith("!--"))
+      {
+        if (!skipPast("-->"))
+        {
+          return false;
+        }
+      }
+      else if (startsWith("![CDATA["))
+      {
+        if (!skipPast("]]>"))
+        {
+          return false;
+        }
+      }
+      else if (startsWith("!"))
+      {
+        if (!skipPast(">"))
+        {
+          return false;
+        }
+      }
+      else
+      {
+        return readTag(element);
+      }
+    }
+  }
+
+  bool hasError() const { return error_; }
+
+  // Returns the current position in the buffer
+  const char* getPosition() const { return position_; }
+
+ private:
+  static bool isSpace(char c)
+  {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+  }
+
+  bool startsWith(const char* str) const
+  {
+    auto length = std::strlen(str);
+    return static_cast<std::size_t>(end_ - position_) >= length && std::strncmp(position_, str, length) == 0;
+  }
+
+  bool skipPast(const char* str)
+  {
+    auto length = std::strlen(str);
+    while (static_cast<std::size_t>(end_ - position_) >= length)
+    {
+      if (std::strncmp(position_, str, length) == 0)
+      {
+        position_ += length;
+        return true;
+      }
+      position_++;
+    }
+    return setError();
+  }
+
+  bool readTag(Element* element)
+  {
+    element->type = Element::Type::START;
+    if (position_ < end_ && *position_ == '/')
+    {
+      element->type = Element::Type::END;
+      position_++;
+    }
+
+    element->name = position_;
+    while (position_ < end_ && !isSpace(*position_) && *position_ != '/' && *position_ != '>')
+    {
+      position_++;
+    }
+    element->nameLength = position_ - element->name;
+    element->attributes = position_;
+
+    // Find the end of the tag, skipping any '>' inside attribute values
+    char quote = 0;
+    while (position_ < end_ && (quote != 0 || *position_ != '>'))
+    {
+      if (quote != 0 && *position_ == quote)
+      {
+        quote = 0;
+      }
+      else if (quote == 0 && (*position_ == '"' || *position_ == '\''))
+      {
+        quote = *position_;
+      }
+      position_++;
+    }
+    if (position_ == end_ || element->nameLength == 0)
+    {
+      return setError();
+    }
+
+    element->attributesEnd = position_;
+    if (element->type == Element::Type::START && *(position_ - 1) == '/')
+    {
+      element->type = Element::Type::EMPTY;
+      element->attributesEnd--;
+    }
+    position_++;
+    return true;
+  }
+
+  bool setError()
+  {
+    position_ = end_;
+    error_ = true;
+    return false;
+  }
+
+  const char* position_;
+  const char* end_;
+  bool error_;
+};
+
+#endif  // UTILS_XMLSCANNER_H_
@@ -26,7 +26,7 @@
 
 const Creature Creature::INVALID = Creature();
 const CreatureId Creature::INVALID_ID = 0;
-CreatureId Creature::nextCreatureId_ = 0x4713;
+std::atomic<CreatureId> Creature::nextCreatureId_(0x4713);
 
 Creature::Creature()
   : creatureId_(Creature::INVALID_ID),
@@ -41,7 +41,12 @@ Creature::Creature()
 }
 
 Creature::Creature(const std::string& name)
-  : creatureId_(Creature::getFreeCreatureId()),
+  : Creature(Creature::getFreeCreatureId(), name)
+{
+}
+
+Creature::Creature(CreatureId creatureId, const std::string& name)
+  : creatureId_(creatureId),
     name_(name),
     direction_(SOUTH),
     maxHealth_(100),
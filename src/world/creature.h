@@ -25,6 +25,7 @@
 #ifndef WORLD_CREATURE_H_
 #define WORLD_CREATURE_H_
 
+#include <atomic>
 #include <string>
 #include "direction.h"
 
@@ -47,6 +48,7 @@ class Creature
 
   Creature();
   explicit Creature(const std::string& name);
+  Creature(CreatureId creatureId, const std::string& name);
   virtual ~Creature() = default;
 
   bool operator==(const Creature& other) const;
@@ -77,7 +79,8 @@ class Creature
   void setLightLevel(int lightLevel) { lightLevel_ = lightLevel; }
 
   static const CreatureId INVALID_ID;
-  static int getFreeCreatureId() { return Creature::nextCreatureId_++; }
+  // Thread-safe
+  static CreatureId getFreeCreatureId() { return Creature::nextCreatureId_++; }
 
  private:
   CreatureId creatureId_;
@@ -90,7 +93,7 @@ class Creature
   int lightColor_;
   int lightLevel_;
 
-  static CreatureId nextCreatureId_;
+  static std::atomic<CreatureId> nextCreatureId_;
 };
 
 #endif  // WORLD_CREATURE_H_
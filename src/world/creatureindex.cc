@@ -0,0 +1,159 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "creatureindex.h"
+
+#include <algorithm>
+
+#include "logger.h"
+
+CreatureIndex::CreatureIndex(int startX, int startY, int sizeX, int sizeY)
+  : startX_(startX),
+    startY_(startY),
+    sizeX_(sizeX),
+    sizeY_(sizeY),
+    sectorsX_((sizeX + SECTOR_SIZE - 1) / SECTOR_SIZE),
+    sectorsY_((sizeY + SECTOR_SIZE - 1) / SECTOR_SIZE),
+    floors_(NUM_FLOORS)
+{
+}
+
+void CreatureIndex::add(CreatureId creatureId, const Position& position)
+{
+  auto* sector = getSector(position);
+  if (sector == nullptr)
+  {
+    LOG_ERROR("%s: Position %s is outside of the index", __func__, position.toString().c_str());
+    return;
+  }
+
+  sector->push_back({ creatureId, position });
+}
+
+void CreatureIndex::remove(CreatureId creatureId, const Position& position)
+{
+  auto* sector = getSector(position);
+  if (sector == nullptr)
+  {
+    LOG_ERROR("%s: Position %s is outside of the index", __func__, position.toString().c_str());
+    return;
+  }
+
+  auto it = std::find_if(sector->begin(), sector->end(), [creatureId](const Entry& entry)
+  {
+    return entry.creatureId == creatureId;
+  });
+  if (it == sector->end())
+  {
+    LOG_ERROR("%s: Creature %d not found at %s", __func__, creatureId, position.toString().c_str());
+    return;
+  }
+
+  // Order doesn't matter, swap with last to avoid moving all other entries
+  *it = sector->back();
+  sector->pop_back();
+}
+
+void CreatureIndex::move(CreatureId creatureId, const Position& fromPosition, const Position& toPosition)
+{
+  auto* fromSector = getSector(fromPosition);
+  auto* toSector = getSector(toPosition);
+  if (fromSector != nullptr && fromSector == toSector)
+  {
+    // Same sector, just update the position
+    for (auto& entry : *fromSector)
+    {
+      if (entry.creatureId == creatureId)
+      {
+        entry.position = toPosition;
+        return;
+      }
+    }
+  }
+
+  remove(creatureId, fromPosition);
+  add(creatureId, toPosition);
+}
+
+void CreatureIndex::getCreatureIds(int minX, int minY, int maxX, int maxY, int z, CreatureIdList* creatureIds) const
+{
+  if (z < 0 || z >= NUM_FLOORS || floors_[z].empty())
+  {
+    return;
+  }
+
+  // Clamp the area to the index
+  minX = std::max(minX, startX_);
+  minY = std::max(minY, startY_);
+  maxX = std::min(maxX, startX_ + sizeX_ - 1);
+  maxY = std::min(maxY, startY_ + sizeY_ - 1);
+  if (minX > maxX || minY > maxY)
+  {
+    return;
+  }
+
+  const auto& sectors = floors_[z];
+  for (auto sectorY = getSectorY(minY); sectorY <= getSectorY(maxY); sectorY++)
+  {
+    for (auto sectorX = getSectorX(minX); sectorX <= getSectorX(maxX); sectorX++)
+    {
+      for (const auto& entry : sectors[sectorY * sectorsX_ + sectorX])
+      {
+        if (entry.position.getX() >= minX && entry.position.getX() <= maxX &&
+            entry.position.getY() >= minY && entry.position.getY() <= maxY)
+        {
+          creatureIds->push_back(entry.creatureId);
+        }
+      }
+    }
+  }
+}
+
+void CreatureIndex::allocateAllFloors()
+{
+  for (auto& sectors : floors_)
+  {
+    if (sectors.empty())
+    {
+      sectors.resize(sectorsX_ * sectorsY_);
+    }
+  }
+}
+
+CreatureIndex::Sector* CreatureIndex::getSector(const Position& position)
+{
+  if (position.getX() < startX_ || position.getX() >= startX_ + sizeX_ ||
+      position.getY() < startY_ || position.getY() >= startY_ + sizeY_ ||
+      position.getZ() >= NUM_FLOORS)
+  {
+    return nullptr;
+  }
+
+  auto& sectors = floors_[position.getZ()];
+  if (sectors.empty())
+  {
+    sectors.resize(sectorsX_ * sectorsY_);
+  }
+  return &sectors[getSectorY(position.getY()) * sectorsX_ + getSectorX(position.getX())];
+}
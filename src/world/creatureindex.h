@@ -0,0 +1,83 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WORLD_CREATUREINDEX_H_
+#define WORLD_CREATUREINDEX_H_
+
+#include <vector>
+
+#include "creature.h"
+#include "position.h"
+#include "smallvector.h"
+
+// A list of CreatureIds that doesn't need to allocate memory in the common case
+using CreatureIdList = SmallVector<CreatureId, 32>;
+
+// Spatial index of Creatures
+// The world is divided into sectors of SECTOR_SIZE x SECTOR_SIZE Tiles (per floor) and each sector
+// keeps a list of the Creatures in it, so that finding all Creatures in an area only needs to
+// look at the few sectors that overlap the area, instead of every Tile in it
+class CreatureIndex
+{
+ public:
+  static const int SECTOR_SIZE = 8;
+  static const int NUM_FLOORS = 16;
+
+  CreatureIndex(int startX, int startY, int sizeX, int sizeY);
+
+  void add(CreatureId creatureId, const Position& position);
+  void remove(CreatureId creatureId, const Position& position);
+  void move(CreatureId creatureId, const Position& fromPosition, const Position& toPosition);
+
+  // Appends the CreatureIds of all Creatures in the given area (inclusive) to creatureIds
+  void getCreatureIds(int minX, int minY, int maxX, int maxY, int z, CreatureIdList* creatureIds) const;
+
+  // Allocates the sectors of all floors, so that add and move never modifies anything
+  // but the sectors of the given positions
+  void allocateAllFloors();
+
+ private:
+  struct Entry
+  {
+    CreatureId creatureId;
+    Position position;
+  };
+  using Sector = std::vector<Entry>;
+
+  Sector* getSector(const Position& position);
+  int getSectorX(int x) const { return (x - startX_) / SECTOR_SIZE; }
+  int getSectorY(int y) const { return (y - startY_) / SECTOR_SIZE; }
+
+  int startX_;
+  int startY_;
+  int sizeX_;
+  int sizeY_;
+  int sectorsX_;
+  int sectorsY_;
+
+  // Sectors are allocated per floor, when the first Creature is added to that floor
+  std::vector<std::vector<Sector>> floors_;
+};
+
+#endif  // WORLD_CREATUREINDEX_H_
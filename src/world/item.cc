@@ -26,43 +26,30 @@
 
 const ItemId ItemData::INVALID_ID = 0;
 
+const ItemData* Item::itemDataTable_ = nullptr;
+std::size_t Item::itemDataTableSize_ = 0;
+const ItemData Item::invalidItemData_;
+
+void Item::setItemDataTable(const ItemData* itemDataTable, std::size_t size)
+{
+  itemDataTable_ = itemDataTable;
+  itemDataTableSize_ = size;
+}
+
 template<>
 std::string Item::getAttribute(const std::string& name) const
 {
-  return itemData_->attributes.at(name);
+  return getItemData().attributes.at(name);
 }
 
 template<>
 int Item::getAttribute(const std::string& name) const
 {
-  return std::stoi(itemData_->attributes.at(name));
+  return std::stoi(getItemData().attributes.at(name));
 }
 
 template<>
 float Item::getAttribute(const std::string& name) const
 {
-  return std::stof(itemData_->attributes.at(name));
-}
-
-bool Item::operator==(const Item& other) const
-{
-  if (this->itemData_ == nullptr && other.itemData_ == nullptr)
-  {
-    // Both are invalid
-    return true;
-  }
-  else if (this->itemData_ == nullptr || other.itemData_ == nullptr)
-  {
-    // One of them is invalid
-    return false;
-  }
-  else
-  {
-    return this->itemData_->id == other.itemData_->id;
-  }
-}
-
-bool Item::operator!=(const Item& other) const
-{
-  return !(*this == other);
+  return std::stof(getItemData().attributes.at(name));
 }
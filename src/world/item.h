@@ -25,6 +25,8 @@
 #ifndef WORLD_ITEM_H_
 #define WORLD_ITEM_H_
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <unordered_map>
 
@@ -34,62 +36,88 @@ struct ItemData
 {
   static const ItemId INVALID_ID;
 
+  // The boolean properties of an ItemData, packed into a flag word so that they can be
+  // tested (or combined, see Tile) with a single load
+  enum Flags : uint16_t
+  {
+    GROUND        = 1 << 0,
+    BLOCKING      = 1 << 1,
+    ALWAYS_ON_TOP = 1 << 2,
+    CONTAINER     = 1 << 3,
+    STACKABLE     = 1 << 4,
+    USABLE        = 1 << 5,
+    MULTITYPE     = 1 << 6,
+    NOT_MOVABLE   = 1 << 7,
+    EQUIPABLE     = 1 << 8,
+  };
+
+  bool hasFlag(Flags flag) const { return (flags & flag) != 0; }
+  void setFlag(Flags flag) { flags |= flag; }
+
   // Loaded from data file
   ItemId id         = INVALID_ID;
-  bool ground       = false;
+  uint16_t flags    = 0;
   int speed         = 0;
-  bool isBlocking   = false;
-  bool alwaysOnTop  = false;
-  bool isContainer  = false;
-  bool isStackable  = false;
-  bool isUsable     = false;
-  bool isMultitype  = false;
-  bool isNotMovable = false;
-  bool isEquipable  = false;
 
   // Loaded from items.xml
   std::string name  = "";
   std::unordered_map<std::string, std::string> attributes;
 };
 
+// An Item is only its ItemId and count (4 bytes), everything else is looked up in the
+// ItemData table, which is indexed by ItemId
+// The ItemData table is owned by ItemFactory (or by a test), which must set it with
+// setItemDataTable before any Item is used
 class Item
 {
  public:
   Item()
-    : itemData_(nullptr),
+    : itemId_(ItemData::INVALID_ID),
       count_(0)
   {
   }
 
-  explicit Item(const ItemData* itemData)
-    : itemData_(itemData),
-      count_((itemData_ != nullptr) ? 1 : 0)
+  explicit Item(ItemId itemId)
+    : itemId_(itemId),
+      count_((itemId != ItemData::INVALID_ID) ? 1 : 0)
   {
   }
 
-  virtual ~Item() = default;
-
   static bool loadItemData(const std::string& dataFilename, const std::string& itemsFilename);
 
-  bool isValid() const { return itemData_ != nullptr; }
+  // The table must contain an ItemData at index itemId for each valid ItemId
+  static void setItemDataTable(const ItemData* itemDataTable, std::size_t size);
+
+  // Returns an invalid (default) ItemData if there is no ItemData for the given ItemId
+  static const ItemData& getItemData(ItemId itemId)
+  {
+    if (itemId > 0 && static_cast<std::size_t>(itemId) < itemDataTableSize_)
+    {
+      return itemDataTable_[itemId];
+    }
+    return invalidItemData_;
+  }
+
+  bool isValid() const { return itemId_ != ItemData::INVALID_ID; }
 
   // Loaded from data file
-  ItemId getItemId() const { return itemData_->id; }
-  bool isGround() const { return itemData_->ground; }
-  int getSpeed() const { return itemData_->speed; }
-  bool isBlocking() const { return itemData_->isBlocking; }
-  bool alwaysOnTop() const { return itemData_->alwaysOnTop; }
-  bool isContainer() const { return itemData_->isContainer; }
-  bool isStackable() const { return itemData_->isStackable; }
-  bool isUsable() const { return itemData_->isUsable; }
-  bool isMultitype() const { return itemData_->isMultitype; }
-  bool isNotMovable() const { return itemData_->isNotMovable; }
-  bool isEquipable() const { return itemData_->isEquipable; }
+  ItemId getItemId() const { return itemId_; }
+  uint16_t getFlags() const { return getItemData().flags; }
+  bool isGround() const { return getItemData().hasFlag(ItemData::GROUND); }
+  int getSpeed() const { return getItemData().speed; }
+  bool isBlocking() const { return getItemData().hasFlag(ItemData::BLOCKING); }
+  bool alwaysOnTop() const { return getItemData().hasFlag(ItemData::ALWAYS_ON_TOP); }
+  bool isContainer() const { return getItemData().hasFlag(ItemData::CONTAINER); }
+  bool isStackable() const { return getItemData().hasFlag(ItemData::STACKABLE); }
+  bool isUsable() const { return getItemData().hasFlag(ItemData::USABLE); }
+  bool isMultitype() const { return getItemData().hasFlag(ItemData::MULTITYPE); }
+  bool isNotMovable() const { return getItemData().hasFlag(ItemData::NOT_MOVABLE); }
+  bool isEquipable() const { return getItemData().hasFlag(ItemData::EQUIPABLE); }
 
   // Loaded from items.xml
-  const std::string& getName() const { return itemData_->name; }
+  const std::string& getName() const { return getItemData().name; }
 
-  bool hasAttribute(const std::string& name) const { return itemData_->attributes.count(name) == 1; }
+  bool hasAttribute(const std::string& name) const { return getItemData().attributes.count(name) == 1; }
 
   template<typename T>
   T getAttribute(const std::string& name) const;
@@ -100,13 +128,21 @@ class Item
 
   int getSubtype() const { return 0; }  // TODO(gurka): ??
 
-  bool operator==(const Item& other) const;
-  bool operator!=(const Item& other) const;
+  bool operator==(const Item& other) const { return itemId_ == other.itemId_; }
+  bool operator!=(const Item& other) const { return itemId_ != other.itemId_; }
 
  private:
-  const ItemData* itemData_;
-  uint8_t count_;
+  const ItemData& getItemData() const { return getItemData(itemId_); }
+
+  static const ItemData* itemDataTable_;
+  static std::size_t itemDataTableSize_;
+  static const ItemData invalidItemData_;
+
+  uint16_t itemId_;
+  uint16_t count_;
 };
 
+static_assert(sizeof(Item) == 4, "Item should be 4 bytes");
+
 #endif  // WORLD_ITEM_H_
 
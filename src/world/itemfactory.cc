@@ -31,6 +31,14 @@
 #include "rapidxml.hpp"
 #include "logger.h"
 
+ItemFactory::~ItemFactory()
+{
+  if (!itemData_.empty())
+  {
+    Item::setItemDataTable(nullptr, 0);
+  }
+}
+
 bool ItemFactory::initialize(const std::string& dataFilename, const std::string& itemsFilename)
 {
   if (!loadFromDat(dataFilename))
@@ -41,6 +49,9 @@ bool ItemFactory::initialize(const std::string& dataFilename, const std::string&
   {
     return false;
   }
+
+  // itemData_ is not modified after this
+  Item::setItemDataTable(itemData_.data(), itemData_.size());
   return true;
 }
 
@@ -61,6 +72,9 @@ bool ItemFactory::loadFromDat(const std::string& dataFilename)
 
   fseek(f, 0x0C, SEEK_SET);
 
+  // ItemIds below the first item id have no Item
+  itemData_.resize(nextItemId);
+
   while (ftell(f) < size)
   {
     ItemData itemData;
@@ -74,11 +88,11 @@ bool ItemFactory::loadFromDat(const std::string& dataFilename)
         case 0x00:
         {
           // Ground item
-          itemData.ground = true;
+          itemData.setFlag(ItemData::GROUND);
           itemData.speed = fgetc(f);
           if (itemData.speed == 0)
           {
-            itemData.isBlocking = true;
+            itemData.setFlag(ItemData::BLOCKING);
           }
           fgetc(f);  // ??
           break;
@@ -88,56 +102,56 @@ bool ItemFactory::loadFromDat(const std::string& dataFilename)
         case 0x02:
         {
           // What's the diff ?
-          itemData.alwaysOnTop = true;
+          itemData.setFlag(ItemData::ALWAYS_ON_TOP);
           break;
         }
 
         case 0x03:
         {
           // Container
-          itemData.isContainer = true;
+          itemData.setFlag(ItemData::CONTAINER);
           break;
         }
 
         case 0x04:
         {
           // Stackable
-          itemData.isStackable = true;
+          itemData.setFlag(ItemData::STACKABLE);
           break;
         }
 
         case 0x05:
         {
           // Usable
-          itemData.isUsable = true;
+          itemData.setFlag(ItemData::USABLE);
           break;
         }
 
         case 0x0A:
         {
           // Is multitype
-          itemData.isMultitype = true;
+          itemData.setFlag(ItemData::MULTITYPE);
           break;
         }
 
         case 0x0B:
         {
           // Blocks
-          itemData.isBlocking = true;
+          itemData.setFlag(ItemData::BLOCKING);
           break;
         }
 
         case 0x0C:
         {
           // Movable
-          itemData.isNotMovable = true;
+          itemData.setFlag(ItemData::NOT_MOVABLE);
           break;
         }
 
         case 0x0F:
         {
           // Equipable
-          itemData.isEquipable = true;
+          itemData.setFlag(ItemData::EQUIPABLE);
           break;
         }
 
@@ -199,11 +213,11 @@ bool ItemFactory::loadFromDat(const std::string& dataFilename)
     fseek(f, width * height * blendFrames * xdiv * ydiv * animCount * 2, SEEK_CUR);
 
     // Insert ItemData and increase next item id
-    itemData_.insert(std::make_pair(itemData.id, itemData));
+    itemData_.push_back(itemData);
     nextItemId++;
   }
 
-  LOG_INFO("loadItemData(): Successfully loaded %d items", itemData_.size());
+  LOG_INFO("loadItemData(): Successfully loaded %d items", nextItemId - 100);
   LOG_DEBUG("loadItemData(): Last itemId = %d", nextItemId - 1);
 
   fclose(f);
@@ -261,13 +275,13 @@ bool ItemFactory::loadFromXml(const std::string& itemsFilename)
     ItemId itemId = std::stoi(xmlAttrId->value());
 
     // Fetch the ItemData
-    if (itemData_.count(itemId) == 0)
+    if (itemId < 0 || itemId >= static_cast<ItemId>(itemData_.size()) || itemData_[itemId].id != itemId)
     {
       LOG_ERROR("loadFromXml(): Parsed data for Item with id: %d, but that Item does not exist", itemId);
       free(xmlString);
       return false;
     }
-    ItemData& itemData = itemData_.at(itemId);
+    ItemData& itemData = itemData_[itemId];
 
     // Get name
     auto* xmlAttrName = itemNode->first_attribute("name");
@@ -303,12 +317,12 @@ bool ItemFactory::loadFromXml(const std::string& itemsFilename)
 
 Item ItemFactory::createItem(ItemId itemId) const
 {
-  if (itemData_.count(itemId) == 1)
+  if (itemId > 0 && itemId < static_cast<ItemId>(itemData_.size()) && itemData_[itemId].id == itemId)
   {
-    return Item(&itemData_.at(itemId));
+    return Item(itemId);
   }
   else
   {
-    return Item(nullptr);  // invalid Item
+    return Item();  // invalid Item
   }
 }
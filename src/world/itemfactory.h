@@ -26,14 +26,14 @@
 #define WORLD_ITEMFACTORY_H_
 
 #include <string>
-#include <unordered_map>
+#include <vector>
 
 #include "item.h"
 
 class ItemFactory
 {
  public:
-  virtual ~ItemFactory() = default;
+  virtual ~ItemFactory();
 
   virtual bool initialize(const std::string& dataFilename, const std::string& itemsFilename);
 
@@ -43,7 +43,8 @@ class ItemFactory
   bool loadFromDat(const std::string& dataFilename);
   bool loadFromXml(const std::string& itemsFilename);
 
-  std::unordered_map<ItemId, ItemData> itemData_;
+  // Indexed by ItemId, ItemIds without an Item have an ItemData with id INVALID_ID
+  std::vector<ItemData> itemData_;
 };
 
 #endif  // WORLD_ITEMFACTORY_H_
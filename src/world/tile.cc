@@ -25,13 +25,13 @@
 #include "tile.h"
 
 #include <algorithm>
-#include <iterator>
 
 #include "logger.h"
 
 void Tile::addCreature(CreatureId creatureId)
 {
-  creatureIds_.push_front(creatureId);
+  // The most recently added Creature is on top
+  creatureIds_.insert(creatureIds_.cbegin(), creatureId);
 }
 
 bool Tile::removeCreature(CreatureId creatureId)
@@ -51,16 +51,14 @@ bool Tile::removeCreature(CreatureId creatureId)
 CreatureId Tile::getCreatureId(int stackPosition) const
 {
   // Calculate position in creatureIds_
-  std::size_t index = stackPosition - 1 - numberOfTopItems;
-  if (index < 0 || index >= creatureIds_.size())
+  auto index = stackPosition - 1 - numberOfTopItems_;
+  if (index < 0 || index >= static_cast<int>(creatureIds_.size()))
   {
     LOG_ERROR("%s: No Creature found at stackPosition: %d", __func__, stackPosition);
     return Creature::INVALID_ID;
   }
 
-  auto creatureIt = creatureIds_.cbegin();
-  std::advance(creatureIt, index);
-  return *creatureIt;
+  return creatureIds_[index];
 }
 
 uint8_t Tile::getCreatureStackPos(CreatureId creatureId) const
@@ -72,24 +70,27 @@ uint8_t Tile::getCreatureStackPos(CreatureId creatureId) const
     LOG_ERROR("getCreatureStackPos(): No creature %d at this Tile", creatureId);
     return 255;  // TODO(gurka): Invalid stackPosition constant?
   }
-  return 1 + numberOfTopItems + std::distance(creatureIds_.cbegin(), it);
+  return 1 + numberOfTopItems_ + (it - creatureIds_.cbegin());
 }
 
 void Tile::addItem(const Item& item)
 {
-  auto itemIt = items_.cbegin();
+  if (item.isBlocking())
+  {
+    numberOfBlockingItems_++;
+  }
 
   if (item.alwaysOnTop())
   {
-    std::advance(itemIt, 1);
-    numberOfTopItems++;
+    // Directly after the ground Item
+    items_.insert(items_.cbegin() + 1, item);
+    numberOfTopItems_++;
   }
   else
   {
-    std::advance(itemIt, 1 + numberOfTopItems);
+    // Directly after the top Items
+    items_.insert(items_.cbegin() + 1 + numberOfTopItems_, item);
   }
-
-  items_.insert(itemIt, item);
 }
 
 bool Tile::removeItem(ItemId itemId, uint8_t stackPosition)
@@ -98,87 +99,74 @@ bool Tile::removeItem(ItemId itemId, uint8_t stackPosition)
   {
     // Ground Item
     LOG_ERROR("%s: Stackposition is ground Item, cannot remove", __func__);
+    return false;
   }
-  else if (stackPosition < 1 + numberOfTopItems)
+
+  auto index = getItemIndex(stackPosition);
+  if (index == -1)
   {
-    // Top Item
-    auto itemIt = items_.cbegin();
-    std::advance(itemIt, stackPosition);
-    if (itemIt->getItemId() == itemId)
-    {
-      items_.erase(itemIt);
-      return true;
-    }
-    else
-    {
-      LOG_ERROR("%s: Given ItemId does not match Item at given stackpos", __func__);
-    }
+    LOG_ERROR("%s: Stackposition is invalid or a Creature", __func__);
+    return false;
   }
-  else if (stackPosition < 1 + numberOfTopItems + creatureIds_.size())
+
+  if (items_[index].getItemId() != itemId)
   {
-    // Creature
-    LOG_ERROR("%s: Stackposition is Creature, cannot remove", __func__);
+    LOG_ERROR("%s: Given ItemId does not match Item at given stackpos", __func__);
+    return false;
   }
-  else if (stackPosition < 1 + items_.size() + creatureIds_.size())
+
+  if (index <= numberOfTopItems_)
   {
-    // Bottom Item
-    auto itemIt = items_.cbegin();
-    std::advance(itemIt, stackPosition - creatureIds_.size());
-    if (itemIt->getItemId() == itemId)
-    {
-      items_.erase(itemIt);
-      return true;
-    }
-    else
-    {
-      LOG_ERROR("%s: Given ItemId does not match Item at given stackpos", __func__);
-    }
+    numberOfTopItems_--;
   }
-  else
+  if (items_[index].isBlocking())
   {
-    // Invalid stackpos
-    LOG_ERROR("%s: Stackposition is invalid", __func__);
+    numberOfBlockingItems_--;
   }
-
-  return false;
+  items_.erase(items_.cbegin() + index);
+  return true;
 }
 
 Item Tile::getItem(uint8_t stackPosition) const
 {
-  if (stackPosition == 0)
+  auto index = getItemIndex(stackPosition);
+  if (index == -1)
   {
-    // Ground Item
-    return items_.front();
+    LOG_ERROR("%s: Stackposition is invalid or a Creature", __func__);
+    return Item();
   }
-  else if (stackPosition < 1 + numberOfTopItems)
+
+  return items_[index];
+}
+
+std::size_t Tile::getNumberOfThings() const
+{
+  return items_.size() + creatureIds_.size();
+}
+
+int Tile::getItemIndex(uint8_t stackPosition) const
+{
+  int numberOfCreatures = creatureIds_.size();
+  int numberOfItems = items_.size();
+
+  if (stackPosition < 1 + numberOfTopItems_)
   {
-    // Top Item
-    auto itemIt = items_.cbegin();
-    std::advance(itemIt, stackPosition);
-    return *itemIt;
+    // Ground or top Item
+    return stackPosition < numberOfItems ? stackPosition : -1;
   }
-  else if (stackPosition < 1 + numberOfTopItems + creatureIds_.size())
+  else if (stackPosition < 1 + numberOfTopItems_ + numberOfCreatures)
   {
     // Creature
-    LOG_ERROR("%s: Stackposition is Creature, cannot remove", __func__);
+    return -1;
   }
-  else if (stackPosition < 1 + items_.size() + creatureIds_.size())
+  else if (stackPosition < numberOfItems + numberOfCreatures)
   {
     // Bottom Item
-    auto itemIt = items_.cbegin();
-    std::advance(itemIt, stackPosition - creatureIds_.size());
-    return *itemIt;
+    return stackPosition - numberOfCreatures;
   }
   else
   {
     // Invalid stackpos
-    LOG_ERROR("%s: Stackposition is invalid", __func__);
+    return -1;
   }
-
-  return Item();
-}
-
-std::size_t Tile::getNumberOfThings() const
-{
-  return items_.size() + creatureIds_.size();
 }
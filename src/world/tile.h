@@ -25,40 +25,71 @@
 #ifndef WORLD_TILE_H_
 #define WORLD_TILE_H_
 
-#include <list>
 #include "item.h"
 #include "creature.h"
+#include "smallvector.h"
 
+// The things on a Tile are, in stack position order: the ground Item, the top Items
+// (alwaysOnTop), the Creatures and the bottom Items
+// items_ keeps the ground, top and bottom Items in that order and creatureIds_ keeps the
+// Creatures, so with the number of top Items known any stack position is a direct index
+// Both store one element inline, so that a Tile with only a ground Item (most Tiles)
+// doesn't allocate any memory
+// The aggregate properties (blocking, ground speed, ...) are kept up to date in
+// addItem/removeItem, so that checking them doesn't need to iterate the Items
 class Tile
 {
  public:
+  using Items = SmallVector<Item, 1>;
+  using CreatureIds = SmallVector<CreatureId, 1>;
+
+  // Empty Tile, only used as placeholder in TileGrid
+  Tile()
+    : numberOfTopItems_(0),
+      numberOfBlockingItems_(0),
+      groundSpeed_(0)
+  {
+  }
+
   explicit Tile(const Item& groundItem)
-    : numberOfTopItems(0)
+    : numberOfTopItems_(0),
+      numberOfBlockingItems_(groundItem.isBlocking() ? 1 : 0),
+      groundSpeed_(groundItem.getSpeed())
   {
-    items_.push_front(groundItem);
+    items_.push_back(groundItem);
   }
 
   // Creatures
   void addCreature(CreatureId creatureId);
   bool removeCreature(CreatureId creatureId);
   CreatureId getCreatureId(int stackPosition) const;
-  const std::list<CreatureId>& getCreatureIds() const { return creatureIds_; }
+  const CreatureIds& getCreatureIds() const { return creatureIds_; }
   uint8_t getCreatureStackPos(CreatureId creatureId) const;
 
   // Items
+  // The ground Item (stack position 0) can't be removed, so the ground speed never changes
   void addItem(const Item& item);
   bool removeItem(ItemId itemId, uint8_t stackPosition);
   Item getItem(uint8_t stackPosition) const;
-  const std::list<Item>& getItems() const { return items_; }
+  const Items& getItems() const { return items_; }
 
   // Other
   std::size_t getNumberOfThings() const;
-  int getGroundSpeed() const { return items_.front().getSpeed(); }
+  int getGroundSpeed() const { return groundSpeed_; }
+  bool isBlocking() const { return numberOfBlockingItems_ != 0; }
+  bool hasTopItems() const { return numberOfTopItems_ != 0; }
+  bool hasCreatures() const { return !creatureIds_.empty(); }
 
  private:
-  int numberOfTopItems;
-  std::list<Item> items_;
-  std::list<CreatureId> creatureIds_;
+  // Returns the index in items_ of the Item at the given stack position, or -1 if
+  // there is no Item at that stack position
+  int getItemIndex(uint8_t stackPosition) const;
+
+  uint8_t numberOfTopItems_;
+  uint8_t numberOfBlockingItems_;
+  uint16_t groundSpeed_;
+  Items items_;
+  CreatureIds creatureIds_;
 };
 
 #endif  // WORLD_TILE_H_
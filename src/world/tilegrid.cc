@@ -0,0 +1,191 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "tilegrid.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#include "logger.h"
+
+TileGrid::TileGrid(int startX, int startY, int sizeX, int sizeY)
+  : startX_(startX),
+    startY_(startY),
+    sizeX_(sizeX),
+    sizeY_(sizeY),
+    chunksX_((sizeX + CHUNK_SIZE - 1) / CHUNK_SIZE),
+    chunksY_((sizeY + CHUNK_SIZE - 1) / CHUNK_SIZE),
+    chunks_(chunksX_ * chunksY_ * NUM_FLOORS)
+{
+}
+
+void TileGrid::setTile(const Position& position, const Tile& tile)
+{
+  if (!contains(position))
+  {
+    throw std::out_of_range("TileGrid::setTile: position is outside of the grid");
+  }
+
+  auto& chunk = chunks_[getChunkIndex(position)];
+  if (!chunk)
+  {
+    chunk.reset(new Chunk());
+  }
+
+  auto tileIndex = getTileIndex(position);
+  chunk->tiles[tileIndex] = tile;
+  chunk->isSet[tileIndex] = true;
+}
+
+Tile* TileGrid::getTile(const Position& position)
+{
+  if (!contains(position))
+  {
+    return nullptr;
+  }
+
+  auto chunkIndex = getChunkIndex(position);
+  auto& chunk = chunks_[chunkIndex];
+  if (!chunk)
+  {
+    // A chunk without any Tiles is not allocated by the ChunkLoader either
+    if (!chunkLoader_ || !chunkLoader_(chunkIndex, this) || !chunk)
+    {
+      return nullptr;
+    }
+  }
+  chunk->accessed = true;
+
+  auto tileIndex = getTileIndex(position);
+  return chunk->isSet[tileIndex] ? &chunk->tiles[tileIndex] : nullptr;
+}
+
+const Tile* TileGrid::getTile(const Position& position) const
+{
+  return const_cast<TileGrid*>(this)->getTile(position);
+}
+
+Tile& TileGrid::at(const Position& position)
+{
+  auto* tile = getTile(position);
+  if (tile == nullptr)
+  {
+    throw std::out_of_range("TileGrid::at: no Tile at position");
+  }
+  return *tile;
+}
+
+const Tile& TileGrid::at(const Position& position) const
+{
+  return const_cast<TileGrid*>(this)->at(position);
+}
+
+void TileGrid::setModified(const Position& position)
+{
+  if (!contains(position))
+  {
+    return;
+  }
+
+  auto& chunk = chunks_[getChunkIndex(position)];
+  if (chunk)
+  {
+    chunk->modified = true;
+  }
+}
+
+std::size_t TileGrid::evictChunks(std::chrono::steady_clock::duration idleTimeout, std::size_t maxChunks)
+{
+  if (!chunkLoader_)
+  {
+    return 0;
+  }
+
+  auto now = std::chrono::steady_clock::now();
+  std::size_t numberOfChunks = 0;
+
+  // Chunks that could be evicted, but haven't been idle for idleTimeout
+  std::vector<std::pair<std::chrono::steady_clock::time_point, std::size_t>> evictable;
+
+  for (std::size_t chunkIndex = 0; chunkIndex < chunks_.size(); chunkIndex++)
+  {
+    auto& chunk = chunks_[chunkIndex];
+    if (!chunk)
+    {
+      continue;
+    }
+
+    if (chunk->accessed)
+    {
+      chunk->accessed = false;
+      chunk->lastAccess = now;
+    }
+
+    auto hasCreatures = std::any_of(chunk->tiles.cbegin(), chunk->tiles.cend(), [](const Tile& tile)
+    {
+      return tile.hasCreatures();
+    });
+
+    if (chunk->modified || hasCreatures)
+    {
+      numberOfChunks++;
+    }
+    else if (now - chunk->lastAccess >= idleTimeout)
+    {
+      chunk.reset();
+    }
+    else
+    {
+      evictable.emplace_back(chunk->lastAccess, chunkIndex);
+      numberOfChunks++;
+    }
+  }
+
+  if (numberOfChunks > maxChunks)
+  {
+    std::sort(evictable.begin(), evictable.end());
+    for (auto it = evictable.cbegin(); it != evictable.cend() && numberOfChunks > maxChunks; ++it)
+    {
+      chunks_[it->second].reset();
+      numberOfChunks--;
+    }
+  }
+
+  if (numberOfChunks > maxChunks)
+  {
+    LOG_INFO("%s: %zu chunks are loaded, but only %zu are allowed (the rest are modified or have Creatures)",
+             __func__,
+             numberOfChunks,
+             maxChunks);
+  }
+
+  return numberOfChunks;
+}
+
+std::size_t TileGrid::getChunkMemoryUsage()
+{
+  // The Items that don't fit in a Tile are not included
+  return sizeof(Chunk) + (CHUNK_SIZE * CHUNK_SIZE * sizeof(Tile)) + (CHUNK_SIZE * CHUNK_SIZE / 8);
+}
@@ -0,0 +1,149 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WORLD_TILEGRID_H_
+#define WORLD_TILEGRID_H_
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "position.h"
+#include "tile.h"
+
+// Dense storage of all Tiles in the world
+// The world is divided into chunks of CHUNK_SIZE x CHUNK_SIZE Tiles (per floor), each chunk
+// is a contiguous array of Tiles and is only allocated when a Tile in it is set.
+// A lookup is just some index calculations, no hashing
+//
+// If a ChunkLoader is set the TileGrid is paged: a chunk that is not allocated is loaded by
+// the ChunkLoader (which sets its Tiles with setTile) the first time one of its Tiles is
+// accessed, and evictChunks frees chunks that haven't been accessed for a while.
+// Chunks are independent of each other, so different threads may load different chunks at
+// the same time, but evictChunks must not run while any other thread accesses the TileGrid
+class TileGrid
+{
+ public:
+  static const int CHUNK_SIZE = 32;
+  static const int NUM_FLOORS = 16;
+
+  using ChunkLoader = std::function<bool(std::size_t chunkIndex, TileGrid* tiles)>;
+
+  TileGrid(int startX, int startY, int sizeX, int sizeY);
+
+  // Not copyable, but movable
+  TileGrid(const TileGrid&) = delete;
+  TileGrid& operator=(const TileGrid&) = delete;
+  TileGrid(TileGrid&&) = default;
+  TileGrid& operator=(TileGrid&&) = default;
+
+  void setTile(const Position& position, const Tile& tile);
+
+  // Returns nullptr if there is no Tile at the given position
+  Tile* getTile(const Position& position);
+  const Tile* getTile(const Position& position) const;
+
+  // Same as getTile, but throws std::out_of_range if there is no Tile at the given position
+  Tile& at(const Position& position);
+  const Tile& at(const Position& position) const;
+
+  int getStartX() const { return startX_; }
+  int getStartY() const { return startY_; }
+  int getSizeX() const { return sizeX_; }
+  int getSizeY() const { return sizeY_; }
+
+  // Paging
+  void setChunkLoader(const ChunkLoader& chunkLoader) { chunkLoader_ = chunkLoader; }
+  bool isPaged() const { return static_cast<bool>(chunkLoader_); }
+
+  // Marks the chunk that contains the position as modified, a modified chunk is never
+  // evicted since the ChunkLoader would load the original Tiles again
+  void setModified(const Position& position);
+
+  // Evicts all chunks that haven't been accessed for idleTimeout, and then the least
+  // recently accessed chunks while more than maxChunks chunks are loaded
+  // Chunks that are modified or have Creatures on them are never evicted
+  // The time of access is only sampled by evictChunks, so it should be called regularly
+  // Returns the number of chunks that are still loaded
+  std::size_t evictChunks(std::chrono::steady_clock::duration idleTimeout, std::size_t maxChunks);
+
+  // Returns the (approximate) memory used by a loaded chunk
+  static std::size_t getChunkMemoryUsage();
+
+ private:
+  struct Chunk
+  {
+    Chunk()
+      : tiles(CHUNK_SIZE * CHUNK_SIZE),
+        isSet(CHUNK_SIZE * CHUNK_SIZE, false),
+        accessed(true),
+        modified(false),
+        lastAccess(std::chrono::steady_clock::now())
+    {
+    }
+
+    std::vector<Tile> tiles;
+    std::vector<bool> isSet;
+
+    // Paging
+    bool accessed;
+    bool modified;
+    std::chrono::steady_clock::time_point lastAccess;
+  };
+
+  bool contains(const Position& position) const
+  {
+    return position.getX() >= startX_ && position.getX() < startX_ + sizeX_ &&
+           position.getY() >= startY_ && position.getY() < startY_ + sizeY_ &&
+           position.getZ() < NUM_FLOORS;
+  }
+
+  std::size_t getChunkIndex(const Position& position) const
+  {
+    auto chunkX = (position.getX() - startX_) / CHUNK_SIZE;
+    auto chunkY = (position.getY() - startY_) / CHUNK_SIZE;
+    return (position.getZ() * chunksY_ + chunkY) * chunksX_ + chunkX;
+  }
+
+  std::size_t getTileIndex(const Position& position) const
+  {
+    auto tileX = (position.getX() - startX_) % CHUNK_SIZE;
+    auto tileY = (position.getY() - startY_) % CHUNK_SIZE;
+    return tileY * CHUNK_SIZE + tileX;
+  }
+
+  int startX_;
+  int startY_;
+  int sizeX_;
+  int sizeY_;
+  int chunksX_;
+  int chunksY_;
+
+  std::vector<std::unique_ptr<Chunk>> chunks_;
+  ChunkLoader chunkLoader_;
+};
+
+#endif  // WORLD_TILEGRID_H_
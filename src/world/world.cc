@@ -38,11 +38,12 @@
 World::World(std::unique_ptr<ItemFactory> itemFactory,
              int worldSizeX,
              int worldSizeY,
-             const std::unordered_map<Position, Tile, Position::Hash>& tiles)
+             TileGrid&& tiles)
   : itemFactory_(std::move(itemFactory)),
     worldSizeX_(worldSizeX),
     worldSizeY_(worldSizeY),
-    tiles_(tiles)
+    tiles_(std::move(tiles)),
+    creatureIndex_(worldSizeStart_, worldSizeStart_, worldSizeX, worldSizeY)
 {
 }
 
@@ -107,10 +108,12 @@ Position World::addCreature(Creature* creature, CreatureCtrl* creatureCtrl, cons
     creatures_.insert(std::make_pair(creatureId, creature));
     creatureCtrls_.insert(std::make_pair(creatureId, creatureCtrl));
     creaturePositions_.insert(std::make_pair(creatureId, adjustedPosition));
+    creatureIndex_.add(creatureId, adjustedPosition);
 
     // Tell near creatures that a creature has spawned
     // Except the spawned creature itself
-    std::list<CreatureId> nearCreatureIds = getNearCreatureIds(adjustedPosition);
+    CreatureIdList nearCreatureIds;
+    getVisibleCreatureIds(adjustedPosition, &nearCreatureIds);
     for (const auto& nearCreatureId : nearCreatureIds)
     {
       if (nearCreatureId != creatureId)
@@ -143,7 +146,8 @@ void World::removeCreature(CreatureId creatureId)
 
   // Tell near creatures that a creature has despawned
   // Except the despawning creature
-  std::list<CreatureId> nearCreatureIds = getNearCreatureIds(position);
+  CreatureIdList nearCreatureIds;
+  getVisibleCreatureIds(position, &nearCreatureIds);
   for (const auto& nearCreatureId : nearCreatureIds)
   {
     if (nearCreatureId != creatureId)
@@ -152,10 +156,21 @@ void World::removeCreature(CreatureId creatureId)
     }
   }
 
+  creatureIndex_.remove(creatureId, position);
+  tile.removeCreature(creatureId);
   creatures_.erase(creatureId);
   creatureCtrls_.erase(creatureId);
   creaturePositions_.erase(creatureId);
-  tile.removeCreature(creatureId);
+}
+
+void World::allocateAll()
+{
+  creatureIndex_.allocateAllFloors();
+}
+
+std::size_t World::evictChunks(std::chrono::steady_clock::duration idleTimeout, std::size_t maxChunks)
+{
+  return tiles_.evictChunks(idleTimeout, maxChunks);
 }
 
 bool World::creatureExists(CreatureId creatureId) const
@@ -186,13 +201,10 @@ World::ReturnCode World::creatureMove(CreatureId creatureId, const Position& toP
 
   // Check if toTile is blocking or not
   auto& toTile = internalGetTile(toPosition);
-  for (const auto& item : toTile.getItems())
+  if (toTile.isBlocking())
   {
-    if (item.isBlocking())
-    {
-      LOG_DEBUG("%s: Item on toTile is blocking", __func__);
-      return ReturnCode::THERE_IS_NO_ROOM;
-    }
+    LOG_DEBUG("%s: Item on toTile is blocking", __func__);
+    return ReturnCode::THERE_IS_NO_ROOM;
   }
 
   auto& creature = internalGetCreature(creatureId);
@@ -206,7 +218,7 @@ World::ReturnCode World::creatureMove(CreatureId creatureId, const Position& toP
   toTile.addCreature(creatureId);
   auto toStackPos = toTile.getCreatureStackPos(creatureId);
   creaturePositions_.at(creatureId) = toPosition;
-
+  creatureIndex_.move(creatureId, fromPosition, toPosition);
 
   // Update direction
   if (fromPosition.getY() > toPosition.getY())
@@ -228,29 +240,19 @@ World::ReturnCode World::creatureMove(CreatureId creatureId, const Position& toP
 
   // Call onCreatureMove on all creatures that can see the movement
   // including the moving creature itself
-  auto x_min = std::min(fromPosition.getX(), toPosition.getX());
-  auto x_max = std::min(fromPosition.getX(), toPosition.getX());
-  auto y_min = std::min(fromPosition.getY(), toPosition.getY());
-  auto y_max = std::max(fromPosition.getY(), toPosition.getY());
-  for (auto x = x_min - 9; x <= x_max + 9; x++)
+  CreatureIdList nearCreatureIds;
+  getVisibleCreatureIds(fromPosition, toPosition, &nearCreatureIds);
+  for (const auto& nearCreatureId : nearCreatureIds)
   {
-    for (auto y = y_min - 7; y <= y_max + 7; y++)
-    {
-      const auto& tile = getTile(Position(x, y, 7));
-
-      const auto& nearCreatureIds = tile.getCreatureIds();
-      for (const auto nearCreatureId : nearCreatureIds)
-      {
-        getCreatureCtrl(nearCreatureId).onCreatureMove(creature, fromPosition, fromStackPos, toPosition, toStackPos);
-      }
-    }
+    getCreatureCtrl(nearCreatureId).onCreatureMove(creature, fromPosition, fromStackPos, toPosition, toStackPos);
   }
 
   // The client can only show ground + 9 Items/Creatures, so if the number of things on the fromTile
   // is >= 10 then some items on the tile is unknown to the client, so update the Tile for each nearby Creature
   if (fromTile.getNumberOfThings() >= 10)
   {
-    auto nearCreatureIds = getNearCreatureIds(fromPosition);
+    nearCreatureIds.clear();
+    getVisibleCreatureIds(fromPosition, &nearCreatureIds);
     for (const auto& nearCreatureId : nearCreatureIds)
     {
       getCreatureCtrl(nearCreatureId).onTileUpdate(fromPosition);
@@ -275,7 +277,8 @@ void World::creatureTurn(CreatureId creatureId, Direction direction)
   // including the turning creature itself
   const auto& position = getCreaturePosition(creatureId);
   auto stackPos = getTile(position).getCreatureStackPos(creatureId);
-  auto nearCreatureIds = getNearCreatureIds(position);
+  CreatureIdList nearCreatureIds;
+  getVisibleCreatureIds(position, &nearCreatureIds);
   for (const auto& nearCreatureId : nearCreatureIds)
   {
     getCreatureCtrl(nearCreatureId).onCreatureTurn(creature, position, stackPos);
@@ -292,7 +295,8 @@ void World::creatureSay(CreatureId creatureId, const std::string& message)
 
   const auto& creature = getCreature(creatureId);
   const auto& position = getCreaturePosition(creatureId);
-  auto nearCreatureIds = getNearCreatureIds(position);
+  CreatureIdList nearCreatureIds;
+  getVisibleCreatureIds(position, &nearCreatureIds);
   for (const auto& nearCreatureId : nearCreatureIds)
   {
     getCreatureCtrl(nearCreatureId).onCreatureSay(creature, position, message);
@@ -316,9 +320,11 @@ World::ReturnCode World::addItem(const Item& item, const Position& position)
   // Add Item to toTile
   auto& toTile = internalGetTile(position);
   toTile.addItem(item);
+  tiles_.setModified(position);
 
   // Call onItemAdded on all creatures that can see position
-  auto nearCreatureIds = getNearCreatureIds(position);
+  CreatureIdList nearCreatureIds;
+  getVisibleCreatureIds(position, &nearCreatureIds);
   for (const auto& nearCreatureId : nearCreatureIds)
   {
     getCreatureCtrl(nearCreatureId).onItemAdded(item, position);
@@ -342,9 +348,11 @@ World::ReturnCode World::removeItem(int itemId, int count, const Position& posit
     LOG_ERROR("moveItem(): Could not remove item %d from %s", itemId, position.toString().c_str());
     return ReturnCode::ITEM_NOT_FOUND;
   }
+  tiles_.setModified(position);
 
   // Call onItemRemoved on all creatures that can see fromPosition
-  auto nearCreatureIds = getNearCreatureIds(position);
+  CreatureIdList nearCreatureIds;
+  getVisibleCreatureIds(position, &nearCreatureIds);
   for (const auto& nearCreatureId : nearCreatureIds)
   {
     getCreatureCtrl(nearCreatureId).onItemRemoved(position, stackPos);
@@ -354,7 +362,6 @@ World::ReturnCode World::removeItem(int itemId, int count, const Position& posit
   // is >= 10 then some items on the tile is unknown to the client, so update the Tile for each nearby Creature
   if (fromTile.getNumberOfThings() >= 10)
   {
-    auto nearCreatureIds = getNearCreatureIds(position);
     for (const auto& nearCreatureId : nearCreatureIds)
     {
       getCreatureCtrl(nearCreatureId).onTileUpdate(position);
@@ -443,13 +450,10 @@ World::ReturnCode World::moveItem(CreatureId creatureId, const Position& fromPos
     }
 
     // Check if we can add Item to toTile
-    for (const auto& item : toTile.getItems())
+    if (toTile.isBlocking())
     {
-      if (item.isBlocking())
-      {
-        LOG_DEBUG("%s: Item on toTile is blocking", __func__);
-        return ReturnCode::THERE_IS_NO_ROOM;
-      }
+      LOG_DEBUG("%s: Item on toTile is blocking", __func__);
+      return ReturnCode::THERE_IS_NO_ROOM;
     }
 
     // Try to remove Item from fromTile
@@ -461,16 +465,20 @@ World::ReturnCode World::moveItem(CreatureId creatureId, const Position& fromPos
 
     // Add Item to toTile
     toTile.addItem(item);
+    tiles_.setModified(fromPosition);
+    tiles_.setModified(toPosition);
 
     // Call onItemRemoved on all creatures that can see fromPosition
-    auto nearCreatureIds = getNearCreatureIds(fromPosition);
+    CreatureIdList nearCreatureIds;
+    getVisibleCreatureIds(fromPosition, &nearCreatureIds);
     for (const auto& nearCreatureId : nearCreatureIds)
     {
       getCreatureCtrl(nearCreatureId).onItemRemoved(fromPosition, fromStackPos);
     }
 
     // Call onItemAdded on all creatures that can see toPosition
-    nearCreatureIds = getNearCreatureIds(toPosition);
+    nearCreatureIds.clear();
+    getVisibleCreatureIds(toPosition, &nearCreatureIds);
     for (const auto& nearCreatureId : nearCreatureIds)
     {
       getCreatureCtrl(nearCreatureId).onItemAdded(item, toPosition);
@@ -480,7 +488,8 @@ World::ReturnCode World::moveItem(CreatureId creatureId, const Position& fromPos
     // is >= 10 then some items on the tile is unknown to the client, so update the Tile for each nearby Creature
     if (fromTile.getNumberOfThings() >= 10)
     {
-      auto nearCreatureIds = getNearCreatureIds(fromPosition);
+      nearCreatureIds.clear();
+      getVisibleCreatureIds(fromPosition, &nearCreatureIds);
       for (const auto& nearCreatureId : nearCreatureIds)
       {
         getCreatureCtrl(nearCreatureId).onTileUpdate(fromPosition);
@@ -527,27 +536,20 @@ bool World::positionIsValid(const Position& position) const
          position.getZ() == 7;
 }
 
-std::list<CreatureId> World::getNearCreatureIds(const Position& position) const
+void World::getVisibleCreatureIds(const Position& position, CreatureIdList* creatureIds) const
 {
-  std::list<CreatureId> creatureIds;
-
-  for (int x = position.getX() - 9; x <= position.getX() + 9; ++x)
-  {
-    for (int y = position.getY() - 7; y <= position.getY() + 7; ++y)
-    {
-      Position tempPosition(x, y, position.getZ());
-
-      if (!positionIsValid(tempPosition))
-      {
-        continue;
-      }
-
-      const Tile& tile = getTile(tempPosition);
-      creatureIds.insert(creatureIds.cend(), tile.getCreatureIds().cbegin(), tile.getCreatureIds().cend());
-    }
-  }
+  getVisibleCreatureIds(position, position, creatureIds);
+}
 
-  return creatureIds;
+void World::getVisibleCreatureIds(const Position& fromPosition, const Position& toPosition,
+                                  CreatureIdList* creatureIds) const
+{
+  // A Creature can see 9 Tiles in each direction on the x axis and 7 Tiles on the y axis
+  auto minX = std::min(fromPosition.getX(), toPosition.getX()) - 9;
+  auto maxX = std::max(fromPosition.getX(), toPosition.getX()) + 9;
+  auto minY = std::min(fromPosition.getY(), toPosition.getY()) - 7;
+  auto maxY = std::max(fromPosition.getY(), toPosition.getY()) + 7;
+  creatureIndex_.getCreatureIds(minX, minY, maxX, maxY, toPosition.getZ(), creatureIds);
 }
 
 Tile& World::internalGetTile(const Position& position)
@@ -25,6 +25,8 @@
 #ifndef WORLD_WORLD_H_
 #define WORLD_WORLD_H_
 
+#include <chrono>
+#include <cstddef>
 #include <list>
 #include <memory>
 #include <string>
@@ -33,7 +35,9 @@
 #include "worldinterface.h"
 #include "creature.h"
 #include "creaturectrl.h"
+#include "creatureindex.h"
 #include "tile.h"
+#include "tilegrid.h"
 #include "position.h"
 #include "itemfactory.h"
 
@@ -55,7 +59,7 @@ class World : public WorldInterface
   World(std::unique_ptr<ItemFactory> itemFactory,
         int worldSizeX,
         int worldSizeY,
-        const std::unordered_map<Position, Tile, Position::Hash>& tiles);
+        TileGrid&& tiles);
 
   // Creature management
   Position addCreature(Creature* creature, CreatureCtrl* creatureCtrl, const Position& position);
@@ -77,6 +81,25 @@ class World : public WorldInterface
   bool creatureCanThrowTo(CreatureId creatureId, const Position& position) const;
   bool creatureCanReach(CreatureId creatureId, const Position& position) const;
 
+  // World size
+  int getWorldSizeStart() const { return worldSizeStart_; }
+  int getWorldSizeX() const { return worldSizeX_; }
+  int getWorldSizeY() const { return worldSizeY_; }
+
+  // The World is not thread-safe, but it can be accessed from multiple threads if every
+  // thread only accesses Tiles and Creatures in areas that no other thread accesses at the
+  // same time (e.g. by locking regions of the World), see GameEngine
+  // Adding and removing Creatures modifies data shared by all areas, and must be done while
+  // no other thread accesses the World
+  // allocateAll must be called first, it allocates everything that is otherwise allocated
+  // lazily (and that would be shared between areas)
+  void allocateAll();
+
+  // Paging (see TileGrid), chunks of Tiles are loaded when they are accessed, and evictChunks
+  // must be called regularly, while no other thread accesses the World
+  bool isPaged() const { return tiles_.isPaged(); }
+  std::size_t evictChunks(std::chrono::steady_clock::duration idleTimeout, std::size_t maxChunks);
+
   // WorldInterface
   const std::list<const Tile*> getMapBlock(const Position& position, int width, int height) const;
   const Tile& getTile(const Position& position) const;
@@ -88,10 +111,12 @@ class World : public WorldInterface
   bool positionIsValid(const Position& position) const;
 
   // Helper functions
-  // TODO(gurka): Rename to getVisibleCreatureIds and return std::vector<CreatureId>
-  std::list<CreatureId> getNearCreatureIds(const Position& position) const;
+  // Appends the CreatureIds of all Creatures that can see the given position(s)
+  void getVisibleCreatureIds(const Position& position, CreatureIdList* creatureIds) const;
+  void getVisibleCreatureIds(const Position& fromPosition, const Position& toPosition,
+                             CreatureIdList* creatureIds) const;
 
-  // Functions to use instead of accessing the unordered_maps directly
+  // Functions to use instead of accessing tiles_ and the unordered_maps directly
   Tile& internalGetTile(const Position& position);
   Creature& internalGetCreature(CreatureId creatureId);
   CreatureCtrl& getCreatureCtrl(CreatureId creatureId);
@@ -106,10 +131,11 @@ class World : public WorldInterface
   // Offset for world size, since the client doesn't like too low positions
   const int worldSizeStart_ = 192;
 
-  std::unordered_map<Position, Tile, Position::Hash> tiles_;
+  TileGrid tiles_;
   std::unordered_map<int, Creature*> creatures_;
   std::unordered_map<int, CreatureCtrl*> creatureCtrls_;
   std::unordered_map<int, Position> creaturePositions_;
+  CreatureIndex creatureIndex_;
 };
 
 #endif  // WORLD_WORLD_H_
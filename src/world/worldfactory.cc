@@ -24,127 +24,439 @@
 
 #include "worldfactory.h"
 
-#include <fstream>
-#include <sstream>
-#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <future>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include "position.h"
 #include "tile.h"
+#include "tilegrid.h"
 #include "itemfactory.h"
 #include "world.h"
+#include "worldfile.h"
 #include "logger.h"
-#include "rapidxml.hpp"
+#include "mappedfile.h"
+#include "xmlscanner.h"
+
+namespace
+{
+
+// The result of parsing a band of Tiles in world.xml
+struct TileBand
+{
+  bool ok = true;
+  std::vector<uint32_t> itemOffsets;  // Relative to the band's itemIds
+  std::vector<uint16_t> itemIds;
+  const char* next = nullptr;  // The <tile>-node the band stopped at, or end
+};
+
+// Returns the position of the first "<tile" tag at or after the given position, or end
+// It doesn't know about comments and CDATA sections, so the "<tile" may be inside of one
+const char* findTile(const char* position, const char* end)
+{
+  while ((position = static_cast<const char*>(std::memchr(position, '<', end - position))) != nullptr)
+  {
+    if (end - position > 5 &&
+        std::strncmp(position, "<tile", 5) == 0 &&
+        (position[5] == ' ' || position[5] == '\t' || position[5] == '\r' || position[5] == '\n' ||
+         position[5] == '>' || position[5] == '/'))
+    {
+      return position;
+    }
+    position++;
+  }
+  return end;
+}
+
+// Parses all <tile>-nodes that start at or after begin and before bandEnd
+// The last <tile>-node may end after bandEnd, but not after end
+void parseTileBand(const char* begin, const char* bandEnd, const char* end, TileBand* band)
+{
+  XmlScanner scanner(begin, end);
+  XmlScanner::Element element;
+  band->next = end;
+
+  while (scanner.next(&element))
+  {
+    // Stop at </map>, or at the first <tile>-node that belongs to the next band
+    // (element.name is directly after the '<')
+    if (element.type == XmlScanner::Element::Type::END)
+    {
+      return;
+    }
+    if (element.name - 1 >= bandEnd)
+    {
+      band->next = element.name - 1;
+      return;
+    }
+
+    // Read the ItemIds of all <item>-nodes (the direct children of the <tile>-node)
+    // The first <item> is the ground item (there must be at least one)
+    // TODO(gurka): Must there be one? What about "void", or is it also an Item?
+    band->itemOffsets.push_back(band->itemIds.size());
+    auto hasGroundItem = false;
+    auto depth = (element.type == XmlScanner::Element::Type::START) ? 1 : 0;
+    while (depth > 0)
+    {
+      if (!scanner.next(&element))
+      {
+        LOG_ERROR("%s: Invalid file, unterminated <tile>-node", __func__);
+        band->ok = false;
+        return;
+      }
+
+      if (element.type == XmlScanner::Element::Type::END)
+      {
+        depth--;
+        continue;
+      }
+
+      if (depth == 1)
+      {
+        // ItemIds that don't fit in an Item are stored as invalid ItemIds, just like
+        // ItemFactory::createItem would do with them
+        int itemId;
+        if (element.getAttribute("id", &itemId))
+        {
+          band->itemIds.push_back((itemId > 0 && itemId <= UINT16_MAX) ? itemId : ItemData::INVALID_ID);
+        }
+        else if (!hasGroundItem)
+        {
+          LOG_ERROR("%s: Invalid file, missing attribute id in <item>-node", __func__);
+          band->ok = false;
+          return;
+        }
+        else
+        {
+          LOG_DEBUG("%s: Missing attribute id in <item>-node, skipping Item", __func__);
+        }
+        hasGroundItem = true;
+      }
+
+      if (element.type == XmlScanner::Element::Type::START)
+      {
+        depth++;
+      }
+    }
+
+    if (!hasGroundItem)
+    {
+      LOG_ERROR("%s: Invalid file, <tile>-node is missing <item>-node", __func__);
+      band->ok = false;
+      return;
+    }
+  }
+
+  if (scanner.hasError())
+  {
+    LOG_ERROR("%s: Invalid file, malformed XML", __func__);
+    band->ok = false;
+  }
+}
+
+// Splits [begin, end) into bands of equal size, where each band but the first starts at the
+// first "<tile" at or after its start, and parses them in parallel
+// Returns false if a band started at a "<tile" that the scanner skipped (i.e. one inside of
+// a comment or CDATA section), which is detected by the previous band not stopping there
+bool parseTileBands(const char* begin, const char* end, std::size_t numberOfBands, std::vector<TileBand>* bands)
+{
+  std::vector<const char*> bandStarts;
+  bandStarts.push_back(begin);
+  for (std::size_t i = 1; i < numberOfBands; i++)
+  {
+    bandStarts.push_back(findTile(begin + ((end - begin) * i / numberOfBands), end));
+  }
+  bandStarts.push_back(end);
+
+  bands->clear();
+  bands->resize(numberOfBands);
+  std::vector<std::future<void>> parsed;
+  for (std::size_t i = 0; i < numberOfBands; i++)
+  {
+    parsed.push_back(std::async(std::launch::async, &parseTileBand, bandStarts[i], bandStarts[i + 1], end, &(*bands)[i]));
+  }
+  for (auto& bandParsed : parsed)
+  {
+    bandParsed.get();
+  }
+
+  for (std::size_t i = 0; i < numberOfBands; i++)
+  {
+    // A band that failed may not have reached its end, but then the result doesn't matter
+    if ((*bands)[i].ok && (*bands)[i].next != bandStarts[i + 1])
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
 
 std::unique_ptr<World> WorldFactory::createWorld(const std::string& dataFilename,
                                                  const std::string& itemsFilename,
-                                                 const std::string& worldFilename)
+                                                 const std::string& worldFilename,
+                                                 bool paged)
 {
-  // Load ItemFactory
+  // Load ItemFactory on another thread, while world.xml is parsed
   auto itemFactory = std::unique_ptr<ItemFactory>(new ItemFactory());
-  if (!itemFactory->initialize(dataFilename, itemsFilename))
+  auto itemFactoryLoaded = std::async(std::launch::async,
+                                      &ItemFactory::initialize,
+                                      itemFactory.get(),
+                                      dataFilename,
+                                      itemsFilename);
+
+  // Load the Tiles
+  std::unique_ptr<TileGrid> tiles;
+  if (WorldFile::isWorldFile(worldFilename))
+  {
+    if (!itemFactoryLoaded.get())
+    {
+      LOG_ERROR("%s: Could not initialize ItemFactory", __func__);
+      return std::unique_ptr<World>();
+    }
+    tiles = paged ? loadWorldFilePaged(worldFilename, *itemFactory) : loadWorldFile(worldFilename, *itemFactory);
+  }
+  else
   {
-    LOG_ERROR("%s: Could not initialize ItemFactory", __func__);
+    if (paged)
+    {
+      LOG_ERROR("%s: Paging requires a compiled world file, loading the whole world", __func__);
+    }
+
+    LOG_INFO("Loading world file: \"%s\"", worldFilename.c_str());
+    WorldXml worldXml;
+    auto parsedOk = parseWorldXml(worldFilename, &worldXml);
+    if (!itemFactoryLoaded.get())
+    {
+      LOG_ERROR("%s: Could not initialize ItemFactory", __func__);
+      return std::unique_ptr<World>();
+    }
+    if (parsedOk)
+    {
+      tiles = createTiles(worldXml, *itemFactory);
+    }
+  }
+
+  if (!tiles)
+  {
+    LOG_ERROR("%s: Could not load world file: \"%s\"", __func__, worldFilename.c_str());
     return std::unique_ptr<World>();
   }
 
-  // Open world.xml and read it into a string
+  auto worldSizeX = tiles->getSizeX();
+  auto worldSizeY = tiles->getSizeY();
+  LOG_INFO("World loaded, size: %d x %d", worldSizeX, worldSizeY);
+  return std::unique_ptr<World>(new World(std::move(itemFactory), worldSizeX, worldSizeY, std::move(*tiles)));
+}
+
+std::unique_ptr<TileGrid> WorldFactory::loadWorldXml(const std::string& worldFilename,
+                                                     const ItemFactory& itemFactory,
+                                                     std::size_t bandSize)
+{
   LOG_INFO("Loading world file: \"%s\"", worldFilename.c_str());
-  std::ifstream xmlFile(worldFilename);
-  if (!xmlFile.is_open())
+  WorldXml worldXml;
+  if (!parseWorldXml(worldFilename, &worldXml, bandSize))
   {
-    LOG_ERROR("%s: Could not open file: \"%s\"", __func__, worldFilename.c_str());
-    return std::unique_ptr<World>();
+    return std::unique_ptr<TileGrid>();
+  }
+  return createTiles(worldXml, itemFactory);
+}
+
+std::unique_ptr<TileGrid> WorldFactory::loadWorldFile(const std::string& worldFilename,
+                                                      const ItemFactory& itemFactory)
+{
+  LOG_INFO("Loading compiled world file: \"%s\"", worldFilename.c_str());
+  WorldFile worldFile;
+  if (!worldFile.open(worldFilename))
+  {
+    return std::unique_ptr<TileGrid>();
+  }
+
+  std::unique_ptr<TileGrid> tiles(new TileGrid(worldFile.getStartX(),
+                                               worldFile.getStartY(),
+                                               worldFile.getSizeX(),
+                                               worldFile.getSizeY()));
+
+  // The chunks are independent of each other, so load them in parallel, with every thread
+  // loading every numberOfThreads:th chunk
+  auto numberOfThreads = getNumberOfThreads();
+  std::vector<std::future<bool>> loaded;
+  for (auto thread = 0; thread < numberOfThreads; thread++)
+  {
+    loaded.push_back(std::async(std::launch::async, [thread, numberOfThreads, &worldFile, &itemFactory, &tiles]()
+    {
+      for (auto chunkIndex = static_cast<std::size_t>(thread);
+           chunkIndex < worldFile.getNumberOfChunks();
+           chunkIndex += numberOfThreads)
+      {
+        if (!worldFile.loadChunk(chunkIndex, itemFactory, tiles.get()))
+        {
+          return false;
+        }
+      }
+      return true;
+    }));
+  }
+
+  auto ok = true;
+  for (auto& threadLoaded : loaded)
+  {
+    ok = threadLoaded.get() && ok;
   }
+  return ok ? std::move(tiles) : std::unique_ptr<TileGrid>();
+}
 
-  std::string tempString;
-  std::ostringstream xmlStringStream;
-  while (std::getline(xmlFile, tempString))
+std::unique_ptr<TileGrid> WorldFactory::loadWorldFilePaged(const std::string& worldFilename,
+                                                           const ItemFactory& itemFactory)
+{
+  LOG_INFO("Opening compiled world file: \"%s\" (paged)", worldFilename.c_str());
+  std::shared_ptr<WorldFile> worldFile(new WorldFile());
+  if (!worldFile->open(worldFilename))
   {
-    xmlStringStream << tempString << "\n";
+    return std::unique_ptr<TileGrid>();
   }
 
-  // Convert the std::string to a char*
-  char* xmlString = strdup(xmlStringStream.str().c_str());
+  std::unique_ptr<TileGrid> tiles(new TileGrid(worldFile->getStartX(),
+                                               worldFile->getStartY(),
+                                               worldFile->getSizeX(),
+                                               worldFile->getSizeY()));
+  const auto* itemFactoryPtr = &itemFactory;
+  tiles->setChunkLoader([worldFile, itemFactoryPtr](std::size_t chunkIndex, TileGrid* tiles)
+  {
+    return worldFile->loadChunk(chunkIndex, *itemFactoryPtr, tiles);
+  });
+  return tiles;
+}
+
+bool WorldFactory::parseWorldXml(const std::string& worldFilename, WorldXml* worldXml, std::size_t bandSize)
+{
+  // The file is mmap:ed and scanned one tag at a time, and only the ItemIds are stored
+  MappedFile xmlFile;
+  if (!xmlFile.open(worldFilename))
+  {
+    return false;
+  }
+  xmlFile.adviseSequential();
 
-  // Parse the XML string with Rapidxml
-  rapidxml::xml_document<> worldXml;
-  worldXml.parse<0>(xmlString);
+  const auto* begin = xmlFile.getData();
+  const auto* end = xmlFile.getData() + xmlFile.getSize();
+  XmlScanner scanner(begin, end);
+  XmlScanner::Element element;
 
   // Get top node (<map>)
-  auto* mapNode = worldXml.first_node();
+  if (!scanner.next(&element) || element.type != XmlScanner::Element::Type::START || !element.isNamed("map"))
+  {
+    LOG_ERROR("%s: Invalid file, missing <map>-node", __func__);
+    return false;
+  }
 
   // Read width and height
-  auto* widthAttr = mapNode->first_attribute("width");
-  auto* heightAttr = mapNode->first_attribute("height");
-  if (widthAttr == nullptr || heightAttr == nullptr)
+  if (!element.getAttribute("width", &worldXml->sizeX) || !element.getAttribute("height", &worldXml->sizeY))
   {
     LOG_ERROR("%s: Invalid file, missing attributes width or height in <map>-node", __func__);
-    free(xmlString);
-    return std::unique_ptr<World>();
+    return false;
   }
 
-  int worldSizeX = std::stoi(widthAttr->value());
-  int worldSizeY = std::stoi(heightAttr->value());
+  // Split the rest of the file into bands and parse them in parallel
+  begin = scanner.getPosition();
+  auto fileSize = static_cast<std::size_t>(end - begin);
+  auto numberOfBands = (bandSize > 0) ? (fileSize / bandSize) + 1
+                                      : std::min(static_cast<std::size_t>(getNumberOfThreads()),
+                                                 (fileSize / MIN_BAND_SIZE) + 1);
+  std::vector<TileBand> bands;
+  if (!parseTileBands(begin, end, numberOfBands, &bands))
+  {
+    LOG_INFO("%s: Found <tile> in a comment or CDATA section, parsing the file in a single band", __func__);
+    parseTileBands(begin, end, 1, &bands);
+  }
 
-  // Read tiles
-  std::unordered_map<Position, Tile, Position::Hash> tiles;
-  auto* tileNode = mapNode->first_node();
-  for (int y = worldSizeStart_; y < worldSizeStart_ + worldSizeY; y++)
+  // Merge the bands, using the prefix sums of their number of Tiles and ItemIds
+  std::size_t numberOfTiles = 0;
+  std::size_t numberOfItems = 0;
+  for (const auto& band : bands)
   {
-    for (int x = worldSizeStart_; x < worldSizeStart_ + worldSizeX; x++)
+    if (!band.ok)
     {
-      Position position(x, y, 7);
+      return false;
+    }
+    numberOfTiles += band.itemOffsets.size();
+    numberOfItems += band.itemIds.size();
+  }
 
-      if (tileNode == nullptr)
-      {
-        LOG_ERROR("%s: Invalid file, missing <tile>-node", __func__);
-        free(xmlString);
-        return std::unique_ptr<World>();
-      }
+  if (numberOfTiles < static_cast<std::size_t>(worldXml->sizeX) * worldXml->sizeY)
+  {
+    LOG_ERROR("%s: Invalid file, missing <tile>-node", __func__);
+    return false;
+  }
 
-      // Read the first <item> (there must be at least one, the ground item)
-      // TODO(gurka): Must there be one? What about "void", or is it also an Item?
-      auto* groundItemNode = tileNode->first_node();
-      if (groundItemNode == nullptr)
-      {
-        LOG_ERROR("%s: Invalid file, <tile>-node is missing <item>-node", __func__);
-        free(xmlString);
-        return std::unique_ptr<World>();
-      }
-      auto* groundItemAttr = groundItemNode->first_attribute("id");
-      if (groundItemAttr == nullptr)
-      {
-        LOG_ERROR("%s: Invalid file, missing attribute id in <item>-node", __func__);
-        free(xmlString);
-        return std::unique_ptr<World>();
-      }
+  worldXml->itemOffsets.reserve(numberOfTiles + 1);
+  worldXml->itemIds.reserve(numberOfItems);
+  for (const auto& band : bands)
+  {
+    uint32_t bandItemOffset = worldXml->itemIds.size();
+    for (auto itemOffset : band.itemOffsets)
+    {
+      worldXml->itemOffsets.push_back(bandItemOffset + itemOffset);
+    }
+    worldXml->itemIds.insert(worldXml->itemIds.end(), band.itemIds.cbegin(), band.itemIds.cend());
+  }
+  worldXml->itemOffsets.push_back(worldXml->itemIds.size());
 
-      auto groundItemId = std::stoi(groundItemAttr->value());
-      auto groundItem = itemFactory->createItem(groundItemId);
-      tiles.insert(std::make_pair(position, Tile(groundItem)));
+  return true;
+}
 
-      // Read more items to put in this tile
-      // But due to the way otserv-3.0 made world.xml, do it backwards
-      for (auto* itemNode = tileNode->last_node(); itemNode != groundItemNode; itemNode = itemNode->previous_sibling())
+std::unique_ptr<TileGrid> WorldFactory::createTiles(const WorldXml& worldXml, const ItemFactory& itemFactory)
+{
+  std::unique_ptr<TileGrid> tiles(new TileGrid(worldSizeStart_, worldSizeStart_, worldXml.sizeX, worldXml.sizeY));
+
+  // Create the Tiles in parallel, in bands of whole chunk rows so that no two threads
+  // touch the same chunk in the TileGrid
+  auto numberOfChunkRows = (worldXml.sizeY + TileGrid::CHUNK_SIZE - 1) / TileGrid::CHUNK_SIZE;
+  auto numberOfThreads = std::min(getNumberOfThreads(), numberOfChunkRows);
+  std::vector<std::future<void>> created;
+  for (auto thread = 0; thread < numberOfThreads; thread++)
+  {
+    auto beginY = (numberOfChunkRows * thread / numberOfThreads) * TileGrid::CHUNK_SIZE;
+    auto endY = std::min((numberOfChunkRows * (thread + 1) / numberOfThreads) * TileGrid::CHUNK_SIZE, worldXml.sizeY);
+    created.push_back(std::async(std::launch::async, [beginY, endY, &worldXml, &itemFactory, &tiles]()
+    {
+      for (auto y = beginY; y < endY; y++)
       {
-        auto* itemIdAttr = itemNode->first_attribute("id");
-        if (itemIdAttr == nullptr)
+        for (auto x = 0; x < worldXml.sizeX; x++)
         {
-          LOG_DEBUG("%s: Missing attribute id in <item>-node, skipping Item", __func__);
-          continue;
-        }
+          Position position(worldSizeStart_ + x, worldSizeStart_ + y, 7);
+          auto tileIndex = (static_cast<std::size_t>(y) * worldXml.sizeX) + x;
+          const auto* itemIds = worldXml.itemIds.data() + worldXml.itemOffsets[tileIndex];
+          auto numberOfItems = worldXml.itemOffsets[tileIndex + 1] - worldXml.itemOffsets[tileIndex];
 
-        auto itemId = std::stoi(itemIdAttr->value());
-        tiles.at(position).addItem(itemFactory->createItem(itemId));
-      }
+          Tile tile(itemFactory.createItem(itemIds[0]));
 
-      // Go to next <tile> in XML
-      tileNode = tileNode->next_sibling();
-    }
+          // Add the rest of the Items to this tile
+          // But due to the way otserv-3.0 made world.xml, do it backwards
+          for (auto i = numberOfItems - 1; i > 0; i--)
+          {
+            tile.addItem(itemFactory.createItem(itemIds[i]));
+          }
+
+          tiles->setTile(position, tile);
+        }
+      }
+    }));
+  }
+  for (auto& threadCreated : created)
+  {
+    threadCreated.get();
   }
 
-  LOG_INFO("World loaded, size: %d x %d", worldSizeX, worldSizeY);
-  free(xmlString);
+  return tiles;
+}
 
-  return std::unique_ptr<World>(new World(std::move(itemFactory), worldSizeX, worldSizeY, tiles));
+int WorldFactory::getNumberOfThreads()
+{
+  auto numberOfThreads = static_cast<int>(std::thread::hardware_concurrency());
+  return numberOfThreads > 0 ? numberOfThreads : 1;
 }
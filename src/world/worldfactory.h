@@ -25,19 +25,62 @@
 #ifndef WORLD_WORLDFACTORY_H_
 #define WORLD_WORLDFACTORY_H_
 
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 
+class ItemFactory;
+class TileGrid;
 class World;
 
 class WorldFactory
 {
  public:
+  // worldFilename is either a world.xml file or a compiled world file (see WorldFile)
+  // If paged is true and worldFilename is a compiled world file, the chunks are loaded
+  // from the file when they are accessed instead of up front (see TileGrid)
   static std::unique_ptr<World> createWorld(const std::string& dataFilename,
                                             const std::string& itemsFilename,
-                                            const std::string& worldFilename);
+                                            const std::string& worldFilename,
+                                            bool paged = false);
+
+  // Returns an empty unique_ptr if the file could not be loaded
+  // world.xml is parsed in bands of bandSize bytes, in parallel. With bandSize 0 there is
+  // one band per thread, but with at least MIN_BAND_SIZE bytes per band
+  static std::unique_ptr<TileGrid> loadWorldXml(const std::string& worldFilename,
+                                                const ItemFactory& itemFactory,
+                                                std::size_t bandSize = 0);
+  static std::unique_ptr<TileGrid> loadWorldFile(const std::string& worldFilename,
+                                                 const ItemFactory& itemFactory);
+
+  // Returns a TileGrid that loads its chunks from the world file when they are accessed
+  // The ItemFactory must outlive the TileGrid
+  static std::unique_ptr<TileGrid> loadWorldFilePaged(const std::string& worldFilename,
+                                                      const ItemFactory& itemFactory);
 
  private:
+  // The ItemIds of all Tiles in a world.xml file, in row order
+  // The ItemIds of the i:th Tile are itemIds[itemOffsets[i]] up to (but not including)
+  // itemIds[itemOffsets[i + 1]], in the order they appear in the file
+  struct WorldXml
+  {
+    int sizeX;
+    int sizeY;
+    std::vector<uint32_t> itemOffsets;
+    std::vector<uint16_t> itemIds;
+  };
+
+  static const std::size_t MIN_BAND_SIZE = 1024 * 1024;
+
+  // Parsing world.xml doesn't need the ItemFactory, so it can be done while the ItemFactory
+  // is loading, and then the Tiles are created when it has loaded
+  static bool parseWorldXml(const std::string& worldFilename, WorldXml* worldXml, std::size_t bandSize = 0);
+  static std::unique_ptr<TileGrid> createTiles(const WorldXml& worldXml, const ItemFactory& itemFactory);
+
+  static int getNumberOfThreads();
+
   // Offset for world size, since the client doesn't like too low positions
   // TODO(gurka): This constant is both in WorldFactory and in World
   static const int worldSizeStart_ = 192;
@@ -0,0 +1,280 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "worldfile.h"
+
+#include <cstdio>
+#include <vector>
+
+#include "itemfactory.h"
+#include "position.h"
+#include "tile.h"
+#include "tilegrid.h"
+#include "logger.h"
+
+namespace
+{
+
+const std::size_t TILES_PER_CHUNK = TileGrid::CHUNK_SIZE * TileGrid::CHUNK_SIZE;
+
+// Chunk data is aligned to 8 bytes in the file
+std::size_t alignOffset(std::size_t offset)
+{
+  return (offset + 7) & ~static_cast<std::size_t>(7);
+}
+
+// Returns the position of the i:th Tile in the given chunk, with the same layout as TileGrid
+Position getTilePosition(const WorldFile::Header& header, std::size_t chunkIndex, std::size_t tileIndex)
+{
+  auto chunksX = (header.sizeX + TileGrid::CHUNK_SIZE - 1) / TileGrid::CHUNK_SIZE;
+  auto chunksY = (header.sizeY + TileGrid::CHUNK_SIZE - 1) / TileGrid::CHUNK_SIZE;
+  auto chunkX = chunkIndex % chunksX;
+  auto chunkY = (chunkIndex / chunksX) % chunksY;
+  auto z = chunkIndex / (chunksX * chunksY);
+  return Position(header.startX + (chunkX * TileGrid::CHUNK_SIZE) + (tileIndex % TileGrid::CHUNK_SIZE),
+                  header.startY + (chunkY * TileGrid::CHUNK_SIZE) + (tileIndex / TileGrid::CHUNK_SIZE),
+                  z);
+}
+
+}  // namespace
+
+WorldFile::WorldFile()
+  : header_(nullptr),
+    chunks_(nullptr)
+{
+}
+
+WorldFile::~WorldFile()
+{
+  close();
+}
+
+bool WorldFile::isWorldFile(const std::string& filename)
+{
+  FILE* f = fopen(filename.c_str(), "rb");
+  if (f == nullptr)
+  {
+    return false;
+  }
+
+  uint32_t magic = 0;
+  auto isWorldFile = fread(&magic, sizeof(magic), 1, f) == 1 && magic == MAGIC;
+  fclose(f);
+  return isWorldFile;
+}
+
+bool WorldFile::write(const std::string& filename, const TileGrid& tiles)
+{
+  Header header = {};
+  header.magic = MAGIC;
+  header.version = VERSION;
+  header.startX = tiles.getStartX();
+  header.startY = tiles.getStartY();
+  header.sizeX = tiles.getSizeX();
+  header.sizeY = tiles.getSizeY();
+  header.chunkSize = TileGrid::CHUNK_SIZE;
+  header.numberOfFloors = TileGrid::NUM_FLOORS;
+  header.numberOfChunks = ((header.sizeX + TileGrid::CHUNK_SIZE - 1) / TileGrid::CHUNK_SIZE) *
+                          ((header.sizeY + TileGrid::CHUNK_SIZE - 1) / TileGrid::CHUNK_SIZE) *
+                          TileGrid::NUM_FLOORS;
+
+  FILE* f = fopen(filename.c_str(), "wb");
+  if (f == nullptr)
+  {
+    LOG_ERROR("%s: Could not open file: \"%s\"", __func__, filename.c_str());
+    return false;
+  }
+
+  // The chunk data is written first (after room for the header and the chunk index), and
+  // then the header and the chunk index when all offsets are known
+  std::vector<ChunkEntry> chunks(header.numberOfChunks, ChunkEntry());
+  std::size_t offset = alignOffset(sizeof(Header) + (chunks.size() * sizeof(ChunkEntry)));
+
+  std::vector<uint32_t> itemOffsets(TILES_PER_CHUNK + 1);
+  std::vector<uint16_t> itemIds;
+  bool ok = true;
+  for (std::size_t chunkIndex = 0; chunkIndex < chunks.size() && ok; chunkIndex++)
+  {
+    itemIds.clear();
+    for (std::size_t tileIndex = 0; tileIndex < TILES_PER_CHUNK; tileIndex++)
+    {
+      itemOffsets[tileIndex] = itemIds.size();
+
+      const auto* tile = tiles.getTile(getTilePosition(header, chunkIndex, tileIndex));
+      if (tile != nullptr)
+      {
+        for (const auto& item : tile->getItems())
+        {
+          itemIds.push_back(item.getItemId());
+        }
+      }
+    }
+    itemOffsets[TILES_PER_CHUNK] = itemIds.size();
+
+    if (itemIds.empty())
+    {
+      continue;
+    }
+
+    chunks[chunkIndex].offset = offset;
+    chunks[chunkIndex].numberOfItems = itemIds.size();
+
+    static const uint8_t padding[8] = {};
+    auto chunkSize = (itemOffsets.size() * sizeof(uint32_t)) + (itemIds.size() * sizeof(uint16_t));
+    ok = fseek(f, offset, SEEK_SET) == 0 &&
+         fwrite(itemOffsets.data(), sizeof(uint32_t), itemOffsets.size(), f) == itemOffsets.size() &&
+         fwrite(itemIds.data(), sizeof(uint16_t), itemIds.size(), f) == itemIds.size() &&
+         fwrite(padding, 1, alignOffset(chunkSize) - chunkSize, f) == alignOffset(chunkSize) - chunkSize;
+    offset += alignOffset(chunkSize);
+  }
+
+  ok = ok &&
+       fseek(f, 0, SEEK_SET) == 0 &&
+       fwrite(&header, sizeof(header), 1, f) == 1 &&
+       fwrite(chunks.data(), sizeof(ChunkEntry), chunks.size(), f) == chunks.size();
+
+  if (fclose(f) != 0 || !ok)
+  {
+    LOG_ERROR("%s: Could not write file: \"%s\"", __func__, filename.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+bool WorldFile::open(const std::string& filename)
+{
+  close();
+
+  if (!file_.open(filename))
+  {
+    return false;
+  }
+
+  if (file_.getSize() < sizeof(Header))
+  {
+    LOG_ERROR("%s: Invalid file: \"%s\"", __func__, filename.c_str());
+    close();
+    return false;
+  }
+
+  header_ = reinterpret_cast<const Header*>(file_.getData());
+  chunks_ = reinterpret_cast<const ChunkEntry*>(file_.getData() + sizeof(Header));
+
+  if (header_->magic != MAGIC || header_->version != VERSION)
+  {
+    LOG_ERROR("%s: Invalid magic or version in file: \"%s\" (version: %u, expected: %u)",
+              __func__,
+              filename.c_str(),
+              header_->version,
+              VERSION);
+    close();
+    return false;
+  }
+
+  if (header_->chunkSize != TileGrid::CHUNK_SIZE ||
+      header_->numberOfFloors != TileGrid::NUM_FLOORS ||
+      header_->numberOfChunks != ((header_->sizeX + TileGrid::CHUNK_SIZE - 1) / TileGrid::CHUNK_SIZE) *
+                                 ((header_->sizeY + TileGrid::CHUNK_SIZE - 1) / TileGrid::CHUNK_SIZE) *
+                                 TileGrid::NUM_FLOORS ||
+      file_.getSize() < sizeof(Header) + (header_->numberOfChunks * sizeof(ChunkEntry)))
+  {
+    LOG_ERROR("%s: Invalid header in file: \"%s\"", __func__, filename.c_str());
+    close();
+    return false;
+  }
+
+  return true;
+}
+
+void WorldFile::close()
+{
+  file_.close();
+  header_ = nullptr;
+  chunks_ = nullptr;
+}
+
+bool WorldFile::loadChunk(std::size_t chunkIndex, const ItemFactory& itemFactory, TileGrid* tiles) const
+{
+  if (chunkIndex >= getNumberOfChunks())
+  {
+    LOG_ERROR("%s: Invalid chunkIndex: %zu", __func__, chunkIndex);
+    return false;
+  }
+
+  const auto& chunk = chunks_[chunkIndex];
+  if (chunk.offset == 0)
+  {
+    // No Tiles in this chunk
+    return true;
+  }
+
+  auto dataSize = ((TILES_PER_CHUNK + 1) * sizeof(uint32_t)) + (chunk.numberOfItems * sizeof(uint16_t));
+  if (chunk.offset % sizeof(uint64_t) != 0 || chunk.offset > file_.getSize() || file_.getSize() - chunk.offset < dataSize)
+  {
+    LOG_ERROR("%s: Chunk %zu is outside of the file", __func__, chunkIndex);
+    return false;
+  }
+
+  const auto* itemOffsets = reinterpret_cast<const uint32_t*>(file_.getData() + chunk.offset);
+  const auto* itemIds = reinterpret_cast<const uint16_t*>(itemOffsets + TILES_PER_CHUNK + 1);
+  if (itemOffsets[0] != 0 || itemOffsets[TILES_PER_CHUNK] != chunk.numberOfItems)
+  {
+    LOG_ERROR("%s: Chunk %zu has invalid item offsets", __func__, chunkIndex);
+    return false;
+  }
+
+  for (std::size_t tileIndex = 0; tileIndex < TILES_PER_CHUNK; tileIndex++)
+  {
+    auto begin = itemOffsets[tileIndex];
+    auto end = itemOffsets[tileIndex + 1];
+    if (end < begin || end > chunk.numberOfItems)
+    {
+      LOG_ERROR("%s: Chunk %zu has invalid item offsets", __func__, chunkIndex);
+      return false;
+    }
+    else if (begin == end)
+    {
+      continue;
+    }
+
+    auto position = getTilePosition(*header_, chunkIndex, tileIndex);
+    if (position.getX() >= getStartX() + getSizeX() || position.getY() >= getStartY() + getSizeY())
+    {
+      LOG_ERROR("%s: Chunk %zu has a Tile outside of the world", __func__, chunkIndex);
+      return false;
+    }
+
+    // The Items are stored in stack position order, and Tile::addItem puts the Item
+    // first among the top or the bottom Items, so add them in reverse order
+    Tile tile(itemFactory.createItem(itemIds[begin]));
+    for (auto i = end - 1; i > begin; i--)
+    {
+      tile.addItem(itemFactory.createItem(itemIds[i]));
+    }
+    tiles->setTile(position, tile);
+  }
+
+  return true;
+}
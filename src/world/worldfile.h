@@ -0,0 +1,115 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WORLD_WORLDFILE_H_
+#define WORLD_WORLDFILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "mappedfile.h"
+
+class ItemFactory;
+class TileGrid;
+
+// A compiled world file (created by worldcompiler from world.xml), which is a binary
+// image of a TileGrid that is mmap:ed and read in place:
+//
+//   Header
+//   ChunkEntry[numberOfChunks]  indexed in the same way as TileGrid's chunks
+//   Chunk data                  for each chunk that has at least one Tile
+//
+// The chunk data of a chunk is:
+//
+//   uint32_t itemOffsets[CHUNK_SIZE * CHUNK_SIZE + 1]
+//   uint16_t itemIds[numberOfItems]
+//
+// The Items of the i:th Tile in the chunk are itemIds[itemOffsets[i]] up to (but not
+// including) itemIds[itemOffsets[i + 1]], in stack position order (i.e. the first one is
+// the ground Item). A Tile without Items is not set.
+//
+// All values are stored in host byte order, a file with the wrong byte order is rejected
+// since its magic and version won't match
+class WorldFile
+{
+ public:
+  static const uint32_t MAGIC = 0x42575347;  // "GSWB"
+  static const uint32_t VERSION = 1;
+
+  struct Header
+  {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t startX;
+    uint32_t startY;
+    uint32_t sizeX;
+    uint32_t sizeY;
+    uint32_t chunkSize;
+    uint32_t numberOfFloors;
+    uint32_t numberOfChunks;
+    uint32_t reserved;
+  };
+
+  struct ChunkEntry
+  {
+    uint64_t offset;  // 0 if the chunk has no Tiles
+    uint32_t numberOfItems;
+    uint32_t reserved;
+  };
+
+  WorldFile();
+  ~WorldFile();
+
+  // Delete copy constructors
+  WorldFile(const WorldFile&) = delete;
+  WorldFile& operator=(const WorldFile&) = delete;
+
+  // Returns true if the file exists and starts with MAGIC
+  static bool isWorldFile(const std::string& filename);
+
+  // Writes all Tiles in the TileGrid to a new world file
+  static bool write(const std::string& filename, const TileGrid& tiles);
+
+  bool open(const std::string& filename);
+  void close();
+  bool isOpen() const { return file_.isOpen(); }
+
+  int getStartX() const { return header_->startX; }
+  int getStartY() const { return header_->startY; }
+  int getSizeX() const { return header_->sizeX; }
+  int getSizeY() const { return header_->sizeY; }
+  std::size_t getNumberOfChunks() const { return header_->numberOfChunks; }
+
+  // Sets all Tiles in the given chunk in the TileGrid, which must have the same start and
+  // size as the world file. Returns false if the chunk data is invalid
+  bool loadChunk(std::size_t chunkIndex, const ItemFactory& itemFactory, TileGrid* tiles) const;
+
+ private:
+  MappedFile file_;
+  const Header* header_;
+  const ChunkEntry* chunks_;
+};
+
+#endif  // WORLD_WORLDFILE_H_
@@ -0,0 +1,73 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string>
+
+#include "itemfactory.h"
+#include "tilegrid.h"
+#include "worldfactory.h"
+#include "worldfile.h"
+#include "logger.h"
+
+// Compiles a world.xml file into a world file (see WorldFile), which the worldserver
+// loads much faster than world.xml
+// Usage: worldcompiler <data file> <items file> <world.xml file> <output file>
+int main(int argc, char* argv[])
+{
+  if (argc != 5)
+  {
+    LOG_INFO("Usage: %s <data file> <items file> <world.xml file> <output file>", argv[0]);
+    return 1;
+  }
+
+  std::string dataFilename(argv[1]);
+  std::string itemsFilename(argv[2]);
+  std::string worldFilename(argv[3]);
+  std::string outputFilename(argv[4]);
+
+  // The ItemFactory is needed to validate the ItemIds and to know which Items are
+  // alwaysOnTop, so that the Items are written in stack position order
+  ItemFactory itemFactory;
+  if (!itemFactory.initialize(dataFilename, itemsFilename))
+  {
+    LOG_ERROR("Could not initialize ItemFactory");
+    return 1;
+  }
+
+  auto tiles = WorldFactory::loadWorldXml(worldFilename, itemFactory);
+  if (!tiles)
+  {
+    LOG_ERROR("Could not load world file: \"%s\"", worldFilename.c_str());
+    return 1;
+  }
+
+  if (!WorldFile::write(outputFilename, *tiles))
+  {
+    LOG_ERROR("Could not write world file: \"%s\"", outputFilename.c_str());
+    return 1;
+  }
+
+  LOG_INFO("Compiled \"%s\" into \"%s\"", worldFilename.c_str(), outputFilename.c_str());
+  return 0;
+}
@@ -0,0 +1,149 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WORLDSERVER_COMMAND_H_
+#define WORLDSERVER_COMMAND_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+
+#include "creature.h"
+#include "direction.h"
+#include "position.h"
+
+// A player action, handed over from the network threads to the game thread through
+// GameEngine's command queue. Commands have a fixed size and store everything inline
+// (strings and paths are truncated if too long) so that no allocation is needed.
+// Commands are decoded directly from the client's packets by OpcodeTable.
+struct Command
+{
+  enum Type : uint8_t
+  {
+    MOVE,
+    MOVE_PATH,
+    CANCEL_MOVE,
+    TURN,
+    SAY,
+    MOVE_ITEM_POS_TO_POS,
+    MOVE_ITEM_POS_TO_INV,
+    MOVE_ITEM_INV_TO_POS,
+    MOVE_ITEM_INV_TO_INV,
+    USE_INV_ITEM,
+    USE_POS_ITEM,
+    LOOK_AT,
+  };
+
+  static const std::size_t MAX_PATH_LENGTH = 255;
+  static const std::size_t MAX_MESSAGE_LENGTH = 255;
+  static const std::size_t MAX_RECEIVER_LENGTH = 31;
+
+  // Position has constructors and can't be used in the union below
+  struct RawPosition
+  {
+    Position get() const { return Position(x, y, z); }
+
+    uint16_t x;
+    uint16_t y;
+    uint8_t z;
+  };
+
+  template<std::size_t MaxLength>
+  struct RawString
+  {
+    std::string get() const { return std::string(data, length); }
+
+    uint16_t length;
+    char data[MaxLength];
+  };
+
+  struct MoveData  // MOVE and TURN
+  {
+    Direction direction;
+  };
+
+  struct MovePathData
+  {
+    std::deque<Direction> get() const
+    {
+      std::deque<Direction> path;
+      for (auto i = 0; i < length; i++)
+      {
+        path.push_back(static_cast<Direction>(directions[i]));
+      }
+      return path;
+    }
+
+    uint8_t length;
+    uint8_t directions[MAX_PATH_LENGTH];
+  };
+
+  struct SayData
+  {
+    uint8_t type;
+    uint16_t channelId;
+    RawString<MAX_MESSAGE_LENGTH> message;
+    RawString<MAX_RECEIVER_LENGTH> receiver;
+  };
+
+  struct MoveItemData  // All MOVE_ITEM_*, only the relevant from/to fields are set
+  {
+    RawPosition fromPosition;
+    int fromStackPos;
+    int fromInventoryId;
+    int itemId;
+    int count;
+    RawPosition toPosition;
+    int toInventoryId;
+  };
+
+  struct UseItemData  // USE_INV_ITEM and USE_POS_ITEM
+  {
+    int itemId;
+    int inventoryIndex;
+    RawPosition position;
+    int stackPos;
+  };
+
+  struct LookAtData
+  {
+    RawPosition position;
+    int itemId;
+  };
+
+  Type type;
+  CreatureId creatureId;
+  union
+  {
+    MoveData move;
+    MovePathData movePath;
+    SayData say;
+    MoveItemData moveItem;
+    UseItemData useItem;
+    LookAtData lookAt;
+  };
+};
+
+#endif  // WORLDSERVER_COMMAND_H_
@@ -41,15 +41,37 @@
 #include "worldfactory.h"
 #include "logger.h"
 
+const int GameEngine::CHUNK_EVICT_INTERVAL;
+
+thread_local GameEngine::Worker* GameEngine::currentWorker_ = nullptr;
+
 GameEngine::GameEngine(boost::asio::io_service* io_service,
                        const std::string& loginMessage,
                        const std::string& dataFilename,
                        const std::string& itemsFilename,
-                       const std::string& worldFilename)
-  : state_(INITIALIZED),
-    taskQueue_(io_service, std::bind(&GameEngine::onTask, this, std::placeholders::_1)),
+                       const std::string& worldFilename,
+                       int tickRate,
+                       int workerThreads,
+                       bool pagedWorld,
+                       int pagedIdleTimeout,
+                       int pagedMemoryBudget)
+  : io_service_(io_service),
+    state_(INITIALIZED),
+    taskQueue_(io_service, std::bind(&GameEngine::onTask, this, std::placeholders::_1), tickRate <= 0),
+    drainPosted_(false),
+    tickRate_(tickRate),
+    tickInterval_(tickRate > 0 ? std::chrono::steady_clock::duration(std::chrono::seconds(1)) / tickRate
+                              : std::chrono::steady_clock::duration(0)),
+    tickTimer_(*io_service),
+    tickCount_(0),
+    tickOverruns_(0),
+    tickDurationTotal_(0),
+    tickDurationMax_(0),
+    pagedIdleTimeout_(pagedIdleTimeout),
+    pagedMaxChunks_(static_cast<std::size_t>(pagedMemoryBudget) * 1024 * 1024 / TileGrid::getChunkMemoryUsage()),
+    workerThreads_(workerThreads),
     loginMessage_(loginMessage),
-    world_(WorldFactory::createWorld(dataFilename, itemsFilename, worldFilename))
+    world_(WorldFactory::createWorld(dataFilename, itemsFilename, worldFilename, pagedWorld))
 {
 }
 
@@ -77,6 +99,28 @@ bool GameEngine::start()
   }
 
   state_ = RUNNING;
+
+  if (workerThreads_ > 0)
+  {
+    startWorkers();
+  }
+
+  if (tickRate_ > 0)
+  {
+    LOG_INFO("%s: Running %d ticks per second", __func__, tickRate_);
+    nextTickTime_ = std::chrono::steady_clock::now() + tickInterval_;
+    startTickTimer();
+  }
+
+  if (world_->isPaged())
+  {
+    LOG_INFO("%s: World is paged, evicting chunks idle for %d s or above %zu chunks",
+             __func__,
+             static_cast<int>(pagedIdleTimeout_.count()),
+             pagedMaxChunks_);
+    taskQueue_.addTask(std::bind(&GameEngine::evictChunks, this), std::chrono::seconds(CHUNK_EVICT_INTERVAL));
+  }
+
   return true;
 }
 
@@ -85,6 +129,8 @@ bool GameEngine::stop()
   if (state_ == RUNNING)
   {
     state_ = CLOSING;
+    tickTimer_.cancel();
+    stopWorkers();
     return true;
   }
   else
@@ -94,19 +140,13 @@ bool GameEngine::stop()
   }
 }
 
-CreatureId GameEngine::playerSpawn(const std::string& name, const std::function<void(const OutgoingPacket&)>& sendPacket)
+CreatureId GameEngine::playerSpawn(const std::string& name,
+                                   const PlayerCtrl::SendPacket& sendPacket,
+                                   const PlayerCtrl::SendSharedPacket& sendSharedPacket)
 {
-  // Create Player and PlayerCtrl here
-  std::unique_ptr<Player> player(new Player(name));
-  std::unique_ptr<PlayerCtrl> playerCtrl(new PlayerCtrl(world_.get(), player->getCreatureId(), sendPacket));
-
-  auto creatureId = player->getCreatureId();
-
-  players_.insert(std::make_pair(creatureId, std::move(player)));
-  playerCtrls_.insert(std::make_pair(creatureId, std::move(playerCtrl)));
-
-  addTask(&GameEngine::playerSpawnInternal, creatureId);
-
+  // The Player and PlayerCtrl are created by the task, only reserve the CreatureId here
+  auto creatureId = Creature::getFreeCreatureId();
+  addTask(&GameEngine::playerSpawnInternal, creatureId, name, sendPacket, sendSharedPacket);
   return creatureId;
 }
 
@@ -115,71 +155,24 @@ void GameEngine::playerDespawn(CreatureId creatureId)
   addTask(&GameEngine::playerDespawnInternal, creatureId);
 }
 
-void GameEngine::playerMove(CreatureId creatureId, Direction direction)
-{
-  addTask(&GameEngine::playerMoveInternal, creatureId, direction);
-}
-
-void GameEngine::playerMovePath(CreatureId creatureId, const std::deque<Direction>& moves)
-{
-  addTask(&GameEngine::playerMovePathInternal, creatureId, moves);
-}
-
-void GameEngine::playerCancelMove(CreatureId creatureId)
-{
-  addTask(&GameEngine::playerCancelMoveInternal, creatureId);
-}
-
-void GameEngine::playerTurn(CreatureId creatureId, Direction direction)
-{
-  addTask(&GameEngine::playerMoveInternal, creatureId, direction);
-}
-
-void GameEngine::playerSay(CreatureId creatureId, uint8_t type, const std::string& message,
-                           const std::string& receiver, uint16_t channelId)
-{
-  addTask(&GameEngine::playerSayInternal, creatureId, type, message, receiver, channelId);
-}
-
-void GameEngine::playerMoveItemFromPosToPos(CreatureId creatureId, const Position& fromPosition, int fromStackPos,
-                                            int itemId, int count, const Position& toPosition)
-{
-  addTask(&GameEngine::playerMoveItemFromPosToPosInternal, creatureId, fromPosition, fromStackPos, itemId, count, toPosition);
-}
-
-void GameEngine::playerMoveItemFromPosToInv(CreatureId creatureId, const Position& fromPosition, int fromStackPos,
-                                            int itemId, int count, int toInventoryId)
-{
-  addTask(&GameEngine::playerMoveItemFromPosToInvInternal, creatureId, fromPosition, fromStackPos, itemId, count, toInventoryId);
-}
-
-void GameEngine::playerMoveItemFromInvToPos(CreatureId creatureId, int fromInventoryId, int itemId, int count, const Position& toPosition)
-{
-  addTask(&GameEngine::playerMoveItemFromInvToPosInternal, creatureId, fromInventoryId, itemId, count, toPosition);
-}
-
-void GameEngine::playerMoveItemFromInvToInv(CreatureId creatureId, int fromInventoryId, int itemId, int count, int toInventoryId)
-{
-  addTask(&GameEngine::playerMoveItemFromInvToInvInternal, creatureId, fromInventoryId, itemId, count, toInventoryId);
-}
-
-void GameEngine::playerUseInvItem(CreatureId creatureId, int itemId, int inventoryIndex)
+void GameEngine::playerSpawnInternal(CreatureId creatureId,
+                                     const std::string& name,
+                                     const PlayerCtrl::SendPacket& sendPacket,
+                                     const PlayerCtrl::SendSharedPacket& sendSharedPacket)
 {
-  addTask(&GameEngine::playerUseInvItemInternal, creatureId, itemId, inventoryIndex);
-}
-
-void GameEngine::playerUsePosItem(CreatureId creatureId, int itemId, const Position& position, int stackPos)
-{
-  addTask(&GameEngine::playerUsePosItemInternal, creatureId, itemId, position, stackPos);
-}
+  // Spawning modifies the World (and players_ and playerCtrls_) as a whole
+  if (worldRegions_)
+  {
+    worldRegions_->lockAll();
+  }
 
-void GameEngine::playerLookAt(CreatureId creatureId, const Position& position, ItemId itemId)
-{
-  addTask(&GameEngine::playerLookAtInternal, creatureId, position, itemId);
-}
+  // Create Player and PlayerCtrl here
+  players_.insert(std::make_pair(creatureId, std::unique_ptr<Player>(new Player(creatureId, name))));
+  playerCtrls_.insert(std::make_pair(creatureId, std::unique_ptr<PlayerCtrl>(new PlayerCtrl(world_.get(),
+                                                                                            creatureId,
+                                                                                            sendPacket,
+                                                                                            sendSharedPacket))));
 
-void GameEngine::playerSpawnInternal(CreatureId creatureId)
-{
   auto& player = getPlayer(creatureId);
   auto& playerCtrl = getPlayerCtrl(creatureId);
 
@@ -193,14 +186,47 @@ void GameEngine::playerSpawnInternal(CreatureId creatureId)
   {
     LOG_DEBUG("%s: Could not spawn player", __func__);
     // TODO(gurka): playerCtrl.disconnectPlayer();
+    if (worldRegions_)
+    {
+      worldRegions_->unlockAll();
+    }
     return;
   }
   playerCtrl.onPlayerSpawn(player, adjustedPosition, loginMessage_);
+
+  if (worldRegions_)
+  {
+    worldRegions_->unlockAll();
+
+    // Hand the player over to the worker that owns the region it spawned in
+    auto workerIndex = getWorkerIndex(adjustedPosition);
+    creatureWorkers_[creatureId] = workerIndex;
+    workers_[workerIndex]->io_service.post(std::bind(&GameEngine::workerAddCreature,
+                                                     this,
+                                                     creatureId,
+                                                     adjustedPosition));
+  }
 }
 
 void GameEngine::playerDespawnInternal(CreatureId creatureId)
 {
   LOG_INFO("playerDespawn(): Despawn player, creature id: %d", creatureId);
+
+  if (worldRegions_)
+  {
+    // The player's tasks are on its worker, so let the worker despawn it
+    auto it = creatureWorkers_.find(creatureId);
+    if (it != creatureWorkers_.end())
+    {
+      workers_[it->second]->io_service.post(std::bind(&GameEngine::workerDespawnCreature, this, creatureId));
+      creatureWorkers_.erase(it);
+    }
+    return;
+  }
+
+  // Cancel any pending tasks (e.g. delayed moves) for the player
+  cancelCreatureTasks(creatureId);
+
   world_->removeCreature(creatureId);
 
   // Remove Player and PlayerCtrl
@@ -210,7 +236,11 @@ void GameEngine::playerDespawnInternal(CreatureId creatureId)
 
 void GameEngine::playerMoveInternal(CreatureId creatureId, Direction direction)
 {
+  // A new move replaces any delayed move or path that the player is walking
   auto& playerCtrl = getPlayerCtrl(creatureId);
+  playerCtrl.cancelMove();
+  cancelCreatureTasks(creatureId);
+
   auto nextWalkTime = playerCtrl.getNextWalkTime();
   auto now = boost::posix_time::ptime(boost::posix_time::microsec_clock::local_time());
 
@@ -220,7 +250,7 @@ void GameEngine::playerMoveInternal(CreatureId creatureId, Direction direction)
     World::ReturnCode rc = world_->creatureMove(creatureId, direction);
     if (rc == World::ReturnCode::THERE_IS_NO_ROOM)
     {
-      getPlayerCtrl(creatureId).sendCancel("There is no room.");
+      playerCtrl.sendCancel("There is no room.");
     }
   }
   else
@@ -234,23 +264,23 @@ void GameEngine::playerMoveInternal(CreatureId creatureId, Direction direction)
         getPlayerCtrl(creatureId).sendCancel("There is no room.");
       }
     };
-    taskQueue_.addTask(creatureMoveFunc, nextWalkTime);
+    addCreatureTask(creatureId, creatureMoveFunc, nextWalkTime);
   }
 }
 
 void GameEngine::playerMovePathInternal(CreatureId creatureId, const std::deque<Direction>& path)
 {
-  // TODO(gurka): This is garbage. We need to be able to cancel tasks, in case this function is called twice
-  // This probably true for many more functions that isn't implemented yet
+  // A new path replaces any delayed move or path that the player is walking
+  auto& playerCtrl = getPlayerCtrl(creatureId);
+  cancelCreatureTasks(creatureId);
+  playerCtrl.queueMoves(path);
 
-  /*
-  if (!path.empty())
-  {
-    getPlayerCtrl(creatureId).queueMoves(path);
-  }
+  playerMovePathStepInternal(creatureId);
+}
 
+void GameEngine::playerMovePathStepInternal(CreatureId creatureId)
+{
   auto& playerCtrl = getPlayerCtrl(creatureId);
-
   if (!playerCtrl.hasQueuedMove())
   {
     return;
@@ -261,17 +291,31 @@ void GameEngine::playerMovePathInternal(CreatureId creatureId, const std::deque<
 
   if (nextWalkTime <= now)
   {
-    LOG_INFO("%s: Player move, creature id: %d", __func__, creatureId);
-    world_->creatureMove(creatureId, playerCtrl.getNextQueuedMove());
+    LOG_DEBUG("%s: Player move, creature id: %d", __func__, creatureId);
+    World::ReturnCode rc = world_->creatureMove(creatureId, playerCtrl.getNextQueuedMove());
+    if (rc == World::ReturnCode::THERE_IS_NO_ROOM)
+    {
+      playerCtrl.sendCancel("There is no room.");
+      playerCtrl.cancelMove();
+      return;
+    }
+
+    if (!playerCtrl.hasQueuedMove())
+    {
+      return;
+    }
   }
 
-  taskQueue_.addTask(std::bind(&GameEngine::playerMovePathInternal, this, creatureId, std::deque<Direction>{}), playerCtrl.getNextWalkTime());
-  */
+  // The next step is taken when the player is allowed to move again
+  addCreatureTask(creatureId,
+                  std::bind(&GameEngine::playerMovePathStepInternal, this, creatureId),
+                  playerCtrl.getNextWalkTime());
 }
 
 void GameEngine::playerCancelMoveInternal(CreatureId creatureId)
 {
   getPlayerCtrl(creatureId).cancelMove();
+  cancelCreatureTasks(creatureId);
 }
 
 void GameEngine::playerTurnInternal(CreatureId creatureId, Direction direction)
@@ -620,6 +664,268 @@ void GameEngine::playerLookAtInternal(CreatureId creatureId, const Position& pos
   getPlayerCtrl(creatureId).sendTextMessage(ss.str());
 }
 
+void GameEngine::addCommand(const Command& command)
+{
+  if (!commandQueue_.push(command))
+  {
+    LOG_ERROR("%s: Command queue is full, dropping command type: %d from creature id: %d",
+              __func__, command.type, command.creatureId);
+    return;
+  }
+
+  // Only post a drain if there isn't one already pending
+  // With a tick rate the commands are drained by onTick instead
+  if (tickRate_ <= 0 && !drainPosted_.exchange(true))
+  {
+    io_service_->post(std::bind(&GameEngine::drainCommands, this));
+  }
+}
+
+void GameEngine::drainCommands()
+{
+  // Clear the flag before draining, so that a command added after we have stopped
+  // draining posts a new drain. exchange() makes sure that we see every command that
+  // was added by a producer that saw the flag set
+  drainPosted_.exchange(false);
+
+  auto count = commandQueue_.consume(std::bind(&GameEngine::onCommand, this, std::placeholders::_1),
+                                     MAX_COMMANDS_PER_DRAIN);
+  if (count == MAX_COMMANDS_PER_DRAIN && !drainPosted_.exchange(true))
+  {
+    // There might be more commands, let other handlers run before continuing
+    io_service_->post(std::bind(&GameEngine::drainCommands, this));
+  }
+}
+
+void GameEngine::evictChunks()
+{
+  // Evicting modifies the World as a whole
+  if (worldRegions_)
+  {
+    worldRegions_->lockAll();
+  }
+
+  auto loadedChunks = world_->evictChunks(pagedIdleTimeout_, pagedMaxChunks_);
+
+  if (worldRegions_)
+  {
+    worldRegions_->unlockAll();
+  }
+
+  LOG_DEBUG("%s: Chunks loaded: %zu", __func__, loadedChunks);
+  taskQueue_.addTask(std::bind(&GameEngine::evictChunks, this), std::chrono::seconds(CHUNK_EVICT_INTERVAL));
+}
+
+void GameEngine::startTickTimer()
+{
+  tickTimer_.expires_at(nextTickTime_);
+  tickTimer_.async_wait(std::bind(&GameEngine::onTick, this, std::placeholders::_1));
+}
+
+void GameEngine::onTick(const boost::system::error_code& ec)
+{
+  if (ec == boost::asio::error::operation_aborted)
+  {
+    // Canceled by stop
+    return;
+  }
+  else if (ec)
+  {
+    LOG_ERROR("%s: Tick timer error: %s", __func__, ec.message().c_str());
+    return;
+  }
+
+  if (state_ != RUNNING)
+  {
+    return;
+  }
+
+  auto tickStart = std::chrono::steady_clock::now();
+
+  // Execute all commands and tasks that have been added since the last tick
+  // All packets sent by them are flushed once by the Server, after this handler has returned
+  commandQueue_.consume(std::bind(&GameEngine::onCommand, this, std::placeholders::_1),
+                        COMMAND_QUEUE_SIZE);
+  taskQueue_.runTasks();
+
+  auto tickEnd = std::chrono::steady_clock::now();
+  auto tickDuration = tickEnd - tickStart;
+
+  tickCount_++;
+  tickDurationTotal_ += tickDuration;
+  if (tickDuration > tickDurationMax_)
+  {
+    tickDurationMax_ = tickDuration;
+  }
+
+  nextTickTime_ += tickInterval_;
+  if (nextTickTime_ <= tickEnd)
+  {
+    // We are behind, skip the ticks that we missed instead of trying to catch up
+    tickOverruns_++;
+    LOG_DEBUG("%s: Tick overrun, duration: %d us", __func__,
+              static_cast<int>(std::chrono::duration_cast<std::chrono::microseconds>(tickDuration).count()));
+    nextTickTime_ = tickEnd + tickInterval_;
+  }
+
+  if (tickCount_ == tickRate_ * TICK_STATS_INTERVAL)
+  {
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+    LOG_INFO("%s: Ticks: %d, average duration: %d us, max duration: %d us, overruns: %d",
+             __func__,
+             tickCount_,
+             static_cast<int>(duration_cast<microseconds>(tickDurationTotal_).count() / tickCount_),
+             static_cast<int>(duration_cast<microseconds>(tickDurationMax_).count()),
+             tickOverruns_);
+    tickCount_ = 0;
+    tickOverruns_ = 0;
+    tickDurationTotal_ = std::chrono::steady_clock::duration(0);
+    tickDurationMax_ = std::chrono::steady_clock::duration(0);
+  }
+
+  startTickTimer();
+}
+
+void GameEngine::onCommand(const Command& command)
+{
+  if (state_ != RUNNING)
+  {
+    LOG_INFO("%s: State is not RUNNING, not executing command.", __func__);
+    return;
+  }
+
+  // The player may have despawned (or not yet spawned) since the command was added,
+  // spawn and despawn are not added through the command queue
+  auto creatureId = command.creatureId;
+  if (worldRegions_)
+  {
+    // Forward the command to the worker that owns the player
+    auto it = creatureWorkers_.find(creatureId);
+    if (it == creatureWorkers_.end())
+    {
+      LOG_DEBUG("%s: No player with creature id: %d, skipping command type: %d",
+                __func__, creatureId, command.type);
+      return;
+    }
+
+    workers_[it->second]->io_service.post([this, command]()
+    {
+      runCreatureTask(command.creatureId,
+                      getCommandArea(command),
+                      std::bind(&GameEngine::executeCommand, this, command));
+    });
+    return;
+  }
+
+  if (playerCtrls_.count(creatureId) == 0)
+  {
+    LOG_DEBUG("%s: No player with creature id: %d, skipping command type: %d",
+              __func__, creatureId, command.type);
+    return;
+  }
+
+  executeCommand(command);
+}
+
+void GameEngine::executeCommand(const Command& command)
+{
+  auto creatureId = command.creatureId;
+  switch (command.type)
+  {
+    case Command::MOVE:
+    {
+      playerMoveInternal(creatureId, command.move.direction);
+      break;
+    }
+
+    case Command::MOVE_PATH:
+    {
+      playerMovePathInternal(creatureId, command.movePath.get());
+      break;
+    }
+
+    case Command::CANCEL_MOVE:
+    {
+      playerCancelMoveInternal(creatureId);
+      break;
+    }
+
+    case Command::TURN:
+    {
+      playerTurnInternal(creatureId, command.move.direction);
+      break;
+    }
+
+    case Command::SAY:
+    {
+      playerSayInternal(creatureId,
+                        command.say.type,
+                        command.say.message.get(),
+                        command.say.receiver.get(),
+                        command.say.channelId);
+      break;
+    }
+
+    case Command::MOVE_ITEM_POS_TO_POS:
+    {
+      const auto& data = command.moveItem;
+      playerMoveItemFromPosToPosInternal(creatureId, data.fromPosition.get(), data.fromStackPos,
+                                         data.itemId, data.count, data.toPosition.get());
+      break;
+    }
+
+    case Command::MOVE_ITEM_POS_TO_INV:
+    {
+      const auto& data = command.moveItem;
+      playerMoveItemFromPosToInvInternal(creatureId, data.fromPosition.get(), data.fromStackPos,
+                                         data.itemId, data.count, data.toInventoryId);
+      break;
+    }
+
+    case Command::MOVE_ITEM_INV_TO_POS:
+    {
+      const auto& data = command.moveItem;
+      playerMoveItemFromInvToPosInternal(creatureId, data.fromInventoryId, data.itemId, data.count,
+                                         data.toPosition.get());
+      break;
+    }
+
+    case Command::MOVE_ITEM_INV_TO_INV:
+    {
+      const auto& data = command.moveItem;
+      playerMoveItemFromInvToInvInternal(creatureId, data.fromInventoryId, data.itemId, data.count,
+                                         data.toInventoryId);
+      break;
+    }
+
+    case Command::USE_INV_ITEM:
+    {
+      playerUseInvItemInternal(creatureId, command.useItem.itemId, command.useItem.inventoryIndex);
+      break;
+    }
+
+    case Command::USE_POS_ITEM:
+    {
+      playerUsePosItemInternal(creatureId, command.useItem.itemId, command.useItem.position.get(),
+                               command.useItem.stackPos);
+      break;
+    }
+
+    case Command::LOOK_AT:
+    {
+      playerLookAtInternal(creatureId, command.lookAt.position.get(), command.lookAt.itemId);
+      break;
+    }
+
+    default:
+    {
+      LOG_ERROR("%s: Unknown command type: %d", __func__, command.type);
+      break;
+    }
+  }
+}
+
 void GameEngine::onTask(const TaskFunction& task)
 {
   switch (state_)
@@ -647,8 +953,274 @@ void GameEngine::onTask(const TaskFunction& task)
 
     default:
     {
-      LOG_ERROR("onTask(): Unknown state: %d", state_);
+      LOG_ERROR("onTask(): Unknown state: %d", state_.load());
       break;
     }
   }
 }
+
+void GameEngine::addCreatureTask(CreatureId creatureId,
+                                 const TaskFunction& task,
+                                 const boost::posix_time::ptime& expire)
+{
+  if (currentWorker_ == nullptr)
+  {
+    taskQueue_.addTask(task, expire, creatureId);
+    return;
+  }
+
+  // The regions around the creature must be locked again when the task is executed,
+  // and the task might be executed by another worker if the creature is handed off
+  currentWorker_->taskQueue.addTask([this, creatureId, task]()
+  {
+    runCreatureTask(creatureId, WorldRegions::Area(), task);
+  }, expire, creatureId);
+}
+
+void GameEngine::cancelCreatureTasks(CreatureId creatureId)
+{
+  if (currentWorker_ == nullptr)
+  {
+    taskQueue_.cancelTasks(creatureId);
+  }
+  else
+  {
+    currentWorker_->taskQueue.cancelTasks(creatureId);
+  }
+}
+
+GameEngine::Worker::Worker(int index, GameEngine* gameEngine)
+  : index(index),
+    work(new boost::asio::io_service::work(io_service)),
+    taskQueue(&io_service, std::bind(&GameEngine::onTask, gameEngine, std::placeholders::_1))
+{
+}
+
+void GameEngine::startWorkers()
+{
+  LOG_INFO("%s: Starting %d worker threads", __func__, workerThreads_);
+
+  worldRegions_.reset(new WorldRegions(world_->getWorldSizeStart(),
+                                       world_->getWorldSizeStart(),
+                                       world_->getWorldSizeX(),
+                                       world_->getWorldSizeY()));
+  world_->allocateAll();
+
+  for (auto i = 0; i < workerThreads_; i++)
+  {
+    workers_.emplace_back(new Worker(i, this));
+  }
+
+  for (auto& worker : workers_)
+  {
+    auto* workerPtr = worker.get();
+    worker->thread = std::thread([workerPtr]()
+    {
+      currentWorker_ = workerPtr;
+      workerPtr->io_service.run();
+    });
+  }
+}
+
+void GameEngine::stopWorkers()
+{
+  for (auto& worker : workers_)
+  {
+    worker->work.reset();
+    worker->io_service.stop();
+  }
+
+  for (auto& worker : workers_)
+  {
+    worker->thread.join();
+  }
+}
+
+int GameEngine::getWorkerIndex(const Position& position) const
+{
+  // Neighbouring regions are owned by different workers, so that players that are
+  // spread out over the map are spread out over the workers
+  return worldRegions_->getRegion(position) % workers_.size();
+}
+
+WorldRegions::Area GameEngine::getCommandArea(const Command& command)
+{
+  // The positions, other than the player's own, that the command accesses
+  WorldRegions::Area area;
+  switch (command.type)
+  {
+    case Command::MOVE_ITEM_POS_TO_POS:
+    {
+      area.add(command.moveItem.fromPosition.get());
+      area.add(command.moveItem.toPosition.get());
+      break;
+    }
+
+    case Command::MOVE_ITEM_POS_TO_INV:
+    {
+      area.add(command.moveItem.fromPosition.get());
+      break;
+    }
+
+    case Command::MOVE_ITEM_INV_TO_POS:
+    {
+      area.add(command.moveItem.toPosition.get());
+      break;
+    }
+
+    case Command::USE_POS_ITEM:
+    {
+      area.add(command.useItem.position.get());
+      break;
+    }
+
+    case Command::LOOK_AT:
+    {
+      area.add(command.lookAt.position.get());
+      break;
+    }
+
+    default:
+    {
+      break;
+    }
+  }
+  return area;
+}
+
+void GameEngine::runCreatureTask(CreatureId creatureId, WorldRegions::Area area, const TaskFunction& task)
+{
+  auto& worker = *currentWorker_;
+
+  auto it = worker.creatures.find(creatureId);
+  if (it == worker.creatures.end())
+  {
+    auto handedOffIt = worker.handedOff.find(creatureId);
+    if (handedOffIt != worker.handedOff.end())
+    {
+      // The creature has moved into a region owned by another worker, forward the task
+      workers_[handedOffIt->second]->io_service.post([this, creatureId, area, task]()
+      {
+        runCreatureTask(creatureId, area, task);
+      });
+    }
+    else
+    {
+      LOG_DEBUG("%s: Creature id: %d is not owned by worker: %d, skipping task",
+                __func__, creatureId, worker.index);
+    }
+    return;
+  }
+
+  // The command's positions come from the client, a command can only access positions
+  // within the creature's view, so don't let it lock regions all over the World
+  WorldRegions::Area creatureArea;
+  creatureArea.add(it->second);
+  creatureArea.expand(REGION_LOCK_MARGIN);
+  if (!creatureArea.contains(area))
+  {
+    LOG_DEBUG("%s: Creature id: %d task accesses positions out of range, skipping task",
+              __func__, creatureId);
+    return;
+  }
+
+  area.add(it->second);
+  area.expand(REGION_LOCK_MARGIN);
+  worldRegions_->getRegions(area, &worker.lockedRegions);
+  worldRegions_->lock(worker.lockedRegions);
+
+  task();
+
+  // Check if the task moved the creature into a region owned by another worker
+  auto toWorkerIndex = worker.index;
+  if (world_->creatureExists(creatureId))
+  {
+    const auto& position = world_->getCreaturePosition(creatureId);
+    worker.creatures[creatureId] = position;
+    toWorkerIndex = getWorkerIndex(position);
+  }
+
+  worldRegions_->unlock(worker.lockedRegions);
+
+  if (toWorkerIndex != worker.index)
+  {
+    handOffCreature(creatureId, toWorkerIndex);
+  }
+}
+
+void GameEngine::handOffCreature(CreatureId creatureId, int toWorkerIndex)
+{
+  auto& worker = *currentWorker_;
+
+  LOG_DEBUG("%s: Handing off creature id: %d from worker: %d to worker: %d",
+            __func__, creatureId, worker.index, toWorkerIndex);
+
+  auto position = worker.creatures.at(creatureId);
+  worker.creatures.erase(creatureId);
+  worker.handedOff[creatureId] = toWorkerIndex;
+
+  // The tasks are wrapped by addCreatureTask, so they can be executed by any worker
+  auto tasks = worker.taskQueue.removeTasks(creatureId);
+  workers_[toWorkerIndex]->io_service.post([this, creatureId, position, tasks]()
+  {
+    workerAddCreature(creatureId, position);
+    for (const auto& task : tasks)
+    {
+      currentWorker_->taskQueue.addTask(task.first, task.second, creatureId);
+    }
+  });
+
+  // Let the game thread send new commands directly to the new worker
+  io_service_->post([this, creatureId, toWorkerIndex]()
+  {
+    auto it = creatureWorkers_.find(creatureId);
+    if (it != creatureWorkers_.end())
+    {
+      it->second = toWorkerIndex;
+    }
+  });
+}
+
+void GameEngine::workerAddCreature(CreatureId creatureId, const Position& position)
+{
+  currentWorker_->creatures[creatureId] = position;
+  currentWorker_->handedOff.erase(creatureId);
+}
+
+void GameEngine::workerDespawnCreature(CreatureId creatureId)
+{
+  auto& worker = *currentWorker_;
+
+  if (worker.creatures.count(creatureId) == 0)
+  {
+    auto it = worker.handedOff.find(creatureId);
+    if (it != worker.handedOff.end())
+    {
+      workers_[it->second]->io_service.post(std::bind(&GameEngine::workerDespawnCreature, this, creatureId));
+    }
+    return;
+  }
+
+  worker.taskQueue.cancelTasks(creatureId);
+  worker.creatures.erase(creatureId);
+
+  worldRegions_->lockAll();
+  world_->removeCreature(creatureId);
+  players_.erase(creatureId);
+  playerCtrls_.erase(creatureId);
+  worldRegions_->unlockAll();
+
+  // Other workers might still have the creature in handedOff
+  for (auto& otherWorker : workers_)
+  {
+    if (otherWorker.get() != &worker)
+    {
+      otherWorker->io_service.post(std::bind(&GameEngine::workerForgetCreature, this, creatureId));
+    }
+  }
+}
+
+void GameEngine::workerForgetCreature(CreatureId creatureId)
+{
+  currentWorker_->handedOff.erase(creatureId);
+}
@@ -26,27 +26,61 @@
 #define WORLDSERVER_GAMEENGINE_H_
 
 #include <array>
+#include <atomic>
+#include <chrono>
 #include <deque>
 #include <functional>
 #include <memory>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include <boost/asio.hpp>  //NOLINT
+#include <boost/asio/steady_timer.hpp>  //NOLINT
 
 #include "world.h"
 #include "playerctrl.h"
 #include "taskqueue.h"
+#include "command.h"
+#include "mpscqueue.h"
+#include "worldregions.h"
 
 class OutgoingPacket;
 
 class GameEngine
 {
  public:
+  // If tickRate is 0 every command and task is executed as soon as possible
+  // Otherwise the GameEngine runs tickRate ticks per second, and each tick executes all
+  // commands and tasks that have been added since the last tick, in one handler
+  //
+  // If workerThreads is 0 the whole World is simulated by the game thread
+  // Otherwise the World is divided into regions (see WorldRegions) that are owned by
+  // workerThreads worker threads, each with its own TaskQueue. A player is owned by the
+  // worker that owns the region the player is in, and the game thread only forwards the
+  // player's commands to that worker. A task locks all regions within view range of the
+  // player (and of any position in the command) before it's executed, so that tasks on
+  // different workers can see and notify creatures across region borders.
+  // When a player moves into a region owned by another worker, the player and its pending
+  // tasks are handed off to that worker. Tasks that reach the old worker after that are
+  // forwarded to the new worker.
+  // Spawning and despawning locks all regions.
+  //
+  // If pagedWorld is true (and worldFilename is a compiled world file) the World's chunks
+  // are loaded when they are first accessed. Every CHUNK_EVICT_INTERVAL seconds, chunks
+  // that haven't been accessed for pagedIdleTimeout seconds are evicted, and then the least
+  // recently accessed chunks while the chunks use more than pagedMemoryBudget MiB.
   GameEngine(boost::asio::io_service* io_service,
              const std::string& loginMessage,
              const std::string& dataFilename,
              const std::string& itemsFilename,
-             const std::string& worldFilename);
+             const std::string& worldFilename,
+             int tickRate,
+             int workerThreads,
+             bool pagedWorld,
+             int pagedIdleTimeout,
+             int pagedMemoryBudget);
 
   // Not copyable
   GameEngine(const GameEngine&) = delete;
@@ -57,35 +91,29 @@ class GameEngine
   bool start();
   bool stop();
 
-  CreatureId playerSpawn(const std::string& name, const std::function<void(const OutgoingPacket&)>& sendPacket);
-  void playerDespawn(CreatureId creatureId);
-
-  void playerMove(CreatureId creatureId, Direction direction);
-  void playerMovePath(CreatureId creatureId, const std::deque<Direction>& path);
-  void playerCancelMove(CreatureId creatureId);
-  void playerTurn(CreatureId creatureId, Direction direction);
-
-  void playerSay(CreatureId creatureId, uint8_t type, const std::string& message,
-                 const std::string& receiver, uint16_t channelId);
-
-  void playerMoveItemFromPosToPos(CreatureId creatureId, const Position& fromPosition, int fromStackPos,
-                                  int itemId, int count, const Position& toPosition);
-  void playerMoveItemFromPosToInv(CreatureId creatureId, const Position& fromPosition, int fromStackPos,
-                                  int itemId, int count, int inventoryId);
-  void playerMoveItemFromInvToPos(CreatureId creatureId, int fromInventoryId, int itemId, int count, const Position& toPosition);
-  void playerMoveItemFromInvToInv(CreatureId creatureId, int fromInventoryId, int itemId, int count, int toInventoryId);
+  // The functions below can be called from any thread, they only hand over a task
+  // to the game thread (the thread running the io_service given to the constructor)
+  // Spawn and despawn are posted as tasks, all other player actions are added as
+  // Commands to a lock-free command queue which is drained by the game thread
 
-  void playerUseInvItem(CreatureId creatureId, int itemId, int inventoryIndex);
-  void playerUsePosItem(CreatureId creatureId, int itemId, const Position& position, int stackPos);
+  CreatureId playerSpawn(const std::string& name,
+                         const PlayerCtrl::SendPacket& sendPacket,
+                         const PlayerCtrl::SendSharedPacket& sendSharedPacket);
+  void playerDespawn(CreatureId creatureId);
 
-  void playerLookAt(CreatureId creatureId, const Position& position, ItemId itemId);
+  // Adds a player action to the command queue, the command is dropped if the queue is full
+  void addCommand(const Command& command);
 
  private:
-  void playerSpawnInternal(CreatureId creatureId);
+  void playerSpawnInternal(CreatureId creatureId,
+                           const std::string& name,
+                           const PlayerCtrl::SendPacket& sendPacket,
+                           const PlayerCtrl::SendSharedPacket& sendSharedPacket);
   void playerDespawnInternal(CreatureId creatureId);
 
   void playerMoveInternal(CreatureId creatureId, Direction direction);
   void playerMovePathInternal(CreatureId creatureId, const std::deque<Direction>& path);
+  void playerMovePathStepInternal(CreatureId creatureId);
   void playerCancelMoveInternal(CreatureId creatureId);
   void playerTurnInternal(CreatureId creatureId, Direction direction);
 
@@ -111,13 +139,82 @@ class GameEngine
   // Task stuff
   using TaskFunction = std::function<void(void)>;
 
+  // Tasks for a specific creature, use these instead of taskQueue_ directly
+  // as the creature's tasks are in its worker's TaskQueue if there are worker threads
+  void addCreatureTask(CreatureId creatureId,
+                       const TaskFunction& task,
+                       const boost::posix_time::ptime& expire);
+  void cancelCreatureTasks(CreatureId creatureId);
+
   template<class F, class... Args>
   void addTask(F&& f, Args&&... args)
   {
-    taskQueue_.addTask(std::bind(f, this, args...));
+    TaskFunction task = std::bind(f, this, args...);
+    io_service_->post([this, task]() { taskQueue_.addTask(task); });
   }
   void onTask(const TaskFunction& task);
 
+  // Command stuff
+  static const std::size_t COMMAND_QUEUE_SIZE = 4096;
+  static const std::size_t MAX_COMMANDS_PER_DRAIN = 1024;
+
+  void drainCommands();
+  void onCommand(const Command& command);
+  void executeCommand(const Command& command);
+
+  // Tick stuff
+  static const int TICK_STATS_INTERVAL = 60;  // Seconds
+
+  void startTickTimer();
+  void onTick(const boost::system::error_code& ec);
+
+  // Paging stuff
+  static const int CHUNK_EVICT_INTERVAL = 10;  // Seconds
+
+  void evictChunks();
+
+  // Worker stuff
+  // A creature task can reach this many Tiles outside of the creature's (or the command's)
+  // positions, i.e. the view range plus one step. Tasks for commands with positions
+  // further away than this from the creature are skipped
+  static const int REGION_LOCK_MARGIN = 10;
+
+  struct Worker
+  {
+    Worker(int index, GameEngine* gameEngine);
+
+    int index;
+    boost::asio::io_service io_service;
+    std::unique_ptr<boost::asio::io_service::work> work;
+    TaskQueue<TaskFunction> taskQueue;
+    std::thread thread;
+
+    // Creatures owned by this worker and their positions
+    // The position is only written by this worker, so it can be read without locking
+    std::unordered_map<CreatureId, Position> creatures;
+
+    // Creatures that have been handed off to another worker, so that tasks that still
+    // reach this worker can be forwarded
+    std::unordered_map<CreatureId, int> handedOff;
+
+    // Regions locked by the current task
+    WorldRegions::RegionList lockedRegions;
+  };
+
+  void startWorkers();
+  void stopWorkers();
+  int getWorkerIndex(const Position& position) const;
+  static WorldRegions::Area getCommandArea(const Command& command);
+
+  // These are executed on the worker threads
+  void runCreatureTask(CreatureId creatureId, WorldRegions::Area area, const TaskFunction& task);
+  void handOffCreature(CreatureId creatureId, int toWorkerIndex);
+  void workerAddCreature(CreatureId creatureId, const Position& position);
+  void workerDespawnCreature(CreatureId creatureId);
+  void workerForgetCreature(CreatureId creatureId);
+
+  boost::asio::io_service* io_service_;
+
   enum State
   {
     INITIALIZED,
@@ -125,10 +222,35 @@ class GameEngine
     CLOSING,
     CLOSED,
   };
-  State state_;
+  std::atomic<State> state_;
 
   TaskQueue<TaskFunction> taskQueue_;
 
+  MpscQueue<Command, COMMAND_QUEUE_SIZE> commandQueue_;
+  std::atomic<bool> drainPosted_;
+
+  int tickRate_;
+  std::chrono::steady_clock::duration tickInterval_;
+  std::chrono::steady_clock::time_point nextTickTime_;
+  boost::asio::steady_timer tickTimer_;
+
+  // Tick statistics, logged and reset every TICK_STATS_INTERVAL seconds
+  int tickCount_;
+  int tickOverruns_;
+  std::chrono::steady_clock::duration tickDurationTotal_;
+  std::chrono::steady_clock::duration tickDurationMax_;
+
+  std::chrono::seconds pagedIdleTimeout_;
+  std::size_t pagedMaxChunks_;
+
+  int workerThreads_;
+  std::unique_ptr<WorldRegions> worldRegions_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+  static thread_local Worker* currentWorker_;
+
+  // The worker that owns each player, only used by the game thread
+  std::unordered_map<CreatureId, int> creatureWorkers_;
+
   std::unordered_map<CreatureId, std::unique_ptr<Player>> players_;
   std::unordered_map<CreatureId, std::unique_ptr<PlayerCtrl>> playerCtrls_;
 
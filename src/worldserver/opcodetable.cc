@@ -0,0 +1,324 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "opcodetable.h"
+
+#include "logger.h"
+#include "incomingpacket.h"
+
+namespace
+{
+
+using Result = OpcodeTable::Result;
+
+void getPosition(IncomingPacket* packet, Command::RawPosition* position)
+{
+  position->x = packet->getU16();
+  position->y = packet->getU16();
+  position->z = packet->getU8();
+}
+
+bool isDirection(uint8_t value)
+{
+  return value <= WEST;
+}
+
+Result parseLogout(uint8_t opcode, IncomingPacket* packet, Command* command)
+{
+  return OpcodeTable::LOGOUT;
+}
+
+Result parseMovePath(uint8_t opcode, IncomingPacket* packet, Command* command)
+{
+  command->type = Command::MOVE_PATH;
+  auto& data = command->movePath;
+  data.length = packet->getU8();
+  for (auto i = 0; i < data.length; i++)
+  {
+    data.directions[i] = packet->getU8();
+    if (!isDirection(data.directions[i]))
+    {
+      return OpcodeTable::MALFORMED;
+    }
+  }
+  return OpcodeTable::COMMAND;
+}
+
+Result parseMove(uint8_t opcode, IncomingPacket* packet, Command* command)
+{
+  // 0x65 = North, 0x66 = East, 0x67 = South, 0x68 = West
+  command->type = Command::MOVE;
+  command->move.direction = static_cast<Direction>(opcode - 0x65);
+  return OpcodeTable::COMMAND;
+}
+
+Result parseTurn(uint8_t opcode, IncomingPacket* packet, Command* command)
+{
+  // 0x6F = North, 0x70 = East, 0x71 = South, 0x72 = West
+  command->type = Command::TURN;
+  command->move.direction = static_cast<Direction>(opcode - 0x6F);
+  return OpcodeTable::COMMAND;
+}
+
+Result parseMoveItem(uint8_t opcode, IncomingPacket* packet, Command* command)
+{
+  // There are four options here:
+  // Moving from inventory to inventory
+  // Moving from inventory to Tile
+  // Moving from Tile to inventory
+  // Moving from Tile to Tile
+  auto& data = command->moveItem;
+  bool fromInventory = packet->peekU16() == 0xFFFF;
+  if (fromInventory)
+  {
+    packet->getU16();
+    data.fromInventoryId = packet->getU8();
+    packet->getU16();  // Unknown
+    data.itemId = packet->getU16();
+    packet->getU8();  // Unknown
+  }
+  else
+  {
+    getPosition(packet, &data.fromPosition);
+    data.itemId = packet->getU16();
+    data.fromStackPos = packet->getU8();
+  }
+
+  bool toInventory = packet->peekU16() == 0xFFFF;
+  if (toInventory)
+  {
+    packet->getU16();
+    data.toInventoryId = packet->getU8();
+    packet->getU16();  // Unknown
+  }
+  else
+  {
+    getPosition(packet, &data.toPosition);
+  }
+  data.count = packet->getU8();  // Or subtype
+
+  if (fromInventory)
+  {
+    command->type = toInventory ? Command::MOVE_ITEM_INV_TO_INV : Command::MOVE_ITEM_INV_TO_POS;
+  }
+  else
+  {
+    command->type = toInventory ? Command::MOVE_ITEM_POS_TO_INV : Command::MOVE_ITEM_POS_TO_POS;
+  }
+  return OpcodeTable::COMMAND;
+}
+
+Result parseUseItem(uint8_t opcode, IncomingPacket* packet, Command* command)
+{
+  auto& data = command->useItem;
+  if (packet->peekU16() == 0xFFFF)
+  {
+    // Use Item in inventory
+    command->type = Command::USE_INV_ITEM;
+    packet->getU16();
+    data.inventoryIndex = packet->getU8();
+    packet->getU16();  // Unknown
+    data.itemId = packet->getU16();
+    packet->getU16();  // Unknown
+  }
+  else
+  {
+    // Use Item on Tile
+    command->type = Command::USE_POS_ITEM;
+    getPosition(packet, &data.position);
+    data.itemId = packet->getU16();
+    data.stackPos = packet->getU8();
+    packet->getU8();  // Unknown
+  }
+  return OpcodeTable::COMMAND;
+}
+
+Result parseLookAt(uint8_t opcode, IncomingPacket* packet, Command* command)
+{
+  // TODO(gurka): Look at inventory / container?
+  command->type = Command::LOOK_AT;
+  getPosition(packet, &command->lookAt.position);
+  command->lookAt.itemId = packet->getU16();
+  return OpcodeTable::COMMAND;
+}
+
+Result parseSay(uint8_t opcode, IncomingPacket* packet, Command* command)
+{
+  command->type = Command::SAY;
+  auto& data = command->say;
+  data.type = packet->getU8();
+  data.channelId = 0;
+  data.receiver.length = 0;
+
+  switch (data.type)
+  {
+    case 0x06:  // PRIVATE
+    case 0x0B:  // PRIVATE RED
+      data.receiver.length = packet->getString(data.receiver.data, Command::MAX_RECEIVER_LENGTH);
+      break;
+    case 0x07:  // CHANNEL_Y
+    case 0x0A:  // CHANNEL_R1
+      data.channelId = packet->getU16();
+      break;
+    default:
+      break;
+  }
+
+  data.message.length = packet->getString(data.message.data, Command::MAX_MESSAGE_LENGTH);
+  return OpcodeTable::COMMAND;
+}
+
+Result parseCancelMove(uint8_t opcode, IncomingPacket* packet, Command* command)
+{
+  command->type = Command::CANCEL_MOVE;
+  return OpcodeTable::COMMAND;
+}
+
+struct Entry
+{
+  uint8_t first;  // The opcodes first to last (inclusive) are parsed by parser
+  uint8_t last;
+  const char* name;
+  Result (*parser)(uint8_t opcode, IncomingPacket* packet, Command* command);
+};
+
+// Must be sorted by opcode
+constexpr Entry ENTRIES[] =
+{
+  { 0x14, 0x14, "logout",      &parseLogout     },
+  { 0x64, 0x64, "move path",   &parseMovePath   },
+  { 0x65, 0x68, "move",        &parseMove       },
+  { 0x6F, 0x72, "turn",        &parseTurn       },
+  { 0x78, 0x78, "move item",   &parseMoveItem   },
+  { 0x82, 0x82, "use item",    &parseUseItem    },
+  { 0x8C, 0x8C, "look at",     &parseLookAt     },
+  { 0x96, 0x96, "say",         &parseSay        },
+  { 0xBE, 0xBE, "cancel move", &parseCancelMove },
+};
+
+constexpr std::size_t NUMBER_OF_ENTRIES = sizeof(ENTRIES) / sizeof(ENTRIES[0]);
+constexpr uint8_t NO_ENTRY = 0xFF;
+
+constexpr bool isSorted(std::size_t i)
+{
+  return ENTRIES[i].first <= ENTRIES[i].last &&
+         (i + 1 == NUMBER_OF_ENTRIES || (ENTRIES[i].last < ENTRIES[i + 1].first && isSorted(i + 1)));
+}
+
+static_assert(isSorted(0), "ENTRIES must be sorted and opcode ranges must not overlap");
+static_assert(NUMBER_OF_ENTRIES < NO_ENTRY, "Too many entries for the index");
+
+constexpr uint8_t findEntry(std::size_t opcode, std::size_t i)
+{
+  return i == NUMBER_OF_ENTRIES ? NO_ENTRY :
+         (opcode >= ENTRIES[i].first && opcode <= ENTRIES[i].last) ? i : findEntry(opcode, i + 1);
+}
+
+// The index from opcode to entry, OpcodeIndex::entries[opcode] is generated
+// at compile time by expanding Opcodes to 0, 1, ..., 255
+template<std::size_t... Opcodes>
+struct Index
+{
+  static constexpr uint8_t entries[] = { findEntry(Opcodes, 0)... };
+};
+
+template<std::size_t... Opcodes>
+constexpr uint8_t Index<Opcodes...>::entries[];
+
+template<std::size_t N, std::size_t... Opcodes>
+struct MakeIndex : MakeIndex<N - 1, N - 1, Opcodes...>
+{
+};
+
+template<std::size_t... Opcodes>
+struct MakeIndex<0, Opcodes...> : Index<Opcodes...>
+{
+};
+
+using OpcodeIndex = MakeIndex<256>;
+
+const Entry* getEntry(uint8_t opcode)
+{
+  auto index = OpcodeIndex::entries[opcode];
+  return index == NO_ENTRY ? nullptr : &ENTRIES[index];
+}
+
+}  // namespace
+
+OpcodeTable::OpcodeTable()
+{
+  for (auto& received : received_)
+  {
+    received = 0;
+  }
+  for (auto& failed : failed_)
+  {
+    failed = 0;
+  }
+}
+
+OpcodeTable::Result OpcodeTable::parse(IncomingPacket* packet, Command* command)
+{
+  auto opcode = packet->getU8();
+  received_[opcode].fetch_add(1, std::memory_order_relaxed);
+
+  auto entry = getEntry(opcode);
+  if (!entry)
+  {
+    failed_[opcode].fetch_add(1, std::memory_order_relaxed);
+    return UNKNOWN_OPCODE;
+  }
+
+  auto result = entry->parser(opcode, packet, command);
+  if (result == MALFORMED || packet->isTruncated())
+  {
+    failed_[opcode].fetch_add(1, std::memory_order_relaxed);
+    return MALFORMED;
+  }
+  return result;
+}
+
+const char* OpcodeTable::getName(uint8_t opcode)
+{
+  auto entry = getEntry(opcode);
+  return entry ? entry->name : "unknown";
+}
+
+OpcodeTable::Stats OpcodeTable::getStats(uint8_t opcode) const
+{
+  return { received_[opcode].load(std::memory_order_relaxed), failed_[opcode].load(std::memory_order_relaxed) };
+}
+
+void OpcodeTable::logStats() const
+{
+  for (std::size_t opcode = 0; opcode < NUMBER_OF_OPCODES; opcode++)
+  {
+    auto stats = getStats(opcode);
+    if (stats.received > 0)
+    {
+      LOG_INFO("%s: Opcode: 0x%02X (%s), received: %lu, failed: %lu",
+               __func__, static_cast<int>(opcode), getName(opcode), stats.received, stats.failed);
+    }
+  }
+}
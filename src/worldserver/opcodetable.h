@@ -0,0 +1,80 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WORLDSERVER_OPCODETABLE_H_
+#define WORLDSERVER_OPCODETABLE_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+#include "command.h"
+
+class IncomingPacket;
+
+// Decodes the packets that a logged in client sends into Commands
+//
+// Each opcode (or range of opcodes) has a parser in a table that is built at compile
+// time, together with an index from opcode to parser. The parsers write directly into
+// the given Command, so that nothing is allocated while parsing.
+// The number of received and failed (malformed or unknown) packets are counted per
+// opcode. parse() can be called from several threads at the same time.
+class OpcodeTable
+{
+ public:
+  enum Result
+  {
+    COMMAND,         // The command has been filled in, except for creatureId
+    LOGOUT,          // The client logged out, there is no command
+    UNKNOWN_OPCODE,  // The rest of the packet can't be parsed
+    MALFORMED,       // The packet ended before the command, or contained invalid values
+  };
+
+  struct Stats
+  {
+    uint64_t received;
+    uint64_t failed;
+  };
+
+  OpcodeTable();
+
+  // Delete copy constructors
+  OpcodeTable(const OpcodeTable&) = delete;
+  OpcodeTable& operator=(const OpcodeTable&) = delete;
+
+  // Reads one opcode and its payload from packet
+  Result parse(IncomingPacket* packet, Command* command);
+
+  static const char* getName(uint8_t opcode);
+  Stats getStats(uint8_t opcode) const;
+  void logStats() const;
+
+ private:
+  static const std::size_t NUMBER_OF_OPCODES = 256;
+
+  std::array<std::atomic<uint64_t>, NUMBER_OF_OPCODES> received_;
+  std::array<std::atomic<uint64_t>, NUMBER_OF_OPCODES> failed_;
+};
+
+#endif  // WORLDSERVER_OPCODETABLE_H_
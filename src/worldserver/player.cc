@@ -166,7 +166,12 @@ bool Equipment::removeItem(const Item& item, uint8_t inventoryIndex)
 }
 
 Player::Player(const std::string& name)
-  : Creature(name),
+  : Player(Creature::getFreeCreatureId(), name)
+{
+}
+
+Player::Player(CreatureId creatureId, const std::string& name)
+  : Creature(creatureId, name),
     maxMana_(100),
     mana_(100),
     capacity_(300),
@@ -80,6 +80,7 @@ class Player : public Creature
 {
  public:
   explicit Player(const std::string& name);
+  Player(CreatureId creatureId, const std::string& name);
 
   // From Creature
   int getSpeed() const override;
@@ -27,12 +27,59 @@
 #include <algorithm>
 #include <deque>
 #include <list>
+#include <memory>
+#include <tuple>
 
 #include "logger.h"
 #include "position.h"
 #include "tile.h"
 #include "outgoingpacket.h"
 
+namespace
+{
+
+// Packets that are identical for all players that see an event are only built once,
+// by the first PlayerCtrl that is notified, and then shared by all of them.
+// World notifies the PlayerCtrls one after another, so it is enough to remember the
+// last packet of each kind together with the values that it was built from.
+enum SharedPacketKind
+{
+  CREATURE_DESPAWN,
+  CREATURE_MOVE,
+  CREATURE_MOVE_OUT,
+  CREATURE_TURN,
+  CREATURE_SAY,
+  ITEM_REMOVED,
+  ITEM_ADDED,
+};
+
+// A creature turn is superseded by the next one (or by a move), so it can be dropped
+// when a client can't keep up. Everything else, including speech, must be sent
+constexpr OutgoingPacket::Priority getPriority(SharedPacketKind kind)
+{
+  return kind == CREATURE_TURN ? OutgoingPacket::LOW : OutgoingPacket::NORMAL;
+}
+
+template<SharedPacketKind Kind, typename Build, typename... Keys>
+std::shared_ptr<const OutgoingPacket> getSharedPacket(const Build& build, const Keys&... keys)
+{
+  static thread_local std::tuple<Keys...> lastKeys;
+  static thread_local std::shared_ptr<const OutgoingPacket> lastPacket;
+
+  if (!lastPacket || lastKeys != std::tie(keys...))
+  {
+    auto packet = std::make_shared<OutgoingPacket>();
+    build(packet.get());
+    packet->setPriority(getPriority(Kind));
+    lastKeys = std::tie(keys...);
+    lastPacket = std::move(packet);
+  }
+
+  return lastPacket;
+}
+
+}  // namespace
+
 void PlayerCtrl::onCreatureSpawn(const Creature& creature, const Position& position)
 {
   OutgoingPacket packet;
@@ -46,23 +93,24 @@ void PlayerCtrl::onCreatureSpawn(const Creature& creature, const Position& posit
   addPosition(position, &packet);
   packet.addU8(0x0A);
 
-  sendPacket_(packet);
+  sendPacket_(std::move(packet));
 }
 
 void PlayerCtrl::onCreatureDespawn(const Creature& creature, const Position& position, uint8_t stackPos)
 {
-  OutgoingPacket packet;
-
-  // Logout poff
-  packet.addU8(0x83);
-  addPosition(position, &packet);
-  packet.addU8(0x02);
+  auto build = [&position, stackPos](OutgoingPacket* packet)
+  {
+    // Logout poff
+    packet->addU8(0x83);
+    addPosition(position, packet);
+    packet->addU8(0x02);
 
-  packet.addU8(0x6C);
-  addPosition(position, &packet);
-  packet.addU8(stackPos);
+    packet->addU8(0x6C);
+    addPosition(position, packet);
+    packet->addU8(stackPos);
+  };
 
-  sendPacket_(packet);
+  sendSharedPacket_(getSharedPacket<CREATURE_DESPAWN>(build, position, stackPos));
 }
 
 void PlayerCtrl::onCreatureMove(const Creature& creature,
@@ -93,34 +141,45 @@ void PlayerCtrl::onCreatureMove(const Creature& creature,
               __func__, creature.getCreatureId(), groundSpeed, creatureSpeed, duration);
   }
 
-  // Build outgoing packet
-  OutgoingPacket packet;
-
   bool canSeeOldPos = canSee(oldPosition);
   bool canSeeNewPos = canSee(newPosition);
 
   if (canSeeOldPos && canSeeNewPos)
   {
-    packet.addU8(0x6D);
-    addPosition(oldPosition, &packet);
-    packet.addU8(oldStackPos);
-    addPosition(newPosition, &packet);
+    auto build = [&oldPosition, oldStackPos, &newPosition](OutgoingPacket* packet)
+    {
+      packet->addU8(0x6D);
+      addPosition(oldPosition, packet);
+      packet->addU8(oldStackPos);
+      addPosition(newPosition, packet);
+    };
+    sendSharedPacket_(getSharedPacket<CREATURE_MOVE>(build, oldPosition, oldStackPos, newPosition));
   }
   else if (canSeeOldPos)
   {
-    packet.addU8(0x6C);
-    addPosition(oldPosition, &packet);
-    packet.addU8(oldStackPos);
+    auto build = [&oldPosition, oldStackPos](OutgoingPacket* packet)
+    {
+      packet->addU8(0x6C);
+      addPosition(oldPosition, packet);
+      packet->addU8(oldStackPos);
+    };
+    sendSharedPacket_(getSharedPacket<CREATURE_MOVE_OUT>(build, oldPosition, oldStackPos));
   }
   else if (canSeeNewPos)
   {
+    // The creature is either known or new to this player, so this can't be shared
+    OutgoingPacket packet;
     packet.addU8(0x6A);
     addPosition(newPosition, &packet);
     addCreature(creature, &packet);
+    sendPacket_(std::move(packet));
   }
 
   if (creature.getCreatureId() == creatureId_)
   {
+    // This player moved, send new map data
+    OutgoingPacket packet;
+
     // This player moved, send new map data
     if (oldPosition.getY() > newPosition.getY())
     {
@@ -155,63 +214,71 @@ void PlayerCtrl::onCreatureMove(const Creature& creature,
       packet.addU8(0x62);
       packet.addU8(0xFF);
     }
-  }
 
-  sendPacket_(packet);
+    sendPacket_(std::move(packet));
+  }
 }
 
 void PlayerCtrl::onCreatureTurn(const Creature& creature, const Position& position, uint8_t stackPos)
 {
-  OutgoingPacket packet;
-
-  packet.addU8(0x6B);
-  addPosition(position, &packet);
-  packet.addU8(stackPos);
-
-  packet.addU8(0x63);
-  packet.addU8(0x00);
-  packet.addU32(creature.getCreatureId());
-  packet.addU8(creature.getDirection());
+  auto build = [&creature, &position, stackPos](OutgoingPacket* packet)
+  {
+    packet->addU8(0x6B);
+    addPosition(position, packet);
+    packet->addU8(stackPos);
 
-  sendPacket_(packet);
+    packet->addU8(0x63);
+    packet->addU8(0x00);
+    packet->addU32(creature.getCreatureId());
+    packet->addU8(creature.getDirection());
+  };
+
+  sendSharedPacket_(getSharedPacket<CREATURE_TURN>(build,
+                                                   creature.getCreatureId(),
+                                                   creature.getDirection(),
+                                                   position,
+                                                   stackPos));
 }
 
 void PlayerCtrl::onCreatureSay(const Creature& creature, const Position& position, const std::string& message)
 {
-  OutgoingPacket packet;
-
-  packet.addU8(0xAA);
-  packet.addString(creature.getName());
-  packet.addU8(0x01);  // Say type
+  auto build = [&creature, &position, &message](OutgoingPacket* packet)
+  {
+    packet->addU8(0xAA);
+    packet->addString(creature.getName());
+    packet->addU8(0x01);  // Say type
 
-  // if type <= 3
-  addPosition(position, &packet);
+    // if type <= 3
+    addPosition(position, packet);
 
-  packet.addString(message);
+    packet->addString(message);
+  };
 
-  sendPacket_(packet);
+  sendSharedPacket_(getSharedPacket<CREATURE_SAY>(build, creature.getCreatureId(), position, message));
 }
 
 void PlayerCtrl::onItemRemoved(const Position& position, uint8_t stackPos)
 {
-  OutgoingPacket packet;
-
-  packet.addU8(0x6C);
-  addPosition(position, &packet);
-  packet.addU8(stackPos);
+  auto build = [&position, stackPos](OutgoingPacket* packet)
+  {
+    packet->addU8(0x6C);
+    addPosition(position, packet);
+    packet->addU8(stackPos);
+  };
 
-  sendPacket_(packet);
+  sendSharedPacket_(getSharedPacket<ITEM_REMOVED>(build, position, stackPos));
 }
 
 void PlayerCtrl::onItemAdded(const Item& item, const Position& position)
 {
-  OutgoingPacket packet;
-
-  packet.addU8(0x6A);
-  addPosition(position, &packet);
-  addItem(item, &packet);
+  auto build = [&item, &position](OutgoingPacket* packet)
+  {
+    packet->addU8(0x6A);
+    addPosition(position, packet);
+    addItem(item, packet);
+  };
 
-  sendPacket_(packet);
+  sendSharedPacket_(getSharedPacket<ITEM_ADDED>(build, item.getItemId(), item.getCount(), position));
 }
 
 void PlayerCtrl::onTileUpdate(const Position& position)
@@ -224,7 +291,7 @@ void PlayerCtrl::onTileUpdate(const Position& position)
   packet.addU8(0x00);
   packet.addU8(0xFF);
 
-  sendPacket_(packet);
+  sendPacket_(std::move(packet));
 }
 
 void PlayerCtrl::onPlayerSpawn(const Player& player, const Position& position, const std::string& loginMessage)
@@ -289,7 +356,7 @@ void PlayerCtrl::onPlayerSpawn(const Player& player, const Position& position, c
   packet.addU8(0x11);  // Message type
   packet.addString(loginMessage);  // Message text
 
-  sendPacket_(packet);
+  sendPacket_(std::move(packet));
 }
 
 void PlayerCtrl::onEquipmentUpdated(const Player& player, int inventoryIndex)
@@ -298,7 +365,7 @@ void PlayerCtrl::onEquipmentUpdated(const Player& player, int inventoryIndex)
 
   addEquipment(player, inventoryIndex, &packet);
 
-  sendPacket_(packet);
+  sendPacket_(std::move(packet));
 }
 
 void PlayerCtrl::onUseItem(const Item& item)
@@ -320,7 +387,7 @@ void PlayerCtrl::onUseItem(const Item& item)
 
   packet.addU8(0x00);  // Number of items
 
-  sendPacket_(packet);
+  sendPacket_(std::move(packet));
 }
 
 void PlayerCtrl::sendTextMessage(const std::string& message)
@@ -331,7 +398,7 @@ void PlayerCtrl::sendTextMessage(const std::string& message)
   packet.addU8(0x13);
   packet.addString(message);
 
-  sendPacket_(packet);
+  sendPacket_(std::move(packet));
 }
 
 void PlayerCtrl::sendCancel(const std::string& message)
@@ -342,7 +409,7 @@ void PlayerCtrl::sendCancel(const std::string& message)
   packet.addU8(0x14);
   packet.addString(message);
 
-  sendPacket_(packet);
+  sendPacket_(std::move(packet));
 }
 
 void PlayerCtrl::queueMoves(const std::deque<Direction>& moves)
@@ -372,7 +439,7 @@ bool PlayerCtrl::canSee(const Position& position) const
          position.getY() <= playerPosition.getY() + 7;
 }
 
-void PlayerCtrl::addPosition(const Position& position, OutgoingPacket* packet) const
+void PlayerCtrl::addPosition(const Position& position, OutgoingPacket* packet)
 {
   packet->addU16(position.getX());
   packet->addU16(position.getY());
@@ -489,7 +556,7 @@ void PlayerCtrl::addCreature(const Creature& creature, OutgoingPacket* packet)
   packet->addU16(creature.getSpeed());
 }
 
-void PlayerCtrl::addItem(const Item& item, OutgoingPacket* packet) const
+void PlayerCtrl::addItem(const Item& item, OutgoingPacket* packet)
 {
   packet->addU16(item.getItemId());
   if (item.isStackable())
@@ -27,6 +27,7 @@
 
 #include <deque>
 #include <functional>
+#include <memory>
 #include <string>
 #include <unordered_set>
 
@@ -44,12 +45,17 @@ class OutgoingPacket;
 class PlayerCtrl : public CreatureCtrl
 {
  public:
+  using SendPacket = std::function<void(OutgoingPacket&&)>;
+  using SendSharedPacket = std::function<void(const std::shared_ptr<const OutgoingPacket>&)>;
+
   PlayerCtrl(WorldInterface* worldInterface,
              CreatureId creatureId,
-             std::function<void(const OutgoingPacket&)> sendPacket)
+             const SendPacket& sendPacket,
+             const SendSharedPacket& sendSharedPacket)
     : worldInterface_(worldInterface),
       creatureId_(creatureId),
       sendPacket_(sendPacket),
+      sendSharedPacket_(sendSharedPacket),
       nextWalkTime_(boost::posix_time::microsec_clock::local_time())
   {
   }
@@ -89,15 +95,16 @@ class PlayerCtrl : public CreatureCtrl
   bool canSee(const Position& position) const;
 
   // Packet functions
-  void addPosition(const Position& position, OutgoingPacket* packet) const;
+  static void addPosition(const Position& position, OutgoingPacket* packet);
   void addMapData(const Position& position, int width, int height, OutgoingPacket* packet);
   void addCreature(const Creature& creature, OutgoingPacket* packet);
-  void addItem(const Item& item, OutgoingPacket* packet) const;
+  static void addItem(const Item& item, OutgoingPacket* packet);
   void addEquipment(const Player& player, int inventoryIndex, OutgoingPacket* packet) const;
 
   WorldInterface* worldInterface_;
   CreatureId creatureId_;
-  std::function<void(const OutgoingPacket&)> sendPacket_;
+  SendPacket sendPacket_;
+  SendSharedPacket sendSharedPacket_;
 
   std::unordered_set<CreatureId> knownCreatures_;
 
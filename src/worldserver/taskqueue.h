@@ -25,75 +25,492 @@
 #ifndef WORLDSERVER_TASKQUEUE_H_
 #define WORLDSERVER_TASKQUEUE_H_
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
 #include <functional>
-#include <deque>
-#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <boost/asio.hpp>  //NOLINT
+#include <boost/asio/basic_waitable_timer.hpp>  //NOLINT
 #include <boost/date_time/posix_time/posix_time.hpp>  //NOLINT
 
-template <class Task>
+// Task scheduler based on a hierarchical timing wheel
+//
+// Time is measured in ticks of 1 ms since the TaskQueue was created. There are
+// LEVELS wheels of SLOTS slots each, a task is placed in the lowest wheel that can
+// hold its expire tick, and tasks in higher wheels are cascaded down to lower wheels
+// when the lower wheel wraps around. All tasks in a slot are kept in an intrusive
+// doubly linked list, so both adding and cancelling a task is O(1).
+//
+// Tasks that are due (and tasks added without an expire time) are moved to a ready
+// list which is executed in order. The timer is armed at most once per tick, and
+// only while there are tasks in the wheels.
+//
+// If useTimer is false the TaskQueue does not use its timer or post any handlers, the
+// owner must instead call runTasks() periodically (e.g. once per game tick).
+//
+// A task can be added to a group (e.g. a CreatureId), and all pending tasks in a group
+// can be cancelled at once. The tasks in each group are kept in a second intrusive list.
+//
+// Clock is only replaced in unit tests, to control time.
+template <class Task, class Clock = std::chrono::steady_clock>
 class TaskQueue
 {
+ public:
+  // A TaskId identifies a task that has been added, and can be used to cancel it
+  // The same TaskId will not be reused for a long time, even after the task has
+  // been executed or cancelled (the generation is increased each time a node is reused)
+  using TaskId = uint64_t;
+  static constexpr TaskId INVALID_TASK_ID = 0;
+
+  using GroupId = int64_t;
+  static constexpr GroupId NO_GROUP = -1;
+
+  TaskQueue(boost::asio::io_service* io_service,
+            const std::function<void(const Task&)>& onTask,
+            bool useTimer = true)
+    : io_service_(io_service),
+      onTask_(onTask),
+      useTimer_(useTimer),
+      timer_(*io_service),
+      timerArmed_(false),
+      armedTick_(0),
+      readyPosted_(false),
+      readySize_(0),
+      startTime_(Clock::now()),
+      currentTick_(0),
+      wheelSize_(0),
+      freeNodes_(NONE)
+  {
+    for (auto& head : heads_)
+    {
+      head = NONE;
+    }
+  }
+
+  // Delete copy constructors
+  TaskQueue(const TaskQueue&) = delete;
+  TaskQueue& operator=(const TaskQueue&) = delete;
+
+  // Adds a task that is executed as soon as possible
+  TaskId addTask(const Task& task, GroupId group = NO_GROUP)
+  {
+    auto index = allocateNode(task, currentTick_, group);
+    linkNode(index, READY_LIST);
+    postReady();
+    return makeTaskId(index);
+  }
+
+  // Adds a task that is executed after (at least) the given delay
+  TaskId addTask(const Task& task, std::chrono::milliseconds delay, GroupId group = NO_GROUP)
+  {
+    if (delay.count() <= 0)
+    {
+      return addTask(task, group);
+    }
+
+    auto nowTick = getTick(Clock::now());
+    if (wheelSize_ == 0)
+    {
+      // Nothing in the wheels, so there is no need to step through the ticks since last timeout
+      currentTick_ = nowTick;
+    }
+
+    auto expireTick = nowTick + static_cast<uint64_t>(delay.count());
+    auto index = allocateNode(task, expireTick, group);
+    insertNode(index);
+
+    if (useTimer_ && (!timerArmed_ || expireTick < armedTick_))
+    {
+      armTimer(expireTick);
+    }
+
+    return makeTaskId(index);
+  }
+
+  // Adds a task that is executed at (or after) the given time
+  TaskId addTask(const Task& task, const boost::posix_time::ptime& expire, GroupId group = NO_GROUP)
+  {
+    auto now = boost::posix_time::microsec_clock::local_time();
+    return addTask(task, std::chrono::milliseconds((expire - now).total_milliseconds()), group);
+  }
+
+  // Cancels the task, returns false if the task has already been executed or cancelled
+  bool cancelTask(TaskId taskId)
+  {
+    auto index = static_cast<uint32_t>(taskId);
+    auto generation = static_cast<uint32_t>(taskId >> 32);
+    if (index >= nodes_.size() ||
+        nodes_[index].generation != generation ||
+        nodes_[index].list == NONE)
+    {
+      return false;
+    }
+
+    removeNode(index);
+    return true;
+  }
+
+  // Executes all tasks that are due, for use when useTimer is false
+  // Tasks added by the executed tasks are not executed until the next call
+  void runTasks()
+  {
+    advance(getTick(Clock::now()));
+    runReady(readySize_);
+  }
+
+  // Cancels all pending tasks in the group, returns the number of cancelled tasks
+  std::size_t cancelTasks(GroupId group)
+  {
+    auto it = groups_.find(group);
+    if (it == groups_.end())
+    {
+      return 0;
+    }
+
+    // removeNode erases the group when its last node is removed
+    std::size_t count = 0;
+    auto index = it->second;
+    while (index != NONE)
+    {
+      auto next = nodes_[index].groupNext;
+      removeNode(index);
+      index = next;
+      count++;
+    }
+    return count;
+  }
+
+  // Removes all pending tasks in the group and returns them, in the order they were added,
+  // together with the time left until each task is due (so they can be added to another TaskQueue)
+  std::vector<std::pair<Task, std::chrono::milliseconds>> removeTasks(GroupId group)
+  {
+    std::vector<std::pair<Task, std::chrono::milliseconds>> tasks;
+    auto it = groups_.find(group);
+    if (it == groups_.end())
+    {
+      return tasks;
+    }
+
+    auto nowTick = getTick(Clock::now());
+    auto index = it->second;
+    while (index != NONE)
+    {
+      auto next = nodes_[index].groupNext;
+      auto expireTick = nodes_[index].expireTick;
+      auto delay = expireTick > nowTick ? expireTick - nowTick : 0;
+      tasks.emplace_back(std::move(nodes_[index].task), std::chrono::milliseconds(delay));
+      removeNode(index);
+      index = next;
+    }
+
+    // The group list has the most recently added task first
+    std::reverse(tasks.begin(), tasks.end());
+    return tasks;
+  }
+
  private:
-  struct TaskWrapper
+  static const int LEVELS = 4;
+  static const int SLOT_BITS = 8;
+  static const int SLOTS = 1 << SLOT_BITS;
+  static const uint64_t SLOT_MASK = SLOTS - 1;
+
+  // List index of the ready list, the wheel slots use [0, LEVELS * SLOTS)
+  static const uint32_t READY_LIST = LEVELS * SLOTS;
+  static const uint32_t NONE = UINT32_MAX;
+
+  // Maximum number of ready tasks to execute before letting other handlers run
+  static const std::size_t MAX_TASKS_PER_RUN = 1024;
+
+  struct Node
   {
     Task task;
-    boost::posix_time::ptime expire;
+    uint64_t expireTick;
+    uint32_t generation;
+    uint32_t list;  // The list this node is linked in, or NONE if free
+    uint32_t prev;
+    uint32_t next;
+    GroupId group;
+    uint32_t groupPrev;
+    uint32_t groupNext;
+  };
+
+  uint64_t getTick(typename Clock::time_point timePoint) const
+  {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(timePoint - startTime_).count();
+  }
 
-    bool operator>(const TaskWrapper& other) const
+  TaskId makeTaskId(uint32_t index) const
+  {
+    return (static_cast<TaskId>(nodes_[index].generation) << 32) | index;
+  }
+
+  uint32_t allocateNode(const Task& task, uint64_t expireTick, GroupId group)
+  {
+    uint32_t index;
+    if (freeNodes_ != NONE)
     {
-      return this->expire > other.expire;
+      index = freeNodes_;
+      freeNodes_ = nodes_[index].next;
+    }
+    else
+    {
+      index = nodes_.size();
+      nodes_.push_back(Node{Task(), 0, 1, NONE, NONE, NONE, NO_GROUP, NONE, NONE});
     }
-  };
 
- public:
-  TaskQueue(boost::asio::io_service* io_service,
-            const std::function<void(const Task&)>& onTask)
-    : onTask_(onTask),
-      timer_(*io_service),
-      timerStarted_(false)
+    auto& node = nodes_[index];
+    node.task = task;
+    node.expireTick = expireTick;
+    node.group = group;
+    node.groupPrev = NONE;
+    node.groupNext = NONE;
+
+    if (group != NO_GROUP)
+    {
+      // Add the node to the front of the group's list
+      auto it = groups_.find(group);
+      if (it == groups_.end())
+      {
+        groups_.emplace(group, index);
+      }
+      else
+      {
+        node.groupNext = it->second;
+        nodes_[it->second].groupPrev = index;
+        it->second = index;
+      }
+    }
+
+    return index;
+  }
+
+  // Unlinks the node from its list and frees it
+  void removeNode(uint32_t index)
   {
+    if (nodes_[index].list != READY_LIST)
+    {
+      wheelSize_--;
+    }
+    unlinkNode(index);
+    freeNode(index);
   }
-  TaskQueue(const TaskQueue&) = delete;
-  TaskQueue& operator=(const TaskQueue&) = delete;
 
-  void addTask(const Task& task)
+  void freeNode(uint32_t index)
   {
-    addTask(task, boost::posix_time::ptime(boost::posix_time::microsec_clock::local_time()));
+    auto& node = nodes_[index];
+    if (node.group != NO_GROUP)
+    {
+      if (node.groupPrev != NONE)
+      {
+        nodes_[node.groupPrev].groupNext = node.groupNext;
+      }
+      else if (node.groupNext != NONE)
+      {
+        groups_[node.group] = node.groupNext;
+      }
+      else
+      {
+        groups_.erase(node.group);
+      }
+
+      if (node.groupNext != NONE)
+      {
+        nodes_[node.groupNext].groupPrev = node.groupPrev;
+      }
+      node.group = NO_GROUP;
+    }
+
+    node.task = Task();  // Release anything captured by the task
+    node.list = NONE;
+    node.prev = NONE;
+    node.generation++;
+    if (node.generation == 0)
+    {
+      // Generation 0 would make TaskId 0 valid, skip it
+      node.generation = 1;
+    }
+    node.next = freeNodes_;
+    freeNodes_ = index;
   }
 
-  void addTask(const Task& task, const boost::posix_time::ptime& expire)
+  void linkNode(uint32_t index, uint32_t list)
   {
-    TaskWrapper taskWrapper { task, expire };
-    queue_.push(taskWrapper);
-    if (timerStarted_)
+    // Nodes are added to the back of the list to keep the order in which tasks were added
+    auto& node = nodes_[index];
+    node.list = list;
+    node.next = NONE;
+    if (list == READY_LIST)
     {
-      // onTimeout will handle restart of timer
-      timer_.cancel();
+      readySize_++;
+    }
+    if (heads_[list] == NONE)
+    {
+      node.prev = NONE;
+      heads_[list] = index;
+      tails_[list] = index;
     }
     else
     {
-      startTimer();
+      node.prev = tails_[list];
+      nodes_[tails_[list]].next = index;
+      tails_[list] = index;
     }
   }
 
- private:
-  void startTimer()
+  void unlinkNode(uint32_t index)
+  {
+    auto& node = nodes_[index];
+    if (node.prev != NONE)
+    {
+      nodes_[node.prev].next = node.next;
+    }
+    else
+    {
+      heads_[node.list] = node.next;
+    }
+
+    if (node.next != NONE)
+    {
+      nodes_[node.next].prev = node.prev;
+    }
+    else
+    {
+      tails_[node.list] = node.prev;
+    }
+
+    if (node.list == READY_LIST)
+    {
+      readySize_--;
+    }
+
+    node.list = NONE;
+  }
+
+  // Links the node into the wheel slot (or ready list) that matches its expire tick
+  void insertNode(uint32_t index)
+  {
+    auto expireTick = nodes_[index].expireTick;
+    if (expireTick <= currentTick_)
+    {
+      linkNode(index, READY_LIST);
+      return;
+    }
+
+    // The level is given by the highest group of SLOT_BITS bits in which the expire
+    // tick differs from the current tick
+    int level = 0;
+    while (level < LEVELS - 1 &&
+           (expireTick >> ((level + 1) * SLOT_BITS)) != (currentTick_ >> ((level + 1) * SLOT_BITS)))
+    {
+      level++;
+    }
+
+    uint64_t slot;
+    if ((expireTick >> (LEVELS * SLOT_BITS)) != (currentTick_ >> (LEVELS * SLOT_BITS)))
+    {
+      // Too far away for the wheels, put it in the first slot of the top level
+      // That slot is not used otherwise, and it is cascaded (and the node inserted
+      // again) when the top level wraps around
+      slot = 0;
+    }
+    else
+    {
+      slot = (expireTick >> (level * SLOT_BITS)) & SLOT_MASK;
+    }
+
+    linkNode(index, level * SLOTS + slot);
+    wheelSize_++;
+  }
+
+  // Moves all nodes in the list to where they belong given the current tick
+  void cascade(uint32_t list)
+  {
+    auto index = heads_[list];
+    heads_[list] = NONE;
+    tails_[list] = NONE;
+    while (index != NONE)
+    {
+      auto next = nodes_[index].next;
+      wheelSize_--;
+      insertNode(index);
+      index = next;
+    }
+  }
+
+  // Advances the wheels up to (and including) the given tick
+  void advance(uint64_t tick)
+  {
+    if (wheelSize_ == 0)
+    {
+      currentTick_ = tick > currentTick_ ? tick : currentTick_;
+      return;
+    }
+
+    while (currentTick_ < tick)
+    {
+      currentTick_++;
+
+      if ((currentTick_ & SLOT_MASK) == 0)
+      {
+        // Level 0 wrapped around, cascade the next slot of each higher level
+        // until we reach a level that did not wrap around
+        for (int level = 1; level < LEVELS; level++)
+        {
+          auto slot = (currentTick_ >> (level * SLOT_BITS)) & SLOT_MASK;
+          cascade(level * SLOTS + slot);
+          if (slot != 0)
+          {
+            break;
+          }
+        }
+      }
+
+      // All nodes in the current level 0 slot are due
+      cascade(currentTick_ & SLOT_MASK);
+
+      if (wheelSize_ == 0)
+      {
+        currentTick_ = tick;
+        break;
+      }
+    }
+  }
+
+  void armTimer(uint64_t tick)
   {
-    boost::posix_time::ptime now(boost::posix_time::microsec_clock::local_time());
-    boost::posix_time::ptime taskExpire(queue_.top().expire);
-    timer_.expires_from_now(taskExpire - now);
+    armedTick_ = tick;
+    timerArmed_ = true;
+    timer_.expires_at(startTime_ + std::chrono::milliseconds(tick));
     timer_.async_wait(std::bind(&TaskQueue::onTimeout, this, std::placeholders::_1));
-    timerStarted_ = true;
+  }
+
+  // Arms the timer for the next tick at which something needs to be done, which is
+  // either the next non-empty level 0 slot or the next cascade
+  void armNextTimer()
+  {
+    if (wheelSize_ == 0)
+    {
+      return;
+    }
+
+    auto tick = currentTick_ + 1;
+    while ((tick & SLOT_MASK) != 0 && heads_[tick & SLOT_MASK] == NONE)
+    {
+      tick++;
+    }
+    armTimer(tick);
   }
 
   void onTimeout(const boost::system::error_code& ec)
   {
     if (ec == boost::asio::error::operation_aborted)
     {
-      // Canceled by addTask
-      startTimer();
+      // Timer was re-armed by addTask
       return;
     }
     else if (ec)
@@ -101,35 +518,73 @@ class TaskQueue
       abort();
     }
 
-    boost::posix_time::ptime now(boost::posix_time::microsec_clock::local_time());
-    while (!queue_.empty())
+    timerArmed_ = false;
+    advance(getTick(Clock::now()));
+    runReady(MAX_TASKS_PER_RUN);
+    armNextTimer();
+  }
+
+  void postReady()
+  {
+    if (useTimer_ && !readyPosted_)
     {
-      TaskWrapper taskWrapper = queue_.top();
-      if (taskWrapper.expire > now)
+      readyPosted_ = true;
+      io_service_->post([this]()
       {
-        break;
-      }
-      queue_.pop();
-      onTask_(taskWrapper.task);
+        readyPosted_ = false;
+        runReady(MAX_TASKS_PER_RUN);
+      });
     }
+  }
 
-    if (!queue_.empty())
+  void runReady(std::size_t maxTasks)
+  {
+    // Only execute the tasks that are ready now, tasks that are added while executing
+    // (e.g. a task that adds itself again) are executed next time
+    auto count = readySize_ < maxTasks ? readySize_ : maxTasks;
+    for (std::size_t i = 0; i < count && heads_[READY_LIST] != NONE; i++)
     {
-      startTimer();
+      auto index = heads_[READY_LIST];
+      unlinkNode(index);
+
+      // Free the node before executing the task, so that the task can add new tasks
+      // (possibly reusing the node) and so that cancelling the task returns false
+      auto task = std::move(nodes_[index].task);
+      freeNode(index);
+      onTask_(task);
     }
-    else
+
+    if (heads_[READY_LIST] != NONE)
     {
-      timerStarted_ = false;
+      postReady();
     }
   }
 
+  boost::asio::io_service* io_service_;
   std::function<void(const Task&)> onTask_;
+  bool useTimer_;
+
+  boost::asio::basic_waitable_timer<Clock> timer_;
+  bool timerArmed_;
+  uint64_t armedTick_;
+  bool readyPosted_;
+  std::size_t readySize_;  // Number of nodes in the ready list
 
-  // We use std::greater to get reverse priority queue (Task with lowest time first)
-  std::priority_queue<TaskWrapper, std::deque<TaskWrapper>, std::greater<TaskWrapper>> queue_;
+  typename Clock::time_point startTime_;
+  uint64_t currentTick_;
+  std::size_t wheelSize_;  // Number of nodes in the wheels (i.e. not in the ready list)
 
-  boost::asio::deadline_timer timer_;
-  bool timerStarted_;
+  std::vector<Node> nodes_;
+  uint32_t freeNodes_;
+  std::unordered_map<GroupId, uint32_t> groups_;  // First node in each group
+  std::array<uint32_t, LEVELS * SLOTS + 1> heads_;
+  std::array<uint32_t, LEVELS * SLOTS + 1> tails_;
 };
 
+template <class Task, class Clock>
+constexpr typename TaskQueue<Task, Clock>::TaskId TaskQueue<Task, Clock>::INVALID_TASK_ID;
+
+template <class Task, class Clock>
+constexpr typename TaskQueue<Task, Clock>::GroupId TaskQueue<Task, Clock>::NO_GROUP;
+
 #endif  // WORLDSERVER_TASKQUEUE_H_
@@ -0,0 +1,146 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "worldregions.h"
+
+#include <algorithm>
+#include <climits>
+
+WorldRegions::Area::Area()
+  : minX(INT_MAX),
+    minY(INT_MAX),
+    maxX(INT_MIN),
+    maxY(INT_MIN)
+{
+}
+
+void WorldRegions::Area::add(const Position& position)
+{
+  int x = position.getX();
+  int y = position.getY();
+  minX = std::min(minX, x);
+  minY = std::min(minY, y);
+  maxX = std::max(maxX, x);
+  maxY = std::max(maxY, y);
+}
+
+void WorldRegions::Area::expand(int margin)
+{
+  if (isEmpty())
+  {
+    return;
+  }
+
+  minX -= margin;
+  minY -= margin;
+  maxX += margin;
+  maxY += margin;
+}
+
+bool WorldRegions::Area::contains(const Area& other) const
+{
+  if (other.isEmpty())
+  {
+    return true;
+  }
+
+  return other.minX >= minX && other.maxX <= maxX &&
+         other.minY >= minY && other.maxY <= maxY;
+}
+
+WorldRegions::WorldRegions(int startX, int startY, int sizeX, int sizeY)
+  : startX_(startX),
+    startY_(startY),
+    regionsX_((sizeX + REGION_SIZE - 1) / REGION_SIZE),
+    regionsY_((sizeY + REGION_SIZE - 1) / REGION_SIZE),
+    mutexes_(new std::mutex[regionsX_ * regionsY_])
+{
+}
+
+int WorldRegions::getRegion(const Position& position) const
+{
+  return getRegionY(position.getY()) * regionsX_ + getRegionX(position.getX());
+}
+
+void WorldRegions::getRegions(const Area& area, RegionList* regions) const
+{
+  regions->clear();
+  if (area.isEmpty())
+  {
+    return;
+  }
+
+  // Row by row gives the regions in index order
+  for (auto regionY = getRegionY(area.minY); regionY <= getRegionY(area.maxY); regionY++)
+  {
+    for (auto regionX = getRegionX(area.minX); regionX <= getRegionX(area.maxX); regionX++)
+    {
+      regions->push_back(regionY * regionsX_ + regionX);
+    }
+  }
+}
+
+void WorldRegions::lock(const RegionList& regions)
+{
+  for (auto region : regions)
+  {
+    mutexes_[region].lock();
+  }
+}
+
+void WorldRegions::unlock(const RegionList& regions)
+{
+  for (auto it = regions.rbegin(); it != regions.rend(); ++it)
+  {
+    mutexes_[*it].unlock();
+  }
+}
+
+void WorldRegions::lockAll()
+{
+  for (auto region = 0; region < getNumberOfRegions(); region++)
+  {
+    mutexes_[region].lock();
+  }
+}
+
+void WorldRegions::unlockAll()
+{
+  for (auto region = getNumberOfRegions() - 1; region >= 0; region--)
+  {
+    mutexes_[region].unlock();
+  }
+}
+
+int WorldRegions::getRegionX(int x) const
+{
+  auto regionX = x < startX_ ? 0 : (x - startX_) / REGION_SIZE;
+  return std::min(regionX, regionsX_ - 1);
+}
+
+int WorldRegions::getRegionY(int y) const
+{
+  auto regionY = y < startY_ ? 0 : (y - startY_) / REGION_SIZE;
+  return std::min(regionY, regionsY_ - 1);
+}
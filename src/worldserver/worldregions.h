@@ -0,0 +1,103 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WORLDSERVER_WORLDREGIONS_H_
+#define WORLDSERVER_WORLDREGIONS_H_
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "position.h"
+
+// Divides the World into regions of REGION_SIZE x REGION_SIZE Tiles (all floors) and
+// keeps a mutex for each region
+// A thread that wants to access an area of the World locks all regions that overlap the
+// area. Regions are always locked in index order, so two threads can never deadlock.
+// REGION_SIZE is a multiple of CreatureIndex::SECTOR_SIZE and of TileGrid::CHUNK_SIZE, so
+// that a sector of the CreatureIndex or a (lazily loaded) chunk of Tiles never spans two
+// regions
+class WorldRegions
+{
+ public:
+  static const int REGION_SIZE = 64;
+
+  // An area of the World, inclusive
+  struct Area
+  {
+    Area();
+
+    bool isEmpty() const { return minX > maxX || minY > maxY; }
+
+    // Extends the area so that it includes the position
+    void add(const Position& position);
+
+    // Extends the area by margin Tiles in each direction
+    void expand(int margin);
+
+    // Returns true if other is within this area, an empty area is within every area
+    bool contains(const Area& other) const;
+
+    int minX;
+    int minY;
+    int maxX;
+    int maxY;
+  };
+
+  // A list of region indexes, sorted
+  using RegionList = std::vector<int>;
+
+  WorldRegions(int startX, int startY, int sizeX, int sizeY);
+
+  // Delete copy constructors
+  WorldRegions(const WorldRegions&) = delete;
+  WorldRegions& operator=(const WorldRegions&) = delete;
+
+  int getNumberOfRegions() const { return regionsX_ * regionsY_; }
+
+  // Returns the index of the region that contains the position
+  // Positions outside of the World are clamped to the nearest region
+  int getRegion(const Position& position) const;
+
+  // Sets regions to the (sorted) indexes of all regions that overlap the area
+  void getRegions(const Area& area, RegionList* regions) const;
+
+  void lock(const RegionList& regions);
+  void unlock(const RegionList& regions);
+  void lockAll();
+  void unlockAll();
+
+ private:
+  int getRegionX(int x) const;
+  int getRegionY(int y) const;
+
+  int startX_;
+  int startY_;
+  int regionsX_;
+  int regionsY_;
+
+  std::unique_ptr<std::mutex[]> mutexes_;
+};
+
+#endif  // WORLDSERVER_WORLDREGIONS_H_
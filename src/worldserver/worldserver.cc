@@ -22,9 +22,11 @@
  * SOFTWARE.
  */
 
-#include <deque>
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include <boost/asio.hpp>  //NOLINT
 
 #include "configparser.h"
@@ -33,66 +35,107 @@
 #include "server.h"
 #include "incomingpacket.h"
 #include "outgoingpacket.h"
-#include "direction.h"
 #include "gameengine.h"
+#include "opcodetable.h"
 
 // Globals
 AccountReader accountReader;
 std::unique_ptr<Server> server;
 std::unique_ptr<GameEngine> gameEngine;
-std::unordered_map<ConnectionId, CreatureId> players;
+OpcodeTable opcodeTable;
+
+// Logged in players, indexed by Server::getConnectionIndex()
+struct PlayerEntry
+{
+  ConnectionId connectionId;
+  CreatureId playerId;
+};
+std::vector<PlayerEntry> players;
+std::mutex playersMutex;  // players is used by all network threads
+
+// Functions for players, these must be called with playersMutex locked
+CreatureId findPlayer(ConnectionId connectionId);
+void addPlayer(ConnectionId connectionId, CreatureId playerId);
+CreatureId removePlayer(ConnectionId connectionId);
 
 // Handlers for Server
 void onClientConnected(ConnectionId connectionId);
 void onClientDisconnected(ConnectionId connectionId);
 void onPacketReceived(ConnectionId connectionId, IncomingPacket* packet);
 
-// Parse functions
+// Parse functions, all packets after login are parsed by opcodeTable
 void parseLogin(ConnectionId connectionId, IncomingPacket* packet);
-void parseMoveClick(CreatureId playerId, IncomingPacket* packet);
-void parseMoveItem(CreatureId playerId, IncomingPacket* packet);
-void parseUseItem(CreatureId playerId, IncomingPacket* packet);
-void parseLookAt(CreatureId playerId, IncomingPacket* packet);
-void parseSay(CreatureId playerId, IncomingPacket* packet);
-void parseCancelMove(CreatureId playerId, IncomingPacket* packet);
 
 // Callback for GameEngine (PlayerCtrl)
-void sendPacket(ConnectionId connectionId, const OutgoingPacket& packet);
+void sendPacket(ConnectionId connectionId, OutgoingPacket&& packet);
+void sendSharedPacket(ConnectionId connectionId, const std::shared_ptr<const OutgoingPacket>& packet);
+
+CreatureId findPlayer(ConnectionId connectionId)
+{
+  auto index = Server::getConnectionIndex(connectionId);
+  if (index < players.size() && players[index].connectionId == connectionId)
+  {
+    return players[index].playerId;
+  }
+  return Creature::INVALID_ID;
+}
 
-// Helper functions
-Position getPosition(IncomingPacket* packet);
+void addPlayer(ConnectionId connectionId, CreatureId playerId)
+{
+  auto index = Server::getConnectionIndex(connectionId);
+  if (index >= players.size())
+  {
+    players.resize(index + 1, { 0, Creature::INVALID_ID });
+  }
+  players[index] = { connectionId, playerId };
+}
+
+CreatureId removePlayer(ConnectionId connectionId)
+{
+  auto playerId = findPlayer(connectionId);
+  if (playerId != Creature::INVALID_ID)
+  {
+    players[Server::getConnectionIndex(connectionId)].playerId = Creature::INVALID_ID;
+  }
+  return playerId;
+}
 
 void onClientConnected(ConnectionId connectionId)
 {
-  LOG_DEBUG("Client connected, id: %d", connectionId);
+  LOG_DEBUG("Client connected, id: %lu", connectionId);
 }
 
 void onClientDisconnected(ConnectionId connectionId)
 {
-  LOG_DEBUG("Client disconnected, id: %d", connectionId);
+  LOG_DEBUG("Client disconnected, id: %lu", connectionId);
 
   // Check if the connection is logged in to the game engine
-  auto playerIt = players.find(connectionId);
-  if (playerIt != players.end())
+  std::unique_lock<std::mutex> lock(playersMutex);
+  auto playerId = removePlayer(connectionId);
+  lock.unlock();
+
+  if (playerId != Creature::INVALID_ID)
   {
-    gameEngine->playerDespawn(playerIt->second);
-    players.erase(connectionId);
+    gameEngine->playerDespawn(playerId);
   }
 }
 
 void onPacketReceived(ConnectionId connectionId, IncomingPacket* packet)
 {
-  LOG_DEBUG("Parsing packet from connection id: %d, packet size: %d", connectionId, packet->getLength());
+  LOG_DEBUG("Parsing packet from connection id: %lu, packet size: %d", connectionId, packet->getLength());
 
   // Check if the connection is logged in to the game engine
-  auto playerIt = players.find(connectionId);
-  if (playerIt == players.end())
+  std::unique_lock<std::mutex> lock(playersMutex);
+  auto playerId = findPlayer(connectionId);
+  lock.unlock();
+
+  if (playerId == Creature::INVALID_ID)
   {
     // Not logged in, we only accept the login packet (0x0A) here
     uint8_t packetId = packet->getU8();
     if (packetId != 0x0A)
     {
-      LOG_ERROR("Unexpected packet from connection id: %d. Expected login packet, not: 0x%X", connectionId, packetId);
+      LOG_ERROR("Unexpected packet from connection id: %lu. Expected login packet, not: 0x%X", connectionId, packetId);
       server->closeConnection(connectionId);
       return;
     }
@@ -103,78 +146,42 @@ void onPacketReceived(ConnectionId connectionId, IncomingPacket* packet)
   }
 
   // The connection is logged in, handle the packet
-  CreatureId playerId = playerIt->second;
+  Command command;
+  command.creatureId = playerId;
   while (!packet->isEmpty())
   {
-    uint8_t packetId = packet->getU8();
-    switch (packetId)
+    auto packetId = packet->peekU8();
+    switch (opcodeTable.parse(packet, &command))
     {
-      case 0x14:  // Logout
-      {
-        gameEngine->playerDespawn(playerId);
-        players.erase(connectionId);
-        server->closeConnection(connectionId);
-        return;
-      }
-
-      case 0x64:  // Player move with mouse
-      {
-        parseMoveClick(playerId, packet);
-        break;
-      }
-
-      case 0x65:  // Player move, North = 0
-      case 0x66:  // East  = 1
-      case 0x67:  // South = 2
-      case 0x68:  // West  = 3
-      {
-        gameEngine->playerMove(playerId, static_cast<Direction>(packetId - 0x65));
-        break;
-      }
-
-      case 0x6F:  // Player turn, North = 0
-      case 0x70:  // East  = 1
-      case 0x71:  // South = 2
-      case 0x72:  // West  = 3
-      {
-        gameEngine->playerTurn(playerId, static_cast<Direction>(packetId - 0x6F));
-        break;
-      }
-
-      case 0x78:  // Move item
-      {
-        parseMoveItem(playerId, packet);
-        break;
-      }
-
-      case 0x82:  // Use item
-      {
-        parseUseItem(playerId, packet);
-        break;
-      }
-
-      case 0x8C:  // Look at
+      case OpcodeTable::COMMAND:
       {
-        parseLookAt(playerId, packet);
+        gameEngine->addCommand(command);
         break;
       }
 
-      case 0x96:
+      case OpcodeTable::LOGOUT:
       {
-        parseSay(playerId, packet);
-        break;
+        // Only despawn if onClientDisconnected didn't already do it
+        lock.lock();
+        if (removePlayer(connectionId) != Creature::INVALID_ID)
+        {
+          gameEngine->playerDespawn(playerId);
+        }
+        lock.unlock();
+        server->closeConnection(connectionId);
+        return;
       }
 
-      case 0xBE:
+      case OpcodeTable::UNKNOWN_OPCODE:
       {
-        parseCancelMove(playerId, packet);
-        break;
+        LOG_ERROR("Unknown packet from connection id: %lu, packet id: 0x%X", connectionId, packetId);
+        return;  // Don't read any more, even though there might be more packets that we can parse
       }
 
-      default:
+      case OpcodeTable::MALFORMED:
       {
-        LOG_ERROR("Unknown packet from connection id: %d, packet id: 0x%X", connectionId, packetId);
-        return;  // Don't read any more, even though there might be more packets that we can parse
+        LOG_ERROR("Malformed packet from connection id: %lu, packet id: 0x%X", connectionId, packetId);
+        return;  // Don't read any more, we can't know where the next packet starts
       }
     }
   }
@@ -182,7 +189,7 @@ void onPacketReceived(ConnectionId connectionId, IncomingPacket* packet)
 
 void parseLogin(ConnectionId connectionId, IncomingPacket* packet)
 {
-  LOG_DEBUG("Parsing packet from connection id: %d", connectionId);
+  LOG_DEBUG("Parsing packet from connection id: %lu", connectionId);
 
   packet->getU8();  // Unknown (0x02)
   uint8_t client_os = packet->getU8();
@@ -203,7 +210,7 @@ void parseLogin(ConnectionId connectionId, IncomingPacket* packet)
     OutgoingPacket response;
     response.addU8(0x14);
     response.addString("Invalid character.");
-    server->sendPacket(connectionId, response);
+    server->sendPacket(connectionId, std::move(response));
     server->closeConnection(connectionId);
     return;
   }
@@ -213,195 +220,39 @@ void parseLogin(ConnectionId connectionId, IncomingPacket* packet)
     OutgoingPacket response;
     response.addU8(0x14);
     response.addString("Invalid password.");
-    server->sendPacket(connectionId, response);
+    server->sendPacket(connectionId, std::move(response));
     server->closeConnection(connectionId);
     return;
   }
 
   // Login OK
   auto sendPacketFunc = std::bind(&sendPacket, connectionId, std::placeholders::_1);
-  CreatureId playerId = gameEngine->playerSpawn(character_name, sendPacketFunc);
-
-  // Store the playerId
-  players.insert(std::make_pair(connectionId, playerId));
-}
-
-void parseMoveClick(CreatureId playerId, IncomingPacket* packet)
-{
-  std::deque<Direction> moves;
-  uint8_t pathLength = packet->getU8();
-  for (auto i = 0; i < pathLength; i++)
-  {
-    moves.push_back(static_cast<Direction>(packet->getU8()));
-  }
-
-  gameEngine->playerMovePath(playerId, moves);
-}
-
-void parseMoveItem(CreatureId playerId, IncomingPacket* packet)
-{
-  // There are four options here:
-  // Moving from inventory to inventory
-  // Moving from inventory to Tile
-  // Moving from Tile to inventory
-  // Moving from Tile to Tile
-  if (packet->peekU16() == 0xFFFF)
-  {
-    // Moving from inventory ...
-    packet->getU16();
-
-    auto fromInventoryId = packet->getU8();
-    auto unknown = packet->getU16();
-    auto itemId = packet->getU16();
-    auto unknown2 = packet->getU8();
-
-    if (packet->peekU16() == 0xFFFF)
-    {
-      // ... to inventory
-      packet->getU16();
-      auto toInventoryId = packet->getU8();
-      auto unknown3 = packet->getU16();
-      auto countOrSubType = packet->getU8();
-
-      LOG_DEBUG("parseMoveItem(): Moving %d (countOrSubType %d) from inventoryId %d to iventoryId %d (unknown %d, %d, %d)",
-                  itemId, countOrSubType, fromInventoryId, toInventoryId, unknown, unknown2, unknown3);
-
-
-      gameEngine->playerMoveItemFromInvToInv(playerId, fromInventoryId, itemId, countOrSubType, toInventoryId);
-    }
-    else
-    {
-      // ... to Tile
-      auto toPosition = getPosition(packet);
-      auto countOrSubType = packet->getU8();
-
-      LOG_DEBUG("parseMoveItem(): Moving %d (countOrSubType %d) from inventoryId %d to %s (unknown %d, %d)",
-                  itemId, countOrSubType, fromInventoryId, toPosition.toString().c_str(), unknown, unknown2);
-
-
-      gameEngine->playerMoveItemFromInvToPos(playerId, fromInventoryId, itemId, countOrSubType, toPosition);
-    }
-  }
-  else
-  {
-    // Moving from Tile ...
-    auto fromPosition = getPosition(packet);
-    auto itemId = packet->getU16();
-    auto fromStackPos = packet->getU8();
-
-    if (packet->peekU16() == 0xFFFF)
-    {
-      // ... to inventory
-      packet->getU16();
-
-      auto toInventoryId = packet->getU8();
-      auto unknown = packet->getU16();
-      auto countOrSubType = packet->getU8();
-
-      LOG_DEBUG("parseMoveItem(): Moving %d (countOrSubType %d) from %s (stackpos: %d) to inventoryId %d (unknown: %d)",
-                  itemId, countOrSubType, fromPosition.toString().c_str(), fromStackPos, toInventoryId, unknown);
-
-      gameEngine->playerMoveItemFromPosToInv(playerId, fromPosition, fromStackPos, itemId, countOrSubType, toInventoryId);
-    }
-    else
-    {
-      // ... to Tile
-      auto toPosition = getPosition(packet);
-      auto countOrSubType = packet->getU8();
-
-      LOG_DEBUG("parseMoveItem(): Moving %d (countOrSubType %d) from %s (stackpos: %d) to %s (unknown: %d)",
-                  itemId, countOrSubType, fromPosition.toString().c_str(), fromStackPos, toPosition.toString().c_str());
-
-      gameEngine->playerMoveItemFromPosToPos(playerId, fromPosition, fromStackPos, itemId, countOrSubType, toPosition);
-    }
-  }
-}
-
-void parseUseItem(CreatureId playerId, IncomingPacket* packet)
-{
-  // There are two options here:
-  if (packet->peekU16() == 0xFFFF)
-  {
-    // Use Item in inventory
-    packet->getU16();
-    auto inventoryIndex = packet->getU8();
-    auto unknown = packet->getU16();
-    auto itemId = packet->getU16();
-    auto unknown2 = packet->getU16();
-
-    LOG_DEBUG("parseUseItem(): Using Item %d at inventory index: %d (unknown: %d, unknown2: %d)",
-                itemId, inventoryIndex, unknown, unknown2);
-
-    gameEngine->playerUseInvItem(playerId, itemId, inventoryIndex);
-  }
-  else
+  auto sendSharedPacketFunc = std::bind(&sendSharedPacket, connectionId, std::placeholders::_1);
+
+  // Spawn and store the playerId atomically, a concurrent onClientDisconnected (on another
+  // network thread) must either see the player and despawn it, or happen before the spawn
+  // The Connection is marked as closed before onClientDisconnected is called, so if it is
+  // still open here, onClientDisconnected will see the player
+  std::lock_guard<std::mutex> lock(playersMutex);
+  if (!server->isConnectionOpen(connectionId))
   {
-    // Use Item on Tile
-    auto position = getPosition(packet);
-    auto itemId = packet->getU16();
-    auto stackPosition = packet->getU8();
-    auto unknown = packet->getU8();
-
-    LOG_DEBUG("parseUseItem(): Using Item %d at Tile: %s stackPos: %d (unknown: %d)",
-                itemId, position.toString().c_str(), stackPosition, unknown);
-
-    gameEngine->playerUsePosItem(playerId, itemId, position, stackPosition);
+    LOG_DEBUG("Connection id: %lu closed during login", connectionId);
+    return;
   }
+  CreatureId playerId = gameEngine->playerSpawn(character_name, sendPacketFunc, sendSharedPacketFunc);
+  addPlayer(connectionId, playerId);
 }
 
-void parseLookAt(CreatureId playerId, IncomingPacket* packet)
-{
-  // TODO(gurka): Look at inventory / container?
-  Position position = getPosition(packet);
-  uint16_t itemId = packet->getU16();
-
-  gameEngine->playerLookAt(playerId, position, itemId);
-}
-
-void parseSay(CreatureId playerId, IncomingPacket* packet)
+void sendPacket(ConnectionId connectionId, OutgoingPacket&& packet)
 {
-  uint8_t type = packet->getU8();
-
-  std::string receiver = "";
-  uint16_t channelId = 0;
-
-  switch (type)
-  {
-    case 0x06:  // PRIVATE
-    case 0x0B:  // PRIVATE RED
-      receiver = packet->getString();
-      break;
-    case 0x07:  // CHANNEL_Y
-    case 0x0A:  // CHANNEL_R1
-      channelId = packet->getU16();
-      break;
-    default:
-      break;
-  }
-
-  std::string message = packet->getString();
-
-  gameEngine->playerSay(playerId, type, message, receiver, channelId);
+  server->sendPacket(connectionId, std::move(packet));
 }
 
-void parseCancelMove(CreatureId playerId, IncomingPacket* packet)
-{
-  gameEngine->playerCancelMove(playerId);
-}
-
-void sendPacket(int connectionId, const OutgoingPacket& packet)
+void sendSharedPacket(ConnectionId connectionId, const std::shared_ptr<const OutgoingPacket>& packet)
 {
   server->sendPacket(connectionId, packet);
 }
 
-Position getPosition(IncomingPacket* packet)
-{
-  auto x = packet->getU16();
-  auto y = packet->getU16();
-  auto z = packet->getU8();
-  return Position(x, y, z);
-}
-
 int main(int argc, char* argv[])
 {
   // Read configuration
@@ -413,8 +264,19 @@ int main(int argc, char* argv[])
   }
 
   auto serverPort = config.getInteger("server", "port", 7172);
+  auto backend = config.getString("server", "backend", "asio");
+  auto acceptors = config.getInteger("server", "acceptors", 1);
+  auto maxBytesPerWrite = config.getInteger("server", "max_bytes_per_write", 65536);
+  auto maxQueuedBytes = config.getInteger("server", "max_queued_bytes", 262144);
+  auto slowClientTimeout = config.getInteger("server", "slow_client_timeout", 10);
+  auto networkThreads = config.getInteger("server", "network_threads", 0);
 
   auto loginMessage = config.getString("world", "login_message", "Welcome to LoginServer!");
+  auto tickRate = config.getInteger("world", "tick_rate", 0);
+  auto workerThreads = config.getInteger("world", "worker_threads", 0);
+  auto pagedWorld = config.getBoolean("world", "paged_world", false);
+  auto pagedIdleTimeout = config.getInteger("world", "paged_idle_timeout", 300);
+  auto pagedMemoryBudget = config.getInteger("world", "paged_memory_budget", 1024);
   auto accountsFilename = config.getString("world", "accounts_file", "data/accounts.xml");
   auto dataFilename = config.getString("world", "data_file", "data/data.dat");
   auto itemsFilename = config.getString("world", "item_file", "data/items.xml");
@@ -424,16 +286,32 @@ int main(int argc, char* argv[])
   LOG_INFO("                            WorldServer configuration                           ");
   LOG_INFO("================================================================================");
   LOG_INFO("Server port:               %d", serverPort);
+  LOG_INFO("Network backend:           %s", backend.c_str());
+  LOG_INFO("Acceptors:                 %d", acceptors);
+  LOG_INFO("Max bytes per write:       %d", maxBytesPerWrite);
+  LOG_INFO("Max queued bytes:          %d", maxQueuedBytes);
+  LOG_INFO("Slow client timeout:       %d", slowClientTimeout);
+  LOG_INFO("Network threads:           %d", networkThreads);
   LOG_INFO("");
   LOG_INFO("Login message:             %s", loginMessage.c_str());
+  LOG_INFO("Tick rate:                 %d", tickRate);
+  LOG_INFO("Worker threads:            %d", workerThreads);
+  LOG_INFO("Paged world:               %s", pagedWorld ? "true" : "false");
+  LOG_INFO("Paged idle timeout:        %d", pagedIdleTimeout);
+  LOG_INFO("Paged memory budget:       %d", pagedMemoryBudget);
   LOG_INFO("Accounts filename:         %s", accountsFilename.c_str());
   LOG_INFO("Data filename:             %s", dataFilename.c_str());
   LOG_INFO("Items filename:            %s", itemsFilename.c_str());
   LOG_INFO("World filename:            %s", worldFilename.c_str());
   LOG_INFO("================================================================================");
 
-  // Setup io_service, AccountManager, GameEngine and Server
+  // Setup io_services, AccountManager, GameEngine and Server
+  // With network_threads = 0 everything runs on the main thread. Otherwise the Server
+  // (socket I/O and packet parsing) runs on its own io_service with network_threads
+  // threads, while the GameEngine (and all game state) runs on the main thread
   boost::asio::io_service io_service;
+  boost::asio::io_service networkIoServiceStorage;
+  auto& networkIoService = networkThreads > 0 ? networkIoServiceStorage : io_service;
 
   Server::Callbacks callbacks =
   {
@@ -441,12 +319,26 @@ int main(int argc, char* argv[])
     &onClientDisconnected,
     &onPacketReceived,
   };
-  server = std::unique_ptr<Server>(new Server(&io_service, serverPort, callbacks));
+  auto serverBackend = (backend == "io_uring") ? Server::IO_URING : Server::ASIO;
+  server = std::unique_ptr<Server>(new Server(&networkIoService,
+                                              serverBackend,
+                                              serverPort,
+                                              acceptors,
+                                              maxBytesPerWrite,
+                                              maxQueuedBytes,
+                                              slowClientTimeout,
+                                              callbacks));
+  server->setFlushIoService(&io_service);
   gameEngine = std::unique_ptr<GameEngine>(new GameEngine(&io_service,
                                                           loginMessage,
                                                           dataFilename,
                                                           itemsFilename,
-                                                          worldFilename));
+                                                          worldFilename,
+                                                          tickRate,
+                                                          workerThreads,
+                                                          pagedWorld,
+                                                          pagedIdleTimeout,
+                                                          pagedMemoryBudget));
   if (!accountReader.loadFile(accountsFilename))
   {
     LOG_ERROR("Could not load accounts file: %s", accountsFilename.c_str());
@@ -469,14 +361,38 @@ int main(int argc, char* argv[])
     return -2;
   }
 
+  std::unique_ptr<boost::asio::io_service::work> networkWork;
+  std::vector<std::thread> networkThreadPool;
+  if (networkThreads > 0)
+  {
+    networkWork.reset(new boost::asio::io_service::work(networkIoService));
+    for (auto i = 0; i < networkThreads; i++)
+    {
+      networkThreadPool.emplace_back([&networkIoService]() { networkIoService.run(); });
+    }
+  }
+
   // run() will continue to run until ^C from user is catched
   io_service.run();
 
   LOG_INFO("Stopping GameEngine");
   gameEngine->stop();
 
+  if (networkThreads > 0)
+  {
+    LOG_INFO("Stopping network threads");
+    networkWork.reset();
+    networkIoService.stop();
+    for (auto& thread : networkThreadPool)
+    {
+      thread.join();
+    }
+  }
+
   LOG_INFO("Stopping Server");
   server->stop();
 
+  opcodeTable.logStats();
+
   return 0;
 }
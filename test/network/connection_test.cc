@@ -0,0 +1,222 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "connection.h"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>  //NOLINT
+
+#include "outgoingpacket.h"
+
+#include "gtest/gtest.h"
+
+// A Connection whose writes never complete, unless the test completes them
+class FakeConnection : public Connection
+{
+ public:
+  FakeConnection(std::size_t maxQueuedBytes,
+                 std::chrono::steady_clock::duration slowClientTimeout,
+                 const Callbacks& callbacks)
+    : Connection(65536, maxQueuedBytes, slowClientTimeout, callbacks),
+      numberOfWrites(0),
+      socketClosed(false)
+  {
+  }
+
+  void completeWrite()
+  {
+    onPacketsSent(boost::system::error_code());
+  }
+
+  // Runs the handlers passed to post()
+  void runPosted()
+  {
+    auto handlers = std::move(posted);
+    posted.clear();
+    for (const auto& handler : handlers)
+    {
+      handler();
+    }
+  }
+
+  int numberOfWrites;
+  bool socketClosed;
+  std::vector<std::function<void(void)>> posted;
+
+ protected:
+  void asyncReceive(uint8_t* buffer, std::size_t length) override
+  {
+  }
+
+  void asyncSend(const std::vector<boost::asio::const_buffer>& buffers) override
+  {
+    numberOfWrites++;
+  }
+
+  void closeSocket() override
+  {
+    socketClosed = true;
+  }
+
+  void post(const std::function<void(void)>& handler) override
+  {
+    posted.push_back(handler);
+  }
+};
+
+class ConnectionTest : public ::testing::Test
+{
+ public:
+  ConnectionTest()
+    : closed_(false)
+  {
+  }
+
+  void createConnection(std::chrono::steady_clock::duration slowClientTimeout)
+  {
+    Connection::Callbacks callbacks =
+    {
+      [this]() { closed_ = true; },
+      [](IncomingPacket* packet) {}
+    };
+    connection_ = std::make_shared<FakeConnection>(MAX_QUEUED_BYTES, slowClientTimeout, callbacks);
+  }
+
+  static OutgoingPacket createPacket(std::size_t length, OutgoingPacket::Priority priority)
+  {
+    OutgoingPacket packet;
+    for (auto i = 0u; i < length; i++)
+    {
+      packet.addU8(i);
+    }
+    packet.setPriority(priority);
+    return packet;
+  }
+
+  static const std::size_t MAX_QUEUED_BYTES = 1000;
+
+  std::shared_ptr<FakeConnection> connection_;
+  bool closed_;
+};
+
+const std::size_t ConnectionTest::MAX_QUEUED_BYTES;
+
+TEST_F(ConnectionTest, LowPriorityDroppedOverBudget)
+{
+  createConnection(std::chrono::hours(1));
+
+  // The first packet is written but the write never completes
+  ASSERT_TRUE(connection_->sendPacket(createPacket(600, OutgoingPacket::NORMAL)));
+  connection_->flush();
+  ASSERT_EQ(1, connection_->numberOfWrites);
+
+  ASSERT_FALSE(connection_->sendPacket(createPacket(600, OutgoingPacket::LOW)));
+
+  // A low priority packet that fits in the budget is queued
+  ASSERT_TRUE(connection_->sendPacket(createPacket(400, OutgoingPacket::LOW)));
+
+  auto stats = connection_->getStats();
+  ASSERT_EQ(1000u, stats.queuedBytes);
+  ASSERT_EQ(1000u, stats.peakQueuedBytes);
+  ASSERT_EQ(1u, stats.droppedPackets);
+  ASSERT_EQ(600u, stats.droppedBytes);
+  ASSERT_TRUE(connection_->posted.empty());
+  ASSERT_FALSE(closed_);
+}
+
+TEST_F(ConnectionTest, NormalPriorityQueuedUntilHardLimit)
+{
+  createConnection(std::chrono::hours(1));
+
+  ASSERT_TRUE(connection_->sendPacket(createPacket(600, OutgoingPacket::NORMAL)));
+  connection_->flush();
+
+  // Normal packets are queued over the budget, up to MAX_QUEUED_BYTES_FACTOR times it
+  ASSERT_TRUE(connection_->sendPacket(createPacket(600, OutgoingPacket::NORMAL)));
+  connection_->flush();
+  ASSERT_TRUE(connection_->sendPacket(createPacket(800, OutgoingPacket::NORMAL)));
+  ASSERT_EQ(2000u, connection_->getStats().queuedBytes);
+  ASSERT_TRUE(connection_->posted.empty());
+
+  ASSERT_FALSE(connection_->sendPacket(createPacket(1, OutgoingPacket::NORMAL)));
+
+  auto stats = connection_->getStats();
+  ASSERT_EQ(2000u, stats.queuedBytes);
+  ASSERT_EQ(2000u, stats.peakQueuedBytes);
+  ASSERT_EQ(1u, stats.droppedPackets);
+  ASSERT_EQ(1u, stats.droppedBytes);
+
+  // The Connection is closed later, and no more packets are queued until then
+  ASSERT_EQ(1u, connection_->posted.size());
+  ASSERT_FALSE(connection_->socketClosed);
+  ASSERT_FALSE(connection_->sendPacket(createPacket(1, OutgoingPacket::NORMAL)));
+
+  connection_->runPosted();
+  ASSERT_TRUE(connection_->socketClosed);
+  ASSERT_TRUE(closed_);
+}
+
+TEST_F(ConnectionTest, NormalPriorityQueuedUntilTimeout)
+{
+  createConnection(std::chrono::milliseconds(50));
+
+  ASSERT_TRUE(connection_->sendPacket(createPacket(1200, OutgoingPacket::NORMAL)));
+  connection_->flush();
+  ASSERT_TRUE(connection_->posted.empty());
+
+  // Still over the budget when the timeout has passed
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  ASSERT_FALSE(connection_->sendPacket(createPacket(10, OutgoingPacket::NORMAL)));
+  ASSERT_EQ(1u, connection_->posted.size());
+
+  connection_->runPosted();
+  ASSERT_TRUE(connection_->socketClosed);
+  ASSERT_TRUE(closed_);
+}
+
+TEST_F(ConnectionTest, OverBudgetResetAfterWrite)
+{
+  createConnection(std::chrono::milliseconds(50));
+
+  ASSERT_TRUE(connection_->sendPacket(createPacket(1200, OutgoingPacket::NORMAL)));
+  connection_->flush();
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  // The write brings the Connection back within the budget, so the timeout starts over
+  connection_->completeWrite();
+  auto stats = connection_->getStats();
+  ASSERT_EQ(0u, stats.queuedBytes);
+  ASSERT_EQ(1200u, stats.peakQueuedBytes);
+
+  ASSERT_TRUE(connection_->sendPacket(createPacket(1200, OutgoingPacket::NORMAL)));
+  connection_->flush();
+  ASSERT_EQ(2, connection_->numberOfWrites);
+  ASSERT_TRUE(connection_->posted.empty());
+  ASSERT_FALSE(closed_);
+}
@@ -0,0 +1,189 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "server.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>  //NOLINT
+
+#include "incomingpacket.h"
+#include "outgoingpacket.h"
+
+#include "gtest/gtest.h"
+
+// Runs a Server on a loopback port, which echoes every packet back to the client
+class ServerTest : public ::testing::Test
+{
+ public:
+  ServerTest()
+    : work_(new boost::asio::io_service::work(io_service_)),
+      thread_([this]() { io_service_.run(); })
+  {
+  }
+
+  ~ServerTest()
+  {
+    if (server_)
+    {
+      server_->stop();
+    }
+    work_.reset();
+    io_service_.stop();
+    thread_.join();
+  }
+
+  bool startServer(Server::Backend backend)
+  {
+    Server::Callbacks callbacks =
+    {
+      [this](ConnectionId connectionId)
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        connected_.push_back(connectionId);
+        condition_.notify_all();
+      },
+      [this](ConnectionId connectionId)
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        disconnected_.push_back(connectionId);
+        condition_.notify_all();
+      },
+      [this](ConnectionId connectionId, IncomingPacket* packet)
+      {
+        OutgoingPacket response;
+        while (!packet->isEmpty())
+        {
+          response.addU8(packet->getU8());
+        }
+        server_->sendPacket(connectionId, std::move(response));
+      }
+    };
+
+    // The Server's io_service is used for the flushes, and for all I/O with ASIO
+    server_.reset(new Server(&io_service_, backend, PORT, 1, 65536, 262144, 10, callbacks));
+    return server_->start();
+  }
+
+  // Waits until the vector (connected_ or disconnected_) has the given size
+  bool waitFor(const std::vector<ConnectionId>& ids, std::size_t size)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return condition_.wait_for(lock, std::chrono::seconds(5), [&ids, size]() { return ids.size() >= size; });
+  }
+
+  // Sends a small packet and a packet that is larger than a receive buffer of the io_uring
+  // backend in one write, and checks that they are echoed back
+  void sendAndReceive(boost::asio::ip::tcp::socket* socket)
+  {
+    std::vector<uint8_t> data = { 3, 0, 'a', 'b', 'c' };
+    std::vector<uint8_t> largePacket(6000);
+    for (auto i = 0u; i < largePacket.size(); i++)
+    {
+      largePacket[i] = i;
+    }
+    data.push_back(largePacket.size() & 0xFF);
+    data.push_back(largePacket.size() >> 8);
+    data.insert(data.end(), largePacket.begin(), largePacket.end());
+    boost::asio::write(*socket, boost::asio::buffer(data));
+
+    // The replies may be coalesced into fewer frames, depending on how the
+    // Server received the packets, so compare the concatenated payloads
+    std::vector<uint8_t> expected = { 'a', 'b', 'c' };
+    expected.insert(expected.end(), largePacket.begin(), largePacket.end());
+    std::vector<uint8_t> received;
+    while (received.size() < expected.size())
+    {
+      uint8_t header[2];
+      boost::asio::read(*socket, boost::asio::buffer(header));
+      std::vector<uint8_t> payload(header[0] | (header[1] << 8));
+      ASSERT_FALSE(payload.empty());
+      boost::asio::read(*socket, boost::asio::buffer(payload));
+      received.insert(received.end(), payload.begin(), payload.end());
+    }
+    ASSERT_EQ(expected, received);
+  }
+
+  void connectSendAndReconnect()
+  {
+    boost::asio::io_service clientIoService;
+    boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::address_v4::loopback(), PORT);
+
+    boost::asio::ip::tcp::socket socket(clientIoService);
+    socket.connect(endpoint);
+    ASSERT_TRUE(waitFor(connected_, 1));
+    sendAndReceive(&socket);
+
+    // The Server notices that the client closed the connection
+    socket.close();
+    ASSERT_TRUE(waitFor(disconnected_, 1));
+    ASSERT_EQ(connected_[0], disconnected_[0]);
+
+    // The new Connection reuses the slot, but not the ConnectionId
+    boost::asio::ip::tcp::socket otherSocket(clientIoService);
+    otherSocket.connect(endpoint);
+    ASSERT_TRUE(waitFor(connected_, 2));
+    ASSERT_EQ(Server::getConnectionIndex(connected_[0]), Server::getConnectionIndex(connected_[1]));
+    ASSERT_NE(connected_[0], connected_[1]);
+    sendAndReceive(&otherSocket);
+
+    otherSocket.close();
+    ASSERT_TRUE(waitFor(disconnected_, 2));
+    ASSERT_EQ(connected_[1], disconnected_[1]);
+  }
+
+  static const unsigned short PORT = 17172;
+
+  boost::asio::io_service io_service_;
+  std::unique_ptr<boost::asio::io_service::work> work_;
+  std::thread thread_;
+  std::unique_ptr<Server> server_;
+
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::vector<ConnectionId> connected_;
+  std::vector<ConnectionId> disconnected_;
+};
+
+TEST_F(ServerTest, Asio)
+{
+  ASSERT_TRUE(startServer(Server::ASIO));
+  connectSendAndReconnect();
+}
+
+TEST_F(ServerTest, IoUring)
+{
+  // Fails if not built WITH_IO_URING, or if the kernel is too old
+  if (!startServer(Server::IO_URING))
+  {
+    GTEST_SKIP() << "The io_uring backend is not available";
+  }
+  connectSendAndReconnect();
+}
@@ -0,0 +1,138 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "mpscqueue.h"
+
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+TEST(MpscQueueTest, PushPop)
+{
+  MpscQueue<int, 4> queue;
+  int value = 0;
+
+  ASSERT_FALSE(queue.pop(&value));
+
+  ASSERT_TRUE(queue.push(1));
+  ASSERT_TRUE(queue.push(2));
+  ASSERT_TRUE(queue.pop(&value));
+  ASSERT_EQ(value, 1);
+  ASSERT_TRUE(queue.pop(&value));
+  ASSERT_EQ(value, 2);
+  ASSERT_FALSE(queue.pop(&value));
+}
+
+TEST(MpscQueueTest, Full)
+{
+  MpscQueue<int, 4> queue;
+  int value = 0;
+
+  for (auto i = 0; i < 4; i++)
+  {
+    ASSERT_TRUE(queue.push(i));
+  }
+  ASSERT_FALSE(queue.push(4));
+
+  // Free one slot
+  ASSERT_TRUE(queue.pop(&value));
+  ASSERT_EQ(value, 0);
+  ASSERT_TRUE(queue.push(4));
+  ASSERT_FALSE(queue.push(5));
+
+  // Wrap around a few times
+  for (auto i = 5; i < 100; i++)
+  {
+    ASSERT_TRUE(queue.pop(&value));
+    ASSERT_EQ(value, i - 4);
+    ASSERT_TRUE(queue.push(i));
+  }
+}
+
+TEST(MpscQueueTest, Consume)
+{
+  MpscQueue<int, 8> queue;
+  for (auto i = 0; i < 6; i++)
+  {
+    queue.push(i);
+  }
+
+  std::vector<int> values;
+  auto f = [&values](int value) { values.push_back(value); };
+
+  ASSERT_EQ(queue.consume(f, 4), 4u);
+  ASSERT_EQ(values, std::vector<int>({ 0, 1, 2, 3 }));
+
+  ASSERT_EQ(queue.consume(f, 4), 2u);
+  ASSERT_EQ(values, std::vector<int>({ 0, 1, 2, 3, 4, 5 }));
+
+  ASSERT_EQ(queue.consume(f, 4), 0u);
+}
+
+TEST(MpscQueueTest, MultipleProducers)
+{
+  const int numberOfProducers = 4;
+  const int valuesPerProducer = 10000;
+
+  MpscQueue<int, 64> queue;
+
+  std::vector<std::thread> producers;
+  for (auto producer = 0; producer < numberOfProducers; producer++)
+  {
+    producers.emplace_back([&queue, producer]()
+    {
+      for (auto i = 0; i < valuesPerProducer; i++)
+      {
+        while (!queue.push(producer * valuesPerProducer + i))
+        {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  // Values from each producer must arrive in order
+  std::vector<int> next(numberOfProducers, 0);
+  auto received = 0;
+  while (received < numberOfProducers * valuesPerProducer)
+  {
+    int value;
+    if (!queue.pop(&value))
+    {
+      std::this_thread::yield();
+      continue;
+    }
+
+    auto producer = value / valuesPerProducer;
+    ASSERT_EQ(value % valuesPerProducer, next[producer]);
+    next[producer]++;
+    received++;
+  }
+
+  for (auto& producer : producers)
+  {
+    producer.join();
+  }
+}
@@ -0,0 +1,130 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "smallvector.h"
+
+#include <memory>
+#include <string>
+
+#include "gtest/gtest.h"
+
+TEST(SmallVectorTest, PushBackInline)
+{
+  SmallVector<int, 4> vector;
+  ASSERT_TRUE(vector.empty());
+
+  vector.push_back(1);
+  vector.push_back(2);
+  vector.push_back(3);
+
+  ASSERT_EQ(vector.size(), 3u);
+  ASSERT_EQ(vector.capacity(), 4u);
+  ASSERT_EQ(vector[0], 1);
+  ASSERT_EQ(vector[1], 2);
+  ASSERT_EQ(vector[2], 3);
+  ASSERT_EQ(vector.front(), 1);
+  ASSERT_EQ(vector.back(), 3);
+}
+
+TEST(SmallVectorTest, PushBackHeap)
+{
+  SmallVector<std::string, 2> vector;
+  for (auto i = 0; i < 10; i++)
+  {
+    vector.push_back(std::to_string(i));
+  }
+
+  ASSERT_EQ(vector.size(), 10u);
+  ASSERT_GE(vector.capacity(), 10u);
+  for (auto i = 0; i < 10; i++)
+  {
+    ASSERT_EQ(vector[i], std::to_string(i));
+  }
+
+  // Push back an element that is in the vector itself while growing
+  SmallVector<std::string, 2> vector2 = { "a", "b" };
+  vector2.push_back(vector2[0]);
+  ASSERT_EQ(vector2.size(), 3u);
+  ASSERT_EQ(vector2[2], "a");
+}
+
+TEST(SmallVectorTest, InsertErase)
+{
+  SmallVector<int, 4> vector = { 1, 2, 4 };
+
+  vector.insert(vector.begin() + 2, 3);
+  vector.insert(vector.begin(), 0);
+  vector.insert(vector.end(), 5);
+  ASSERT_EQ(vector.size(), 6u);
+  for (auto i = 0; i < 6; i++)
+  {
+    ASSERT_EQ(vector[i], i);
+  }
+
+  vector.erase(vector.begin());
+  vector.erase(vector.begin() + 2);
+  vector.erase(vector.end() - 1);
+  ASSERT_EQ(vector.size(), 3u);
+  ASSERT_EQ(vector[0], 1);
+  ASSERT_EQ(vector[1], 2);
+  ASSERT_EQ(vector[2], 4);
+}
+
+TEST(SmallVectorTest, CopyMove)
+{
+  SmallVector<std::shared_ptr<int>, 2> inlineVector;
+  inlineVector.push_back(std::make_shared<int>(1));
+
+  SmallVector<std::shared_ptr<int>, 2> heapVector;
+  for (auto i = 0; i < 3; i++)
+  {
+    heapVector.push_back(std::make_shared<int>(i));
+  }
+
+  auto inlineCopy = inlineVector;
+  ASSERT_EQ(inlineCopy.size(), 1u);
+  ASSERT_EQ(inlineCopy[0].use_count(), 2);
+
+  auto heapCopy = heapVector;
+  ASSERT_EQ(heapCopy.size(), 3u);
+  ASSERT_EQ(*heapCopy[2], 2);
+
+  auto inlineMoved = std::move(inlineVector);
+  ASSERT_EQ(inlineMoved.size(), 1u);
+  ASSERT_TRUE(inlineVector.empty());
+  ASSERT_EQ(inlineMoved[0].use_count(), 2);
+
+  auto heapMoved = std::move(heapVector);
+  ASSERT_EQ(heapMoved.size(), 3u);
+  ASSERT_TRUE(heapVector.empty());
+  ASSERT_EQ(heapMoved[0].use_count(), 2);
+
+  heapMoved = inlineMoved;
+  ASSERT_EQ(heapMoved.size(), 1u);
+  ASSERT_EQ(heapMoved[0].use_count(), 3);  // inlineCopy, inlineMoved and heapMoved
+
+  heapMoved.clear();
+  ASSERT_TRUE(heapMoved.empty());
+  ASSERT_EQ(inlineMoved[0].use_count(), 2);
+}
@@ -0,0 +1,125 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "xmlscanner.h"
+
+#include <climits>
+#include <string>
+
+#include "gtest/gtest.h"
+
+TEST(XmlScannerTest, ScanElements)
+{
+  std::string xml =
+  "<?xml version=\"1.0\"?>\n"
+  "<!-- A comment with a <tag> -->\n"
+  "<map width=\"16\" height='8'>\n"
+  "  <tile><item id=\"100\"/><item id=\"-5\" name=\"a > b\"></item></tile>\n"
+  "  <![CDATA[ <ignored/> ]]>\n"
+  "</map>\n";
+
+  XmlScanner scanner(xml.data(), xml.data() + xml.size());
+  XmlScanner::Element element;
+  int value;
+
+  ASSERT_TRUE(scanner.next(&element));
+  ASSERT_EQ(element.type, XmlScanner::Element::Type::START);
+  ASSERT_TRUE(element.isNamed("map"));
+  ASSERT_TRUE(element.getAttribute("width", &value));
+  ASSERT_EQ(value, 16);
+  ASSERT_TRUE(element.getAttribute("height", &value));
+  ASSERT_EQ(value, 8);
+  ASSERT_FALSE(element.getAttribute("depth", &value));
+
+  ASSERT_TRUE(scanner.next(&element));
+  ASSERT_EQ(element.type, XmlScanner::Element::Type::START);
+  ASSERT_TRUE(element.isNamed("tile"));
+
+  ASSERT_TRUE(scanner.next(&element));
+  ASSERT_EQ(element.type, XmlScanner::Element::Type::EMPTY);
+  ASSERT_TRUE(element.isNamed("item"));
+  ASSERT_TRUE(element.getAttribute("id", &value));
+  ASSERT_EQ(value, 100);
+
+  ASSERT_TRUE(scanner.next(&element));
+  ASSERT_EQ(element.type, XmlScanner::Element::Type::START);
+  ASSERT_TRUE(element.getAttribute("id", &value));
+  ASSERT_EQ(value, -5);
+  ASSERT_FALSE(element.getAttribute("name", &value));
+
+  ASSERT_TRUE(scanner.next(&element));
+  ASSERT_EQ(element.type, XmlScanner::Element::Type::END);
+  ASSERT_TRUE(element.isNamed("item"));
+
+  ASSERT_TRUE(scanner.next(&element));
+  ASSERT_EQ(element.type, XmlScanner::Element::Type::END);
+  ASSERT_TRUE(element.isNamed("tile"));
+
+  ASSERT_TRUE(scanner.next(&element));
+  ASSERT_EQ(element.type, XmlScanner::Element::Type::END);
+  ASSERT_TRUE(element.isNamed("map"));
+
+  ASSERT_FALSE(scanner.next(&element));
+  ASSERT_FALSE(scanner.hasError());
+}
+
+TEST(XmlScannerTest, IntegerLimits)
+{
+  std::string xml =
+  "<item a=\"2147483647\" b=\"-2147483648\" c=\"2147483648\" d=\"-2147483649\""
+  " e=\"99999999999\" f=\"999999999999999999999999\" g=\"00000000000000000042\"/>";
+
+  XmlScanner scanner(xml.data(), xml.data() + xml.size());
+  XmlScanner::Element element;
+  int value = 0;
+
+  ASSERT_TRUE(scanner.next(&element));
+  ASSERT_TRUE(element.getAttribute("a", &value));
+  ASSERT_EQ(value, INT_MAX);
+  ASSERT_TRUE(element.getAttribute("b", &value));
+  ASSERT_EQ(value, INT_MIN);
+
+  // Values that don't fit in an int are not integers
+  value = 0;
+  ASSERT_FALSE(element.getAttribute("c", &value));
+  ASSERT_FALSE(element.getAttribute("d", &value));
+  ASSERT_FALSE(element.getAttribute("e", &value));
+  ASSERT_FALSE(element.getAttribute("f", &value));
+  ASSERT_EQ(value, 0);
+
+  ASSERT_TRUE(element.getAttribute("g", &value));
+  ASSERT_EQ(value, 42);
+}
+
+TEST(XmlScannerTest, ScanInvalid)
+{
+  std::string xml = "<map><tile id=\"1\"";
+
+  XmlScanner scanner(xml.data(), xml.data() + xml.size());
+  XmlScanner::Element element;
+
+  ASSERT_TRUE(scanner.next(&element));
+  ASSERT_FALSE(scanner.next(&element));
+  ASSERT_TRUE(scanner.hasError());
+}
@@ -0,0 +1,107 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "creatureindex.h"
+
+#include <algorithm>
+
+#include "gtest/gtest.h"
+
+namespace
+{
+
+bool contains(const CreatureIdList& creatureIds, CreatureId creatureId)
+{
+  return std::find(creatureIds.cbegin(), creatureIds.cend(), creatureId) != creatureIds.cend();
+}
+
+}  // namespace
+
+TEST(CreatureIndexTest, AddRemove)
+{
+  CreatureIndex index(192, 192, 64, 64);
+
+  index.add(1, Position(192, 192, 7));
+  index.add(2, Position(200, 200, 7));
+  index.add(3, Position(255, 255, 7));
+
+  CreatureIdList creatureIds;
+  index.getCreatureIds(192, 192, 255, 255, 7, &creatureIds);
+  ASSERT_EQ(creatureIds.size(), 3u);
+
+  index.remove(2, Position(200, 200, 7));
+
+  creatureIds.clear();
+  index.getCreatureIds(192, 192, 255, 255, 7, &creatureIds);
+  ASSERT_EQ(creatureIds.size(), 2u);
+  ASSERT_TRUE(contains(creatureIds, 1));
+  ASSERT_FALSE(contains(creatureIds, 2));
+  ASSERT_TRUE(contains(creatureIds, 3));
+}
+
+TEST(CreatureIndexTest, Area)
+{
+  CreatureIndex index(192, 192, 64, 64);
+
+  // Same sector, but only one of them is in the area
+  index.add(1, Position(200, 200, 7));
+  index.add(2, Position(203, 200, 7));
+
+  // Other floor
+  index.add(3, Position(200, 200, 6));
+
+  CreatureIdList creatureIds;
+  index.getCreatureIds(180, 180, 201, 201, 7, &creatureIds);
+  ASSERT_EQ(creatureIds.size(), 1u);
+  ASSERT_TRUE(contains(creatureIds, 1));
+
+  // Area outside of the index
+  creatureIds.clear();
+  index.getCreatureIds(0, 0, 100, 100, 7, &creatureIds);
+  ASSERT_TRUE(creatureIds.empty());
+}
+
+TEST(CreatureIndexTest, Move)
+{
+  CreatureIndex index(192, 192, 64, 64);
+  index.add(1, Position(200, 200, 7));
+
+  // Move within the same sector
+  index.move(1, Position(200, 200, 7), Position(201, 200, 7));
+
+  CreatureIdList creatureIds;
+  index.getCreatureIds(200, 200, 200, 200, 7, &creatureIds);
+  ASSERT_TRUE(creatureIds.empty());
+  index.getCreatureIds(201, 200, 201, 200, 7, &creatureIds);
+  ASSERT_EQ(creatureIds.size(), 1u);
+
+  // Move to another sector
+  index.move(1, Position(201, 200, 7), Position(240, 230, 7));
+
+  creatureIds.clear();
+  index.getCreatureIds(192, 192, 239, 239, 7, &creatureIds);
+  ASSERT_TRUE(creatureIds.empty());
+  index.getCreatureIds(240, 230, 240, 230, 7, &creatureIds);
+  ASSERT_EQ(creatureIds.size(), 1u);
+}
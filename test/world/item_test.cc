@@ -24,54 +24,76 @@
 
 #include "item.h"
 
+#include <vector>
+
 #include "gtest/gtest.h"
 
 class ItemTest : public ::testing::Test
 {
  public:
   ItemTest()
+    : itemData_(3)
   {
-    dummyItemA_.id = 1;
-    dummyItemA_.name = "DummyItemA";
-
-    dummyItemB_.id = 2;
-    dummyItemB_.name = "DummyItemB";
-    dummyItemB_.attributes.insert(std::make_pair("string", "test"));
-    dummyItemB_.attributes.insert(std::make_pair("integer", "1234"));
-    dummyItemB_.attributes.insert(std::make_pair("float", "3.14"));
+    itemData_[1].id = 1;
+    itemData_[1].name = "DummyItemA";
+
+    itemData_[2].id = 2;
+    itemData_[2].name = "DummyItemB";
+    itemData_[2].attributes.insert(std::make_pair("string", "test"));
+    itemData_[2].attributes.insert(std::make_pair("integer", "1234"));
+    itemData_[2].attributes.insert(std::make_pair("float", "3.14"));
+
+    Item::setItemDataTable(itemData_.data(), itemData_.size());
   }
 
-  ItemData dummyItemA_;
-  ItemData dummyItemB_;
-};
+  ~ItemTest()
+  {
+    Item::setItemDataTable(nullptr, 0);
+  }
 
-static ItemData dummyItemA;
+  std::vector<ItemData> itemData_;
+};
 
 TEST_F(ItemTest, Constructor)
 {
-  Item invalidItem(nullptr);
+  Item invalidItem;
   ASSERT_FALSE(invalidItem.isValid());
 
-  Item validItem(&dummyItemA_);
+  Item validItem(1);
   ASSERT_TRUE(validItem.isValid());
 }
 
 TEST_F(ItemTest, Attribute)
 {
-  Item testItem(&dummyItemB_);
+  Item testItem(2);
   ASSERT_TRUE(testItem.isValid());
 
   ASSERT_EQ(testItem.getAttribute<std::string>("string"), "test");
   ASSERT_EQ(testItem.getAttribute<int>("integer"), 1234);
   ASSERT_FLOAT_EQ(testItem.getAttribute<float>("float"), 3.14f);
+  ASSERT_FALSE(testItem.hasAttribute("missing"));
+}
+
+TEST_F(ItemTest, ItemData)
+{
+  Item testItem(2);
+  ASSERT_EQ(testItem.getItemId(), 2);
+  ASSERT_EQ(testItem.getName(), "DummyItemB");
+  ASSERT_EQ(testItem.getCount(), 1);
+
+  // ItemIds without ItemData use the invalid ItemData
+  Item unknownItem(10);
+  ASSERT_EQ(unknownItem.getName(), "");
+  ASSERT_FALSE(unknownItem.isBlocking());
+  ASSERT_FALSE(Item().isBlocking());
 }
 
 TEST_F(ItemTest, Equals)
 {
-  Item testItemA(&dummyItemA_);
-  Item testItemAA(&dummyItemA_);
-  Item testItemB(&dummyItemB_);
-  Item testItemC(nullptr);
+  Item testItemA(1);
+  Item testItemAA(1);
+  Item testItemB(2);
+  Item testItemC;
 
   ASSERT_TRUE(testItemA.isValid());
   ASSERT_TRUE(testItemB.isValid());
@@ -87,5 +109,5 @@ TEST_F(ItemTest, Equals)
   Item testItemE(testItemB);
   ASSERT_EQ(testItemB, testItemE);
 
-  ASSERT_EQ(testItemC, Item(nullptr));
+  ASSERT_EQ(testItemC, Item());
 }
@@ -0,0 +1,65 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef COMMON_WORLD_MOCKS_ITEMFACTORY_FIXTURE_H_
+#define COMMON_WORLD_MOCKS_ITEMFACTORY_FIXTURE_H_
+
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "itemfactory_mock.h"
+#include "item.h"
+
+// Test fixture for loading and saving worlds: installs an ItemData table with ItemIds
+// 1 to 4 (where 2 is ALWAYS_ON_TOP) and a MockItemFactory that creates any Item
+class ItemFactoryFixture : public ::testing::Test
+{
+ public:
+  ItemFactoryFixture()
+    : itemData_(5)
+  {
+    for (auto i = 1; i < 5; i++)
+    {
+      itemData_[i].id = i;
+    }
+    itemData_[2].setFlag(ItemData::ALWAYS_ON_TOP);
+
+    Item::setItemDataTable(itemData_.data(), itemData_.size());
+
+    ON_CALL(itemFactory_, createItem(::testing::_))
+      .WillByDefault(::testing::Invoke([](ItemId itemId) { return Item(itemId); }));
+  }
+
+  ~ItemFactoryFixture()
+  {
+    Item::setItemDataTable(nullptr, 0);
+  }
+
+  std::vector<ItemData> itemData_;
+  ::testing::NiceMock<MockItemFactory> itemFactory_;
+};
+
+#endif  // COMMON_WORLD_MOCKS_ITEMFACTORY_FIXTURE_H_
@@ -24,35 +24,42 @@
 
 #include "tile.h"
 
+#include <vector>
+
 #include "gtest/gtest.h"
 
 class TileTest : public ::testing::Test
 {
  public:
   TileTest()
+    : itemData_(5)
   {
-    dummyItemA_.id = 1;
-    dummyItemA_.name = "DummyItemA";
+    itemData_[1].id = 1;
+    itemData_[1].name = "DummyItemA";
+
+    itemData_[2].id = 2;
+    itemData_[2].name = "DummyItemB";
 
-    dummyItemB_.id = 2;
-    dummyItemB_.name = "DummyItemB";
+    itemData_[3].id = 3;
+    itemData_[3].name = "DummyItemC";
 
-    dummyItemC_.id = 3;
-    dummyItemC_.name = "DummyItemC";
+    itemData_[4].id = 4;
+    itemData_[4].name = "DummyItemD";
 
-    dummyItemD_.id = 4;
-    dummyItemD_.name = "DummyItemD";
+    Item::setItemDataTable(itemData_.data(), itemData_.size());
+  }
+
+  ~TileTest()
+  {
+    Item::setItemDataTable(nullptr, 0);
   }
 
-  ItemData dummyItemA_;
-  ItemData dummyItemB_;
-  ItemData dummyItemC_;
-  ItemData dummyItemD_;
+  std::vector<ItemData> itemData_;
 };
 
 TEST_F(TileTest, Constructor)
 {
-  Item groundItem(&dummyItemA_);
+  Item groundItem(1);
   Tile tileA(groundItem);
 
   ASSERT_EQ(tileA.getItem(0), groundItem);
@@ -61,7 +68,7 @@ TEST_F(TileTest, Constructor)
 
 TEST_F(TileTest, AddRemoveCreatures)
 {
-  Item groundItem(&dummyItemA_);
+  Item groundItem(1);
   Tile tile(groundItem);
   CreatureId creatureA(1);
   CreatureId creatureB(2);
@@ -100,12 +107,12 @@ TEST_F(TileTest, AddRemoveCreatures)
 
 TEST_F(TileTest, AddRemoveItems)
 {
-  Item groundItem(&dummyItemA_);
+  Item groundItem(1);
   Tile tile(groundItem);
 
-  Item itemA(&dummyItemB_);
-  Item itemB(&dummyItemC_);
-  Item itemC(&dummyItemD_);
+  Item itemA(2);
+  Item itemB(3);
+  Item itemC(4);
 
   // Add an item and remove it
   tile.addItem(itemA);
@@ -137,3 +144,82 @@ TEST_F(TileTest, AddRemoveItems)
   ASSERT_TRUE(result);
   ASSERT_EQ(tile.getNumberOfThings(), 1u + 0u);
 }
+
+TEST_F(TileTest, StackPositions)
+{
+  Item groundItem(1);
+  Tile tile(groundItem);
+
+  itemData_[2].setFlag(ItemData::ALWAYS_ON_TOP);
+  Item topItem(2);
+  Item bottomItemA(3);
+  Item bottomItemB(4);
+  CreatureId creatureA(1);
+  CreatureId creatureB(2);
+
+  tile.addItem(bottomItemA);
+  tile.addCreature(creatureA);
+  tile.addItem(topItem);
+  tile.addCreature(creatureB);
+  tile.addItem(bottomItemB);
+
+  // Ground, top Item, Creatures (last added first), bottom Items (last added first)
+  ASSERT_EQ(tile.getNumberOfThings(), 6u);
+  ASSERT_EQ(tile.getItem(0), groundItem);
+  ASSERT_EQ(tile.getItem(1), topItem);
+  ASSERT_EQ(tile.getCreatureId(2), creatureB);
+  ASSERT_EQ(tile.getCreatureId(3), creatureA);
+  ASSERT_EQ(tile.getItem(4), bottomItemB);
+  ASSERT_EQ(tile.getItem(5), bottomItemA);
+  ASSERT_EQ(tile.getCreatureStackPos(creatureB), 2);
+  ASSERT_EQ(tile.getCreatureStackPos(creatureA), 3);
+
+  // Not Items
+  ASSERT_FALSE(tile.getItem(2).isValid());
+  ASSERT_FALSE(tile.getItem(6).isValid());
+  ASSERT_FALSE(tile.removeItem(itemData_[1].id, 3));
+
+  // Removing the top Item moves everything below it up
+  ASSERT_TRUE(tile.removeItem(topItem.getItemId(), 1));
+  ASSERT_EQ(tile.getCreatureId(1), creatureB);
+  ASSERT_EQ(tile.getCreatureStackPos(creatureA), 2);
+  ASSERT_EQ(tile.getItem(3), bottomItemB);
+  ASSERT_EQ(tile.getItem(4), bottomItemA);
+}
+
+TEST_F(TileTest, AggregateFlags)
+{
+  itemData_[1].speed = 150;
+  itemData_[2].setFlag(ItemData::ALWAYS_ON_TOP);
+  itemData_[3].setFlag(ItemData::BLOCKING);
+  itemData_[4].setFlag(ItemData::BLOCKING);
+
+  Tile tile(Item(1));
+  ASSERT_EQ(tile.getGroundSpeed(), 150);
+  ASSERT_FALSE(tile.isBlocking());
+  ASSERT_FALSE(tile.hasTopItems());
+  ASSERT_FALSE(tile.hasCreatures());
+
+  tile.addItem(Item(2));
+  tile.addItem(Item(3));
+  tile.addItem(Item(4));
+  tile.addCreature(1);
+  ASSERT_TRUE(tile.isBlocking());
+  ASSERT_TRUE(tile.hasTopItems());
+  ASSERT_TRUE(tile.hasCreatures());
+
+  // Ground, top Item, Creature, bottom Items (last added first)
+  ASSERT_TRUE(tile.removeItem(4, 3));
+  ASSERT_TRUE(tile.isBlocking());
+  ASSERT_TRUE(tile.removeItem(3, 3));
+  ASSERT_FALSE(tile.isBlocking());
+  ASSERT_TRUE(tile.removeItem(2, 1));
+  ASSERT_FALSE(tile.hasTopItems());
+  ASSERT_TRUE(tile.removeCreature(1));
+  ASSERT_FALSE(tile.hasCreatures());
+
+  // The ground Item can't be removed, and keeps the ground speed
+  ASSERT_FALSE(tile.removeItem(1, 0));
+  ASSERT_EQ(tile.getNumberOfThings(), 1u);
+  ASSERT_EQ(tile.getGroundSpeed(), 150);
+}
@@ -0,0 +1,146 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "tilegrid.h"
+
+#include <chrono>
+#include <stdexcept>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+class TileGridTest : public ::testing::Test
+{
+ public:
+  TileGridTest()
+    : itemData_(3)
+  {
+    itemData_[1].id = 1;
+    itemData_[1].name = "DummyItemA";
+
+    itemData_[2].id = 2;
+    itemData_[2].name = "DummyItemB";
+
+    Item::setItemDataTable(itemData_.data(), itemData_.size());
+  }
+
+  ~TileGridTest()
+  {
+    Item::setItemDataTable(nullptr, 0);
+  }
+
+  std::vector<ItemData> itemData_;
+};
+
+TEST_F(TileGridTest, SetGetTile)
+{
+  // Size is not a multiple of the chunk size on purpose
+  TileGrid tiles(192, 192, 40, 70);
+
+  Item groundItemA(1);
+  Item groundItemB(2);
+
+  tiles.setTile(Position(192, 192, 7), Tile(groundItemA));
+  tiles.setTile(Position(231, 261, 7), Tile(groundItemB));
+
+  ASSERT_NE(tiles.getTile(Position(192, 192, 7)), nullptr);
+  ASSERT_EQ(tiles.getTile(Position(192, 192, 7))->getItem(0), groundItemA);
+
+  ASSERT_NE(tiles.getTile(Position(231, 261, 7)), nullptr);
+  ASSERT_EQ(tiles.at(Position(231, 261, 7)).getItem(0), groundItemB);
+
+  // Tiles that have not been set, in an allocated and in a non-allocated chunk
+  ASSERT_EQ(tiles.getTile(Position(193, 192, 7)), nullptr);
+  ASSERT_EQ(tiles.getTile(Position(192, 192, 6)), nullptr);
+  ASSERT_THROW(tiles.at(Position(193, 192, 7)), std::out_of_range);
+}
+
+TEST_F(TileGridTest, OutsideGrid)
+{
+  TileGrid tiles(192, 192, 16, 16);
+
+  ASSERT_EQ(tiles.getTile(Position(191, 192, 7)), nullptr);
+  ASSERT_EQ(tiles.getTile(Position(192, 208, 7)), nullptr);
+  ASSERT_EQ(tiles.getTile(Position(192, 192, 16)), nullptr);
+  ASSERT_THROW(tiles.setTile(Position(208, 192, 7), Tile(Item(1))), std::out_of_range);
+}
+
+TEST_F(TileGridTest, ModifyTile)
+{
+  TileGrid tiles(192, 192, 16, 16);
+  tiles.setTile(Position(200, 200, 7), Tile(Item(1)));
+
+  tiles.at(Position(200, 200, 7)).addItem(Item(2));
+  tiles.at(Position(200, 200, 7)).addCreature(1);
+
+  ASSERT_EQ(tiles.at(Position(200, 200, 7)).getNumberOfThings(), 3u);
+}
+
+TEST_F(TileGridTest, Paging)
+{
+  // 2 x 2 chunks on each floor, the ChunkLoader sets a Tile at the first position of each
+  // chunk on floor 7
+  TileGrid tiles(192, 192, 64, 64);
+  std::vector<std::size_t> loadedChunks;
+  tiles.setChunkLoader([&loadedChunks](std::size_t chunkIndex, TileGrid* tiles)
+  {
+    loadedChunks.push_back(chunkIndex);
+    if (chunkIndex / 4 == 7)
+    {
+      auto x = 192 + (chunkIndex % 2) * TileGrid::CHUNK_SIZE;
+      auto y = 192 + ((chunkIndex / 2) % 2) * TileGrid::CHUNK_SIZE;
+      tiles->setTile(Position(x, y, 7), Tile(Item(1)));
+    }
+    return true;
+  });
+  ASSERT_TRUE(tiles.isPaged());
+
+  // Chunks are loaded on first access only
+  ASSERT_NE(tiles.getTile(Position(192, 192, 7)), nullptr);
+  ASSERT_NE(tiles.getTile(Position(224, 224, 7)), nullptr);
+  ASSERT_NE(tiles.getTile(Position(192, 224, 7)), nullptr);
+  ASSERT_NE(tiles.getTile(Position(192, 192, 7)), nullptr);
+  ASSERT_EQ(loadedChunks, std::vector<std::size_t>({ 28, 31, 30 }));
+
+  // A chunk without Tiles is not allocated
+  ASSERT_EQ(tiles.getTile(Position(192, 192, 6)), nullptr);
+  ASSERT_EQ(loadedChunks.size(), 4u);
+
+  // Chunks that are modified or have Creatures are never evicted
+  tiles.setModified(Position(224, 224, 7));
+  tiles.at(Position(192, 224, 7)).addCreature(1);
+  ASSERT_EQ(tiles.evictChunks(std::chrono::hours(1), 3), 3u);
+  ASSERT_EQ(tiles.evictChunks(std::chrono::hours(1), 2), 2u);
+  ASSERT_EQ(tiles.evictChunks(std::chrono::hours(1), 0), 2u);
+
+  // An evicted chunk is loaded again on access
+  loadedChunks.clear();
+  ASSERT_NE(tiles.getTile(Position(192, 192, 7)), nullptr);
+  ASSERT_EQ(loadedChunks, std::vector<std::size_t>({ 28 }));
+
+  // Idle chunks are evicted
+  tiles.at(Position(192, 224, 7)).removeCreature(1);
+  ASSERT_EQ(tiles.evictChunks(std::chrono::seconds(0), 10), 1u);
+  ASSERT_NE(tiles.getTile(Position(224, 224, 7)), nullptr);
+}
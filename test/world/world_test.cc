@@ -23,7 +23,7 @@
  */
 
 #include <memory>
-#include <unordered_map>
+#include <utility>
 
 #include "gtest/gtest.h"
 #include "gmock/gmock.h"
@@ -35,6 +35,7 @@
 #include "creaturectrl.h"
 #include "position.h"
 #include "item.h"
+#include "tilegrid.h"
 
 using ::testing::AtLeast;
 using ::testing::_;
@@ -48,18 +49,17 @@ class WorldTest : public ::testing::Test
     // We need to build a small simple map, currently with invalid ground items
     // TODO(gurka): MockItem
     // Valid positions are (192, 192, 7) to (207, 207, 7)
-    std::unordered_map<Position, Tile, Position::Hash> tiles;
+    TileGrid tiles(192, 192, 16, 16);
     for (auto x = 0; x < 16; x++)
     {
       for (auto y = 0; y < 16; y++)
       {
         // TODO(gurka): This damn 192 constant again...
-        tiles.insert(std::make_pair(Position(192 + x, 192 + y, 7),
-                                    Tile(Item())));
+        tiles.setTile(Position(192 + x, 192 + y, 7), Tile(Item()));
       }
     }
 
-    world.reset(new World(std::unique_ptr<ItemFactory>(new MockItemFactory()), 16, 16, tiles));
+    world.reset(new World(std::unique_ptr<ItemFactory>(new MockItemFactory()), 16, 16, std::move(tiles)));
   }
 
   std::unique_ptr<World> world;
@@ -0,0 +1,205 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "worldfactory.h"
+
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "mocks/itemfactory_fixture.h"
+#include "item.h"
+#include "position.h"
+#include "tile.h"
+#include "tilegrid.h"
+
+class WorldFactoryTest : public ItemFactoryFixture
+{
+ public:
+  ~WorldFactoryTest()
+  {
+    std::remove(FILENAME);
+  }
+
+  void writeFile(const char* contents)
+  {
+    auto* f = fopen(FILENAME, "wb");
+    fputs(contents, f);
+    fclose(f);
+  }
+
+  // Writes a world.xml with size x size Tiles with a varying number of Items each, and
+  // optionally with "<tile"s in comments and CDATA sections between the Tiles
+  void writeLargeFile(int size, bool comments)
+  {
+    std::ostringstream xml;
+    xml << "<?xml version=\"1.0\"?>\n";
+    xml << "<map width=\"" << size << "\" height=\"" << size << "\">\n";
+    for (auto i = 0; i < size * size; i++)
+    {
+      if (comments && i % 7 == 3)
+      {
+        xml << "  <!-- <tile><item id=\"4\"/></tile> <tile><item id=\"4\"/></tile> -->\n";
+      }
+      else if (comments && i % 11 == 5)
+      {
+        xml << "  <![CDATA[ <tile><item id=\"4\"/></tile> ]]>\n";
+      }
+
+      xml << "  <tile>";
+      for (auto j = 0; j <= i % 4; j++)
+      {
+        xml << "<item id=\"" << ((i + j) % 3) + 1 << "\"/>";
+      }
+      xml << "</tile>\n";
+    }
+    xml << "</map>\n";
+    writeFile(xml.str().c_str());
+  }
+
+  static void expectEqualTiles(const TileGrid& expected, const TileGrid& actual)
+  {
+    ASSERT_EQ(expected.getSizeX(), actual.getSizeX());
+    ASSERT_EQ(expected.getSizeY(), actual.getSizeY());
+    for (auto y = 0; y < expected.getSizeY(); y++)
+    {
+      for (auto x = 0; x < expected.getSizeX(); x++)
+      {
+        Position position(192 + x, 192 + y, 7);
+        const auto& expectedTile = expected.at(position);
+        const auto& actualTile = actual.at(position);
+        ASSERT_EQ(expectedTile.getNumberOfThings(), actualTile.getNumberOfThings()) << position.toString();
+        for (auto i = 0u; i < expectedTile.getNumberOfThings(); i++)
+        {
+          ASSERT_EQ(expectedTile.getItem(i).getItemId(), actualTile.getItem(i).getItemId()) << position.toString();
+        }
+      }
+    }
+  }
+
+  static constexpr const char* FILENAME = "worldfactory_test.xml";
+};
+
+constexpr const char* WorldFactoryTest::FILENAME;
+
+TEST_F(WorldFactoryTest, LoadWorldXml)
+{
+  writeFile("<?xml version=\"1.0\"?>\n"
+            "<map width=\"2\" height=\"2\">\n"
+            "  <tile><item id=\"1\"/></tile>\n"
+            "  <tile><item id=\"1\"/><item id=\"3\"/><item id=\"2\"/><item id=\"4\"/></tile>\n"
+            "  <tile><item id=\"1\"/><item/><item id=\"3\"><inner id=\"4\"/></item></tile>\n"
+            "  <tile><item id=\"1\"></item></tile>\n"
+            "</map>\n");
+
+  auto tiles = WorldFactory::loadWorldXml(FILENAME, itemFactory_);
+  ASSERT_TRUE(static_cast<bool>(tiles));
+  ASSERT_EQ(tiles->getSizeX(), 2);
+  ASSERT_EQ(tiles->getSizeY(), 2);
+
+  ASSERT_EQ(tiles->at(Position(192, 192, 7)).getNumberOfThings(), 1u);
+  ASSERT_EQ(tiles->at(Position(193, 193, 7)).getNumberOfThings(), 1u);
+
+  // The Items after the ground Item are added backwards
+  const auto& tile = tiles->at(Position(193, 192, 7));
+  ASSERT_EQ(tile.getNumberOfThings(), 4u);
+  ASSERT_EQ(tile.getItem(0).getItemId(), 1);
+  ASSERT_EQ(tile.getItem(1).getItemId(), 2);
+  ASSERT_EQ(tile.getItem(2).getItemId(), 3);
+  ASSERT_EQ(tile.getItem(3).getItemId(), 4);
+
+  // Items without id and nested elements are skipped
+  const auto& otherTile = tiles->at(Position(192, 193, 7));
+  ASSERT_EQ(otherTile.getNumberOfThings(), 2u);
+  ASSERT_EQ(otherTile.getItem(1).getItemId(), 3);
+}
+
+TEST_F(WorldFactoryTest, LoadInvalidWorldXml)
+{
+  // Missing <tile>-node
+  writeFile("<map width=\"2\" height=\"2\"><tile><item id=\"1\"/></tile></map>");
+  ASSERT_FALSE(static_cast<bool>(WorldFactory::loadWorldXml(FILENAME, itemFactory_)));
+
+  // Missing ground Item
+  writeFile("<map width=\"1\" height=\"1\"><tile></tile></map>");
+  ASSERT_FALSE(static_cast<bool>(WorldFactory::loadWorldXml(FILENAME, itemFactory_)));
+
+  // Missing width
+  writeFile("<map height=\"1\"><tile><item id=\"1\"/></tile></map>");
+  ASSERT_FALSE(static_cast<bool>(WorldFactory::loadWorldXml(FILENAME, itemFactory_)));
+
+  // Unterminated <tile>-node
+  writeFile("<map width=\"1\" height=\"1\"><tile><item id=\"1\"/>");
+  ASSERT_FALSE(static_cast<bool>(WorldFactory::loadWorldXml(FILENAME, itemFactory_)));
+}
+
+TEST_F(WorldFactoryTest, LoadWorldXmlBands)
+{
+  // Parsing in many small bands gives the same Tiles as parsing in a single band
+  writeLargeFile(8, false);
+  auto expected = WorldFactory::loadWorldXml(FILENAME, itemFactory_, 1024 * 1024);
+  ASSERT_TRUE(static_cast<bool>(expected));
+  for (auto bandSize : { 1000, 300, 97, 40 })
+  {
+    SCOPED_TRACE(bandSize);
+    auto tiles = WorldFactory::loadWorldXml(FILENAME, itemFactory_, bandSize);
+    ASSERT_TRUE(static_cast<bool>(tiles));
+    expectEqualTiles(*expected, *tiles);
+  }
+}
+
+TEST_F(WorldFactoryTest, LoadWorldXmlBandsWithComments)
+{
+  writeLargeFile(8, true);
+  auto expected = WorldFactory::loadWorldXml(FILENAME, itemFactory_, 1024 * 1024);
+  ASSERT_TRUE(static_cast<bool>(expected));
+
+  // The Tiles in comments and CDATA sections (with item 4) are skipped
+  for (auto y = 0; y < 8; y++)
+  {
+    for (auto x = 0; x < 8; x++)
+    {
+      const auto& tile = expected->at(Position(192 + x, 192 + y, 7));
+      ASSERT_EQ(tile.getNumberOfThings(), static_cast<std::size_t>(((y * 8) + x) % 4) + 1);
+      for (auto i = 0u; i < tile.getNumberOfThings(); i++)
+      {
+        ASSERT_NE(tile.getItem(i).getItemId(), 4);
+      }
+    }
+  }
+
+  // Band sizes that split the file into a few bands up to more bands than there are Tiles,
+  // so that bands start both inside and outside of comments and CDATA sections
+  for (auto bandSize : { 1500, 700, 211, 97, 40 })
+  {
+    SCOPED_TRACE(bandSize);
+    auto tiles = WorldFactory::loadWorldXml(FILENAME, itemFactory_, bandSize);
+    ASSERT_TRUE(static_cast<bool>(tiles));
+    expectEqualTiles(*expected, *tiles);
+  }
+}
@@ -0,0 +1,112 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "worldfile.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "mocks/itemfactory_fixture.h"
+#include "item.h"
+#include "position.h"
+#include "tile.h"
+#include "tilegrid.h"
+
+class WorldFileTest : public ItemFactoryFixture
+{
+ public:
+  ~WorldFileTest()
+  {
+    std::remove(FILENAME);
+  }
+
+  static constexpr const char* FILENAME = "worldfile_test.bin";
+};
+
+constexpr const char* WorldFileTest::FILENAME;
+
+TEST_F(WorldFileTest, WriteAndLoad)
+{
+  // A world that spans more than one chunk, with a few Items on some Tiles
+  TileGrid tiles(192, 192, 40, 40);
+  for (auto x = 192; x < 192 + 40; x++)
+  {
+    for (auto y = 192; y < 192 + 40; y++)
+    {
+      tiles.setTile(Position(x, y, 7), Tile(Item(1)));
+    }
+  }
+  tiles.at(Position(192, 192, 7)).addItem(Item(3));
+  tiles.at(Position(192, 192, 7)).addItem(Item(2));
+  tiles.at(Position(192, 192, 7)).addItem(Item(4));
+  tiles.at(Position(231, 231, 7)).addItem(Item(2));
+
+  ASSERT_FALSE(WorldFile::isWorldFile(FILENAME));
+  ASSERT_TRUE(WorldFile::write(FILENAME, tiles));
+  ASSERT_TRUE(WorldFile::isWorldFile(FILENAME));
+
+  WorldFile worldFile;
+  ASSERT_TRUE(worldFile.open(FILENAME));
+  ASSERT_EQ(worldFile.getStartX(), 192);
+  ASSERT_EQ(worldFile.getStartY(), 192);
+  ASSERT_EQ(worldFile.getSizeX(), 40);
+  ASSERT_EQ(worldFile.getSizeY(), 40);
+
+  TileGrid loadedTiles(192, 192, 40, 40);
+  for (std::size_t chunkIndex = 0; chunkIndex < worldFile.getNumberOfChunks(); chunkIndex++)
+  {
+    ASSERT_TRUE(worldFile.loadChunk(chunkIndex, itemFactory_, &loadedTiles));
+  }
+
+  for (auto x = 192; x < 192 + 40; x++)
+  {
+    for (auto y = 192; y < 192 + 40; y++)
+    {
+      Position position(x, y, 7);
+      const auto& items = tiles.at(position).getItems();
+      const auto& loadedItems = loadedTiles.at(position).getItems();
+      ASSERT_EQ(items.size(), loadedItems.size());
+      ASSERT_TRUE(std::equal(items.begin(), items.end(), loadedItems.begin()));
+    }
+  }
+  ASSERT_EQ(loadedTiles.getTile(Position(192, 192, 6)), nullptr);
+}
+
+TEST_F(WorldFileTest, InvalidFile)
+{
+  WorldFile worldFile;
+  ASSERT_FALSE(worldFile.open(FILENAME));
+
+  auto* f = fopen(FILENAME, "wb");
+  fputs("<map width=\"16\" height=\"16\">", f);
+  fclose(f);
+
+  ASSERT_FALSE(WorldFile::isWorldFile(FILENAME));
+  ASSERT_FALSE(worldFile.open(FILENAME));
+  ASSERT_FALSE(worldFile.isOpen());
+}
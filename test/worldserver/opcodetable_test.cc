@@ -0,0 +1,340 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "opcodetable.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "command.h"
+#include "incomingpacket.h"
+
+#include "gtest/gtest.h"
+
+namespace
+{
+
+// Builds a packet payload, values are little endian as on the wire
+class Payload
+{
+ public:
+  Payload& u8(uint8_t value)
+  {
+    bytes.push_back(value);
+    return *this;
+  }
+
+  Payload& u16(uint16_t value)
+  {
+    bytes.push_back(value & 0xFF);
+    bytes.push_back(value >> 8);
+    return *this;
+  }
+
+  Payload& position(uint16_t x, uint16_t y, uint8_t z)
+  {
+    return u16(x).u16(y).u8(z);
+  }
+
+  Payload& string(const std::string& value)
+  {
+    u16(value.size());
+    bytes.insert(bytes.end(), value.begin(), value.end());
+    return *this;
+  }
+
+  std::vector<uint8_t> bytes;
+};
+
+void expectPosition(const Command::RawPosition& position, uint16_t x, uint16_t y, uint8_t z)
+{
+  EXPECT_EQ(x, position.x);
+  EXPECT_EQ(y, position.y);
+  EXPECT_EQ(z, position.z);
+}
+
+struct TestCase
+{
+  const char* name;
+  std::vector<uint8_t> packet;
+  OpcodeTable::Result result;
+  std::function<void(const Command&)> check;  // Only called for COMMAND
+};
+
+std::vector<TestCase> createTestCases()
+{
+  return
+  {
+    {
+      "logout", Payload().u8(0x14).bytes, OpcodeTable::LOGOUT, nullptr
+    },
+    {
+      "move path", Payload().u8(0x64).u8(3).u8(NORTH).u8(WEST).u8(SOUTH).bytes, OpcodeTable::COMMAND,
+      [](const Command& command)
+      {
+        EXPECT_EQ(Command::MOVE_PATH, command.type);
+        EXPECT_EQ(std::deque<Direction>({ NORTH, WEST, SOUTH }), command.movePath.get());
+      }
+    },
+    {
+      "move north", Payload().u8(0x65).bytes, OpcodeTable::COMMAND,
+      [](const Command& command)
+      {
+        EXPECT_EQ(Command::MOVE, command.type);
+        EXPECT_EQ(NORTH, command.move.direction);
+      }
+    },
+    {
+      "move west", Payload().u8(0x68).bytes, OpcodeTable::COMMAND,
+      [](const Command& command)
+      {
+        EXPECT_EQ(Command::MOVE, command.type);
+        EXPECT_EQ(WEST, command.move.direction);
+      }
+    },
+    {
+      "turn east", Payload().u8(0x70).bytes, OpcodeTable::COMMAND,
+      [](const Command& command)
+      {
+        EXPECT_EQ(Command::TURN, command.type);
+        EXPECT_EQ(EAST, command.move.direction);
+      }
+    },
+    {
+      "turn south", Payload().u8(0x71).bytes, OpcodeTable::COMMAND,
+      [](const Command& command)
+      {
+        EXPECT_EQ(Command::TURN, command.type);
+        EXPECT_EQ(SOUTH, command.move.direction);
+      }
+    },
+    {
+      "move item pos to pos",
+      Payload().u8(0x78).position(100, 200, 7).u16(1234).u8(2).position(101, 201, 7).u8(5).bytes,
+      OpcodeTable::COMMAND,
+      [](const Command& command)
+      {
+        EXPECT_EQ(Command::MOVE_ITEM_POS_TO_POS, command.type);
+        expectPosition(command.moveItem.fromPosition, 100, 200, 7);
+        EXPECT_EQ(1234, command.moveItem.itemId);
+        EXPECT_EQ(2, command.moveItem.fromStackPos);
+        expectPosition(command.moveItem.toPosition, 101, 201, 7);
+        EXPECT_EQ(5, command.moveItem.count);
+      }
+    },
+    {
+      "move item pos to inv",
+      Payload().u8(0x78).position(100, 200, 7).u16(1234).u8(1).u16(0xFFFF).u8(3).u16(0).u8(1).bytes,
+      OpcodeTable::COMMAND,
+      [](const Command& command)
+      {
+        EXPECT_EQ(Command::MOVE_ITEM_POS_TO_INV, command.type);
+        expectPosition(command.moveItem.fromPosition, 100, 200, 7);
+        EXPECT_EQ(1234, command.moveItem.itemId);
+        EXPECT_EQ(1, command.moveItem.fromStackPos);
+        EXPECT_EQ(3, command.moveItem.toInventoryId);
+        EXPECT_EQ(1, command.moveItem.count);
+      }
+    },
+    {
+      "move item inv to pos",
+      Payload().u8(0x78).u16(0xFFFF).u8(4).u16(0).u16(1234).u8(0).position(100, 200, 7).u8(1).bytes,
+      OpcodeTable::COMMAND,
+      [](const Command& command)
+      {
+        EXPECT_EQ(Command::MOVE_ITEM_INV_TO_POS, command.type);
+        EXPECT_EQ(4, command.moveItem.fromInventoryId);
+        EXPECT_EQ(1234, command.moveItem.itemId);
+        expectPosition(command.moveItem.toPosition, 100, 200, 7);
+        EXPECT_EQ(1, command.moveItem.count);
+      }
+    },
+    {
+      "move item inv to inv",
+      Payload().u8(0x78).u16(0xFFFF).u8(4).u16(0).u16(1234).u8(0).u16(0xFFFF).u8(5).u16(0).u8(1).bytes,
+      OpcodeTable::COMMAND,
+      [](const Command& command)
+      {
+        EXPECT_EQ(Command::MOVE_ITEM_INV_TO_INV, command.type);
+        EXPECT_EQ(4, command.moveItem.fromInventoryId);
+        EXPECT_EQ(1234, command.moveItem.itemId);
+        EXPECT_EQ(5, command.moveItem.toInventoryId);
+        EXPECT_EQ(1, command.moveItem.count);
+      }
+    },
+    {
+      "use inv item", Payload().u8(0x82).u16(0xFFFF).u8(6).u16(0).u16(1234).u16(0).bytes, OpcodeTable::COMMAND,
+      [](const Command& command)
+      {
+        EXPECT_EQ(Command::USE_INV_ITEM, command.type);
+        EXPECT_EQ(6, command.useItem.inventoryIndex);
+        EXPECT_EQ(1234, command.useItem.itemId);
+      }
+    },
+    {
+      "use pos item", Payload().u8(0x82).position(100, 200, 7).u16(1234).u8(3).u8(0).bytes, OpcodeTable::COMMAND,
+      [](const Command& command)
+      {
+        EXPECT_EQ(Command::USE_POS_ITEM, command.type);
+        expectPosition(command.useItem.position, 100, 200, 7);
+        EXPECT_EQ(1234, command.useItem.itemId);
+        EXPECT_EQ(3, command.useItem.stackPos);
+      }
+    },
+    {
+      "look at", Payload().u8(0x8C).position(100, 200, 7).u16(1234).bytes, OpcodeTable::COMMAND,
+      [](const Command& command)
+      {
+        EXPECT_EQ(Command::LOOK_AT, command.type);
+        expectPosition(command.lookAt.position, 100, 200, 7);
+        EXPECT_EQ(1234, command.lookAt.itemId);
+      }
+    },
+    {
+      "say", Payload().u8(0x96).u8(0x01).string("hello").bytes, OpcodeTable::COMMAND,
+      [](const Command& command)
+      {
+        EXPECT_EQ(Command::SAY, command.type);
+        EXPECT_EQ(0x01, command.say.type);
+        EXPECT_EQ(0, command.say.channelId);
+        EXPECT_EQ("", command.say.receiver.get());
+        EXPECT_EQ("hello", command.say.message.get());
+      }
+    },
+    {
+      "say private", Payload().u8(0x96).u8(0x06).string("Alice").string("hi").bytes, OpcodeTable::COMMAND,
+      [](const Command& command)
+      {
+        EXPECT_EQ(Command::SAY, command.type);
+        EXPECT_EQ("Alice", command.say.receiver.get());
+        EXPECT_EQ("hi", command.say.message.get());
+      }
+    },
+    {
+      "say channel", Payload().u8(0x96).u8(0x07).u16(4).string("hi").bytes, OpcodeTable::COMMAND,
+      [](const Command& command)
+      {
+        EXPECT_EQ(Command::SAY, command.type);
+        EXPECT_EQ(4, command.say.channelId);
+        EXPECT_EQ("hi", command.say.message.get());
+      }
+    },
+    {
+      // Strings that don't fit in the Command are cut, the rest is skipped
+      "say long message", Payload().u8(0x96).u8(0x01).string(std::string(300, 'x')).bytes, OpcodeTable::COMMAND,
+      [](const Command& command)
+      {
+        EXPECT_EQ(std::string(Command::MAX_MESSAGE_LENGTH, 'x'), command.say.message.get());
+      }
+    },
+    {
+      "cancel move", Payload().u8(0xBE).bytes, OpcodeTable::COMMAND,
+      [](const Command& command)
+      {
+        EXPECT_EQ(Command::CANCEL_MOVE, command.type);
+      }
+    },
+
+    // Unknown opcodes
+    { "unknown 0x00", Payload().u8(0x00).u8(1).bytes, OpcodeTable::UNKNOWN_OPCODE, nullptr },
+    { "unknown 0x69", Payload().u8(0x69).bytes, OpcodeTable::UNKNOWN_OPCODE, nullptr },
+    { "unknown 0xFF", Payload().u8(0xFF).bytes, OpcodeTable::UNKNOWN_OPCODE, nullptr },
+
+    // Invalid values
+    { "move path invalid direction", Payload().u8(0x64).u8(1).u8(4).bytes, OpcodeTable::MALFORMED, nullptr },
+
+    // Truncated payloads
+    { "empty packet", Payload().bytes, OpcodeTable::UNKNOWN_OPCODE, nullptr },
+    { "move path truncated", Payload().u8(0x64).u8(3).u8(NORTH).bytes, OpcodeTable::MALFORMED, nullptr },
+    {
+      "move item truncated from position", Payload().u8(0x78).u16(100).u16(200).bytes,
+      OpcodeTable::MALFORMED, nullptr
+    },
+    {
+      "move item truncated to position",
+      Payload().u8(0x78).position(100, 200, 7).u16(1234).u8(2).u16(101).u8(0).bytes,
+      OpcodeTable::MALFORMED, nullptr
+    },
+    {
+      "move item missing count", Payload().u8(0x78).position(100, 200, 7).u16(1234).u8(2).position(101, 201, 7).bytes,
+      OpcodeTable::MALFORMED, nullptr
+    },
+    { "use item truncated", Payload().u8(0x82).position(100, 200, 7).u16(1234).bytes, OpcodeTable::MALFORMED, nullptr },
+    { "look at truncated position", Payload().u8(0x8C).u16(100).bytes, OpcodeTable::MALFORMED, nullptr },
+    { "look at missing item", Payload().u8(0x8C).position(100, 200, 7).bytes, OpcodeTable::MALFORMED, nullptr },
+    { "say missing type", Payload().u8(0x96).bytes, OpcodeTable::MALFORMED, nullptr },
+    { "say missing message", Payload().u8(0x96).u8(0x01).bytes, OpcodeTable::MALFORMED, nullptr },
+    { "say missing channel", Payload().u8(0x96).u8(0x07).u8(4).bytes, OpcodeTable::MALFORMED, nullptr },
+
+    // String lengths that are larger than the rest of the packet
+    {
+      "say oversized message", Payload().u8(0x96).u8(0x01).u16(6).u8('h').u8('i').bytes,
+      OpcodeTable::MALFORMED, nullptr
+    },
+    {
+      "say oversized receiver", Payload().u8(0x96).u8(0x06).u16(0xFFFF).string("hi").bytes,
+      OpcodeTable::MALFORMED, nullptr
+    },
+  };
+}
+
+}  // namespace
+
+TEST(OpcodeTableTest, Parse)
+{
+  for (const auto& testCase : createTestCases())
+  {
+    SCOPED_TRACE(testCase.name);
+
+    OpcodeTable opcodeTable;
+    IncomingPacket packet(testCase.packet.data(), testCase.packet.size());
+    Command command;
+    auto result = opcodeTable.parse(&packet, &command);
+    EXPECT_EQ(testCase.result, result);
+    if (testCase.check && result == OpcodeTable::COMMAND)
+    {
+      testCase.check(command);
+    }
+
+    // Every packet is counted, and all but commands and logouts are counted as failed
+    auto opcode = testCase.packet.empty() ? 0 : testCase.packet[0];
+    auto stats = opcodeTable.getStats(opcode);
+    EXPECT_EQ(1u, stats.received);
+    auto failed = testCase.result == OpcodeTable::COMMAND || testCase.result == OpcodeTable::LOGOUT ? 0u : 1u;
+    EXPECT_EQ(failed, stats.failed);
+  }
+}
+
+TEST(OpcodeTableTest, GetName)
+{
+  ASSERT_STREQ("logout", OpcodeTable::getName(0x14));
+  ASSERT_STREQ("move", OpcodeTable::getName(0x65));
+  ASSERT_STREQ("move", OpcodeTable::getName(0x68));
+  ASSERT_STREQ("turn", OpcodeTable::getName(0x6F));
+  ASSERT_STREQ("say", OpcodeTable::getName(0x96));
+  ASSERT_STREQ("unknown", OpcodeTable::getName(0x69));
+  ASSERT_STREQ("unknown", OpcodeTable::getName(0xFF));
+}
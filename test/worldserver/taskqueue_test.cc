@@ -0,0 +1,402 @@
+/**
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2015 Simon Sandström
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "taskqueue.h"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <boost/asio.hpp>  //NOLINT
+
+#include "gtest/gtest.h"
+
+// A clock that only moves when the test says so
+struct FakeClock
+{
+  using duration = std::chrono::milliseconds;
+  using rep = duration::rep;
+  using period = duration::period;
+  using time_point = std::chrono::time_point<FakeClock, duration>;
+  static const bool is_steady = true;
+
+  static time_point now() { return time_point(current); }
+
+  static duration current;
+};
+
+FakeClock::duration FakeClock::current;
+
+class TaskQueueTest : public ::testing::Test
+{
+ public:
+  using Task = std::function<void()>;
+  using Queue = TaskQueue<Task, FakeClock>;
+
+  TaskQueueTest()
+  {
+    FakeClock::current = FakeClock::duration(0);
+    queue_.reset(new Queue(&io_service_, [](const Task& task) { task(); }, false));
+  }
+
+  // Returns a task that records id when it is executed
+  Task record(int id)
+  {
+    return [this, id]() { executed_.push_back(id); };
+  }
+
+  // Moves the clock to the given time and executes all tasks that are due
+  void runUntil(uint64_t ms)
+  {
+    FakeClock::current = FakeClock::duration(ms);
+    queue_->runTasks();
+  }
+
+  boost::asio::io_service io_service_;
+  std::unique_ptr<Queue> queue_;
+  std::vector<int> executed_;
+};
+
+TEST_F(TaskQueueTest, ZeroDelay)
+{
+  queue_->addTask(record(1));
+  queue_->addTask(record(2), std::chrono::milliseconds(0));
+  queue_->addTask(record(3), std::chrono::milliseconds(-10));
+  ASSERT_TRUE(executed_.empty());
+
+  // No time needs to pass
+  runUntil(0);
+  ASSERT_EQ(std::vector<int>({ 1, 2, 3 }), executed_);
+}
+
+TEST_F(TaskQueueTest, TasksAddedByTasks)
+{
+  // Tasks added while executing are executed by the next call, even without delay
+  queue_->addTask([this]()
+  {
+    executed_.push_back(1);
+    queue_->addTask(record(2));
+  });
+
+  runUntil(0);
+  ASSERT_EQ(std::vector<int>({ 1 }), executed_);
+  runUntil(0);
+  ASSERT_EQ(std::vector<int>({ 1, 2 }), executed_);
+}
+
+TEST_F(TaskQueueTest, SameSlotOrder)
+{
+  for (auto i = 0; i < 10; i++)
+  {
+    queue_->addTask(record(i), std::chrono::milliseconds(5));
+  }
+
+  runUntil(4);
+  ASSERT_TRUE(executed_.empty());
+
+  runUntil(5);
+  ASSERT_EQ(std::vector<int>({ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 }), executed_);
+}
+
+TEST_F(TaskQueueTest, OrderAcrossLevels)
+{
+  // Delays around the boundaries of each level, added in reverse order
+  const std::vector<uint64_t> delays =
+  {
+    1, 2, 255, 256, 257, 511, 512, 65535, 65536, 65537, 131072, 16777215, 16777216, 16777217
+  };
+  for (auto i = static_cast<int>(delays.size()) - 1; i >= 0; i--)
+  {
+    queue_->addTask(record(i), std::chrono::milliseconds(delays[i]));
+  }
+
+  // Each task is executed exactly at its delay, not before
+  for (auto i = 0u; i < delays.size(); i++)
+  {
+    runUntil(delays[i] - 1);
+    ASSERT_EQ(i, executed_.size()) << "delay: " << delays[i];
+
+    runUntil(delays[i]);
+    ASSERT_EQ(i + 1, executed_.size()) << "delay: " << delays[i];
+    ASSERT_EQ(static_cast<int>(i), executed_.back()) << "delay: " << delays[i];
+  }
+}
+
+TEST_F(TaskQueueTest, CascadeBoundaries)
+{
+  // Start just before a level 0 and a level 1 wrap around, so that tasks are cascaded
+  // while the wheels are not aligned with the delays
+  const std::vector<uint64_t> starts = { 250, 2 * 65536 - 6 };
+  const std::vector<uint64_t> delays = { 5, 6, 7, 250, 300, 65536, 70000 };
+  for (auto start : starts)
+  {
+    // Keep a task in the wheels so that the current tick isn't just moved to start
+    queue_->addTask(record(-1), std::chrono::milliseconds(start + 1000000));
+    runUntil(start);
+
+    executed_.clear();
+    for (auto i = 0u; i < delays.size(); i++)
+    {
+      queue_->addTask(record(i), std::chrono::milliseconds(delays[i]));
+    }
+
+    for (auto i = 0u; i < delays.size(); i++)
+    {
+      runUntil(start + delays[i] - 1);
+      ASSERT_EQ(i, executed_.size()) << "start: " << start << " delay: " << delays[i];
+
+      runUntil(start + delays[i]);
+      ASSERT_EQ(i + 1, executed_.size()) << "start: " << start << " delay: " << delays[i];
+      ASSERT_EQ(static_cast<int>(i), executed_.back()) << "start: " << start << " delay: " << delays[i];
+    }
+  }
+}
+
+TEST_F(TaskQueueTest, LateRun)
+{
+  // If runTasks is called late, all due tasks are executed in order of their expire time
+  queue_->addTask(record(3), std::chrono::milliseconds(70000));
+  queue_->addTask(record(1), std::chrono::milliseconds(300));
+  queue_->addTask(record(2), std::chrono::milliseconds(300));
+  queue_->addTask(record(0), std::chrono::milliseconds(1));
+  queue_->addTask(record(4), std::chrono::milliseconds(100000));
+
+  runUntil(80000);
+  ASSERT_EQ(std::vector<int>({ 0, 1, 2, 3 }), executed_);
+
+  runUntil(100000);
+  ASSERT_EQ(std::vector<int>({ 0, 1, 2, 3, 4 }), executed_);
+}
+
+TEST_F(TaskQueueTest, Cancel)
+{
+  ASSERT_FALSE(queue_->cancelTask(Queue::INVALID_TASK_ID));
+
+  auto taskA = queue_->addTask(record(1), std::chrono::milliseconds(10));
+  auto taskB = queue_->addTask(record(2), std::chrono::milliseconds(1000));
+  auto taskC = queue_->addTask(record(3));
+
+  ASSERT_TRUE(queue_->cancelTask(taskB));
+  ASSERT_FALSE(queue_->cancelTask(taskB));
+  ASSERT_TRUE(queue_->cancelTask(taskC));
+
+  runUntil(2000);
+  ASSERT_EQ(std::vector<int>({ 1 }), executed_);
+
+  // Already executed
+  ASSERT_FALSE(queue_->cancelTask(taskA));
+
+  // The node of taskA is reused, the old TaskId must not cancel the new task
+  auto taskD = queue_->addTask(record(4), std::chrono::milliseconds(10));
+  ASSERT_NE(taskA, taskD);
+  ASSERT_FALSE(queue_->cancelTask(taskA));
+
+  runUntil(2010);
+  ASSERT_EQ(std::vector<int>({ 1, 4 }), executed_);
+}
+
+TEST_F(TaskQueueTest, CancelFromTask)
+{
+  Queue::TaskId taskA = Queue::INVALID_TASK_ID;
+  Queue::TaskId taskC = Queue::INVALID_TASK_ID;
+  bool cancelSelf = true;
+  bool cancelOther = false;
+
+  // A task can neither cancel itself while running, nor any executed task, but it can
+  // cancel a task that is due in the same run
+  taskA = queue_->addTask([&]()
+  {
+    executed_.push_back(1);
+    cancelSelf = queue_->cancelTask(taskA);
+    cancelOther = queue_->cancelTask(taskC);
+  }, std::chrono::milliseconds(5));
+  taskC = queue_->addTask(record(3), std::chrono::milliseconds(5));
+
+  runUntil(5);
+  ASSERT_EQ(std::vector<int>({ 1 }), executed_);
+  ASSERT_FALSE(cancelSelf);
+  ASSERT_TRUE(cancelOther);
+}
+
+TEST_F(TaskQueueTest, CancelGroup)
+{
+  const Queue::GroupId groupA = 1;
+  const Queue::GroupId groupB = 2;
+
+  queue_->addTask(record(1), groupA);
+  queue_->addTask(record(2), std::chrono::milliseconds(10), groupA);
+  queue_->addTask(record(3), std::chrono::milliseconds(70000), groupA);
+  queue_->addTask(record(4), groupB);
+  queue_->addTask(record(5), std::chrono::milliseconds(10), groupB);
+  queue_->addTask(record(6), std::chrono::milliseconds(10));
+
+  ASSERT_EQ(3u, queue_->cancelTasks(groupA));
+  ASSERT_EQ(0u, queue_->cancelTasks(groupA));
+  ASSERT_EQ(0u, queue_->cancelTasks(3));
+
+  runUntil(100000);
+  ASSERT_EQ(std::vector<int>({ 4, 5, 6 }), executed_);
+
+  // The group can be used again
+  queue_->addTask(record(7), std::chrono::milliseconds(10), groupA);
+  runUntil(100010);
+  ASSERT_EQ(std::vector<int>({ 4, 5, 6, 7 }), executed_);
+}
+
+TEST_F(TaskQueueTest, CancelGroupFromTask)
+{
+  const Queue::GroupId group = 1;
+
+  // The first task cancels the rest of its group, which is due in the same run
+  queue_->addTask([this]()
+  {
+    executed_.push_back(1);
+    queue_->cancelTasks(1);
+  }, std::chrono::milliseconds(5), group);
+  queue_->addTask(record(2), std::chrono::milliseconds(5), group);
+  queue_->addTask(record(3), std::chrono::milliseconds(5));
+  queue_->addTask(record(4), std::chrono::milliseconds(50), group);
+
+  runUntil(100);
+  ASSERT_EQ(std::vector<int>({ 1, 3 }), executed_);
+}
+
+TEST_F(TaskQueueTest, CancelTaskInGroup)
+{
+  const Queue::GroupId group = 1;
+
+  // Cancel the first, a middle and the last task of the group list
+  auto taskA = queue_->addTask(record(1), std::chrono::milliseconds(10), group);
+  queue_->addTask(record(2), std::chrono::milliseconds(10), group);
+  auto taskC = queue_->addTask(record(3), std::chrono::milliseconds(10), group);
+  queue_->addTask(record(4), std::chrono::milliseconds(10), group);
+  auto taskE = queue_->addTask(record(5), std::chrono::milliseconds(10), group);
+
+  ASSERT_TRUE(queue_->cancelTask(taskC));
+  ASSERT_TRUE(queue_->cancelTask(taskA));
+  ASSERT_TRUE(queue_->cancelTask(taskE));
+  ASSERT_EQ(2u, queue_->cancelTasks(group));
+
+  runUntil(10);
+  ASSERT_TRUE(executed_.empty());
+}
+
+TEST_F(TaskQueueTest, RemoveGroup)
+{
+  const Queue::GroupId groupA = 1;
+  const Queue::GroupId groupB = 2;
+
+  queue_->addTask(record(1), std::chrono::milliseconds(100), groupA);
+  queue_->addTask(record(2), std::chrono::milliseconds(100), groupB);
+  runUntil(40);
+
+  queue_->addTask(record(3), std::chrono::milliseconds(70000), groupA);
+  queue_->addTask(record(4), std::chrono::milliseconds(10), groupA);
+  runUntil(45);
+  ASSERT_TRUE(executed_.empty());
+
+  // A task in the ready list has no time left
+  queue_->addTask(record(5), groupA);
+
+  // Tasks are returned in the order they were added, with the time left until they are due
+  auto tasks = queue_->removeTasks(groupA);
+  ASSERT_EQ(4u, tasks.size());
+  ASSERT_EQ(std::chrono::milliseconds(55), tasks[0].second);
+  ASSERT_EQ(std::chrono::milliseconds(70000 + 40 - 45), tasks[1].second);
+  ASSERT_EQ(std::chrono::milliseconds(5), tasks[2].second);
+  ASSERT_EQ(std::chrono::milliseconds(0), tasks[3].second);
+
+  for (auto& task : tasks)
+  {
+    task.first();
+  }
+  ASSERT_EQ(std::vector<int>({ 1, 3, 4, 5 }), executed_);
+  ASSERT_TRUE(queue_->removeTasks(groupA).empty());
+
+  // groupB is not affected
+  executed_.clear();
+  runUntil(100000);
+  ASSERT_EQ(std::vector<int>({ 2 }), executed_);
+}
+
+TEST_F(TaskQueueTest, RemoveGroupHandOff)
+{
+  // Moving a group to another TaskQueue keeps the time left until each task is due
+  Queue other(&io_service_, [](const Task& task) { task(); }, false);
+  const Queue::GroupId group = 1;
+
+  queue_->addTask(record(1), std::chrono::milliseconds(300), group);
+  queue_->addTask(record(2), std::chrono::milliseconds(100), group);
+  runUntil(50);
+
+  for (const auto& task : queue_->removeTasks(group))
+  {
+    other.addTask(task.first, task.second, group);
+  }
+
+  FakeClock::current = FakeClock::duration(99);
+  other.runTasks();
+  ASSERT_TRUE(executed_.empty());
+
+  FakeClock::current = FakeClock::duration(100);
+  other.runTasks();
+  ASSERT_EQ(std::vector<int>({ 2 }), executed_);
+
+  FakeClock::current = FakeClock::duration(300);
+  other.runTasks();
+  queue_->runTasks();
+  ASSERT_EQ(std::vector<int>({ 2, 1 }), executed_);
+}
+
+TEST_F(TaskQueueTest, ReplaceGroupChain)
+{
+  // A chain of tasks in a group that each add the next step, like a player walking a
+  // path, is stopped by cancelTasks and can be replaced by a new chain
+  const Queue::GroupId group = 1;
+  std::function<void(int, int)> step = [&](int id, int stepsLeft)
+  {
+    executed_.push_back(id);
+    if (stepsLeft > 0)
+    {
+      queue_->addTask(std::bind(step, id, stepsLeft - 1), std::chrono::milliseconds(100), group);
+    }
+  };
+
+  queue_->addTask(std::bind(step, 1, 10), group);
+  queue_->addTask(record(0), std::chrono::milliseconds(1000));
+  runUntil(0);
+  runUntil(100);
+  runUntil(200);
+  ASSERT_EQ(std::vector<int>({ 1, 1, 1 }), executed_);
+
+  // Replace the path halfway to the next step
+  runUntil(250);
+  queue_->cancelTasks(group);
+  queue_->addTask(std::bind(step, 2, 1), group);
+  runUntil(250);
+  runUntil(350);
+  runUntil(1000);
+  ASSERT_EQ(std::vector<int>({ 1, 1, 1, 2, 2, 0 }), executed_);
+}